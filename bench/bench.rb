@@ -0,0 +1,66 @@
+#
+# Cheap statistics for rUby (benchmark harness)
+#
+#   Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+#
+# usage: ruby -I lib bench/bench.rb
+#
+#   BENCH_SIZES  comma separated sample sizes (default: 1000,100000,1000000)
+#   BENCH_TIME   seconds to measure each entry (default: 2)
+#   BENCH_JSON   path to write the results as JSON (for the comparison
+#                between the releases)
+#
+
+require "json"
+require "benchmark/ips"
+require "cheap_stats"
+
+SIZES = (ENV["BENCH_SIZES"] || "1000,100000,1000000").split(",").map(&:to_i)
+TIME  = (ENV["BENCH_TIME"] || 2).to_f
+
+results = []
+
+SIZES.each { |n|
+  srand(n)
+
+  values = Array.new(n) {rand * 1000.0}
+  packed = values.pack("d*")
+  keys   = Array.new(n) {rand(100)}
+  stats  = CheapStats.new(values).tap(&:median)
+
+  puts "== n=#{n}"
+
+  report = Benchmark.ips { |x|
+    x.config(:time => TIME, :warmup => TIME / 4)
+
+    x.report("new+median") {CheapStats.new(values).median}
+    x.report("from_packed+median") {CheapStats.from_packed(packed).median}
+    x.report("quantiles") {stats.quantiles([0.5, 0.9, 0.99])}
+    x.report("cdf_many") {stats.cdf_many(values[0, 1000])}
+    x.report("moments") {CheapStats.from_packed(packed).kurtosis}
+    x.report("estimated_pdf") {stats.estimated_pdf(500.0)}
+    x.report("stream") {CheapStats::Stream.new.push(*values)}
+    x.report("histogram") {CheapStats::Histogram.new.push(*values)}
+    x.report("sketch") {CheapStats::Sketch.new.push(*values)}
+    x.report("group") {CheapStats.group(keys, packed)}
+  }
+
+  report.entries.each { |e|
+    results << {
+      :name        => e.label,
+      :n           => n,
+      :ips         => e.ips,
+      :ips_sd      => e.ips_sd,
+      :iterations  => e.iterations,
+      :ns_per_elem => 1.0e9 / e.ips / n,
+    }
+  }
+}
+
+if ENV["BENCH_JSON"]
+  File.write(ENV["BENCH_JSON"], JSON.pretty_generate({
+    :version => CheapStats::VERSION,
+    :ruby    => RUBY_DESCRIPTION,
+    :results => results,
+  }))
+end
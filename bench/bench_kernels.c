@@ -0,0 +1,111 @@
+/*
+ * benchmark for reduction kernels
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cheap_simd.h"
+
+#define REPEAT_BYTES          (4.0e9)
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static volatile double sink;
+
+static void
+run(const char* name, int kernel, double* a, size_t n)
+{
+  double p[CHEAP_SIMD_POWERS];
+  double t;
+  int rep;
+  int i;
+
+  rep = (int)(REPEAT_BYTES / (sizeof(double) * n));
+  if (rep < 1) rep = 1;
+
+  t = now();
+
+  for (i = 0; i < rep; i++) {
+    switch (kernel) {
+    case 0:
+      sink = cheap_simd_sum(a, n);
+      break;
+
+    case 1:
+      sink = cheap_simd_sum_sq_dev(a, n, 0.5);
+      break;
+
+    case 2:
+      cheap_simd_sum_dev_powers(a, n, 0.5, p);
+      sink = p[0];
+      break;
+    }
+  }
+
+  t = (now() - t) / rep;
+
+  printf("%-8s %-16s %10zu %10.3f\n",
+         cheap_simd_name(cheap_simd_level()), name, n,
+         (sizeof(double) * n) / t / 1e9);
+}
+
+int
+main(int argc, char* argv[])
+{
+  static const char* kernels[] = {"sum", "sum_sq_dev", "sum_dev_powers"};
+
+  size_t sizes[] = {1000000, 100000000};
+  double* a;
+  size_t n;
+  size_t i;
+  int level;
+  int max;
+  int j;
+  int k;
+
+  /*
+   * sizes can be given by the arguments
+   */
+  if (argc > 1) sizes[0] = strtoul(argv[1], NULL, 10);
+  if (argc > 2) sizes[1] = strtoul(argv[2], NULL, 10);
+
+  max = cheap_simd_select(CHEAP_SIMD_AVX512);
+
+  printf("%-8s %-16s %10s %10s\n", "isa", "kernel", "n", "GB/s");
+
+  for (j = 0; j < 2; j++) {
+    n = sizes[j];
+    a = malloc(sizeof(double) * n);
+
+    if (a == NULL) {
+      fprintf(stderr, "memory allocation failed (n=%zu)\n", n);
+      continue;
+    }
+
+    srand48(n);
+    for (i = 0; i < n; i++) a[i] = drand48();
+
+    for (level = CHEAP_SIMD_SCALAR; level <= max; level++) {
+      cheap_simd_select(level);
+
+      for (k = 0; k < 3; k++) run(kernels[k], k, a, n);
+    }
+
+    free(a);
+  }
+
+  return 0;
+}
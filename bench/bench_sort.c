@@ -0,0 +1,83 @@
+/*
+ * benchmark for sort routines
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cheap_sort.h"
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static int
+is_sorted(double* a, size_t n)
+{
+  size_t i;
+
+  for (i = 1; i < n; i++) {
+    if (a[i - 1] > a[i]) return 0;
+  }
+
+  return !0;
+}
+
+int
+main(int argc, char* argv[])
+{
+  static const size_t sizes[] = {
+    100, 1000, 10000, 100000, 1000000, 10000000
+  };
+
+  double* src;
+  double* a;
+  double t0;
+  double t1;
+  double t2;
+  size_t n;
+  size_t i;
+  int j;
+
+  printf("%10s %14s %14s %8s\n", "n", "combsort11[s]", "cheap_sort[s]", "ratio");
+
+  for (j = 0; j < (int)(sizeof(sizes) / sizeof(*sizes)); j++) {
+    n   = sizes[j];
+    src = malloc(sizeof(double) * n);
+    a   = malloc(sizeof(double) * n);
+
+    srand48(n);
+    for (i = 0; i < n; i++) src[i] = (drand48() - 0.3) * 1e6;
+
+    memcpy(a, src, sizeof(double) * n);
+    t0 = now();
+    cheap_combsort11(a, n);
+    t1 = now();
+
+    if (!is_sorted(a, n)) fprintf(stderr, "combsort11 failed\n");
+
+    memcpy(a, src, sizeof(double) * n);
+    t2 = now();
+    cheap_sort(a, n);
+    t2 = now() - t2;
+
+    if (!is_sorted(a, n)) fprintf(stderr, "cheap_sort failed\n");
+
+    printf("%10zu %14.6f %14.6f %8.2f\n", n, t1 - t0, t2, (t1 - t0) / t2);
+
+    free(src);
+    free(a);
+  }
+
+  return 0;
+}
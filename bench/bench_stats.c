@@ -0,0 +1,346 @@
+/*
+ * benchmark for the whole library (sizes x distributions x kernels)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cheap_stats.h"
+#include "cheap_sort.h"
+#include "cheap_simd.h"
+
+#define MIN_N                 100
+#define MAX_N                 100000000
+#define MIN_SECONDS           0.25      // repeat until this elapsed
+#define MAX_REPEAT            1000
+#define CDF_POINTS            1000
+
+#define FORMAT_TEXT           0
+#define FORMAT_CSV            1
+#define FORMAT_JSON           2
+
+enum {
+  K_NEW = 0,        // cheap_stats_new_ex() (sum pass)
+  K_SORT,           // first order statistic (sort of the samples)
+  K_QUANTILE,       // quantile on the sorted samples
+  K_CDF,            // cdf_many() of CDF_POINTS points (binary search)
+  K_VARIANCE,       // sum of squared deviations
+  K_MOMENTS,        // skewness and kurtosis (central moments)
+  K_KDE,            // estimated_pdf() at the median
+  K_COMBSORT,       // cheap_combsort11() (only n <= combsort_max)
+  N_KERNELS
+};
+
+static const char* kernel_names[] = {
+  "new", "sort", "quantile", "cdf_many", "variance", "moments", "kde",
+  "combsort11",
+};
+
+static const char* dist_names[] = {
+  "uniform", "normal", "lognormal", "pareto", "sorted", "duplicates",
+};
+
+#define N_DISTS               ((int)(sizeof(dist_names) / sizeof(*dist_names)))
+
+static volatile double sink;
+
+static double
+now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+
+static double
+normal(void)
+{
+  double u;
+  double v;
+
+  /* Box-Muller (one of the pair is discarded) */
+  u = 1.0 - drand48();
+  v = drand48();
+
+  return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static void
+generate(int dist, double* a, size_t n)
+{
+  size_t i;
+
+  srand48(n + dist);
+
+  for (i = 0; i < n; i++) {
+    switch (dist) {
+    case 0:   // uniform
+      a[i] = drand48();
+      break;
+
+    case 1:   // normal
+      a[i] = normal();
+      break;
+
+    case 2:   // lognormal
+      a[i] = exp(normal());
+      break;
+
+    case 3:   // heavy-tailed (pareto, alpha = 1.5)
+      a[i] = pow(1.0 - drand48(), -1.0 / 1.5);
+      break;
+
+    case 4:   // pre-sorted
+      a[i] = (double)i / n;
+      break;
+
+    case 5:   // many duplicates (16 distinct values)
+      a[i] = (double)(lrand48() % 16);
+      break;
+    }
+  }
+}
+
+static int
+measure(double* a, size_t n, int threads, int combsort, double* t)
+{
+  cheap_stats_opts_t opts;
+  cheap_stats_t* obj;
+  double xs[CDF_POINTS];
+  double ys[CDF_POINTS];
+  double* tmp;
+  double v;
+  double t0;
+  int err;
+  int i;
+
+  memset(&opts, 0, sizeof(opts));
+
+  opts.threads = threads;
+  opts.borrow  = !0;
+
+  for (i = 0; i < CDF_POINTS; i++) xs[i] = a[(n * i) / CDF_POINTS];
+
+  t0  = now();
+  err = cheap_stats_new_ex(a, n, &opts, &obj);
+  t[K_NEW] += now() - t0;
+  if (err) return err;
+
+  t0 = now();
+  cheap_stats_median(obj, &v);
+  t[K_SORT] += now() - t0;
+
+  t0 = now();
+  cheap_stats_quantile(obj, 0.99, &v);
+  t[K_QUANTILE] += now() - t0;
+
+  t0 = now();
+  cheap_stats_cdf_many(obj, xs, CDF_POINTS, ys);
+  t[K_CDF] += now() - t0;
+
+  t0 = now();
+  cheap_stats_variance(obj, &v);
+  t[K_VARIANCE] += now() - t0;
+
+  t0 = now();
+  cheap_stats_skewness(obj, &v);
+  cheap_stats_kurtosis(obj, &v);
+  t[K_MOMENTS] += now() - t0;
+
+  cheap_stats_median(obj, &v);
+
+  t0 = now();
+  cheap_stats_estimated_pdf(obj, v, &v);
+  t[K_KDE] += now() - t0;
+
+  sink = v + ys[0];
+
+  cheap_stats_destroy(obj);
+
+  if (combsort) {
+    tmp = malloc(sizeof(double) * n);
+    if (tmp == NULL) return !0;
+
+    memcpy(tmp, a, sizeof(double) * n);
+
+    t0 = now();
+    cheap_combsort11(tmp, n);
+    t[K_COMBSORT] += now() - t0;
+
+    free(tmp);
+  }
+
+  return 0;
+}
+
+static void
+report(int format, int dist, int kernel, size_t n, int rep, double t)
+{
+  double ns;
+  double gbs;
+
+  ns  = (t * 1e9) / n;
+  gbs = (t > 0.0)? (sizeof(double) * n) / t / 1e9: 0.0;
+
+  switch (format) {
+  case FORMAT_CSV:
+    printf("%s,%s,%s,%zu,%d,%.6e,%.4f,%.4f\n",
+           cheap_simd_name(cheap_simd_level()), dist_names[dist],
+           kernel_names[kernel], n, rep, t, ns, gbs);
+    break;
+
+  case FORMAT_JSON:
+    printf("{\"isa\":\"%s\",\"dist\":\"%s\",\"kernel\":\"%s\",\"n\":%zu,"
+           "\"repeat\":%d,\"seconds\":%.6e,\"ns_per_elem\":%.4f,"
+           "\"gb_per_sec\":%.4f}\n",
+           cheap_simd_name(cheap_simd_level()), dist_names[dist],
+           kernel_names[kernel], n, rep, t, ns, gbs);
+    break;
+
+  default:
+    printf("%-10s %-10s %10zu %12.4f %10.3f\n",
+           dist_names[dist], kernel_names[kernel], n, ns, gbs);
+    break;
+  }
+}
+
+static void
+usage(const char* prog)
+{
+  fprintf(stderr,
+          "usage: %s [-f text|csv|json] [-n max_n] [-d dist] [-t threads] "
+          "[-c combsort_max]\n", prog);
+}
+
+int
+main(int argc, char* argv[])
+{
+  double t[N_KERNELS];
+  double* a;
+  double t0;
+  size_t max_n;
+  size_t comb_max;
+  size_t n;
+  int format;
+  int threads;
+  int only;
+  int dist;
+  int rep;
+  int opt;
+  int i;
+  int k;
+
+  /*
+   * parse options
+   */
+  format   = FORMAT_TEXT;
+  max_n    = MAX_N;
+  comb_max = 100000;
+  threads  = 1;
+  only     = -1;
+
+  while ((opt = getopt(argc, argv, "f:n:d:t:c:h")) != -1) {
+    switch (opt) {
+    case 'f':
+      if (strcmp(optarg, "csv") == 0) {
+        format = FORMAT_CSV;
+      } else if (strcmp(optarg, "json") == 0) {
+        format = FORMAT_JSON;
+      } else {
+        format = FORMAT_TEXT;
+      }
+      break;
+
+    case 'n':
+      max_n = (size_t)strtod(optarg, NULL);
+      break;
+
+    case 'd':
+      for (i = 0; i < N_DISTS; i++) {
+        if (strcmp(optarg, dist_names[i]) == 0) only = i;
+      }
+
+      if (only < 0) {
+        fprintf(stderr, "unknown distribution (%s)\n", optarg);
+        return 1;
+      }
+      break;
+
+    case 't':
+      threads = atoi(optarg);
+      break;
+
+    case 'c':
+      comb_max = (size_t)strtod(optarg, NULL);
+      break;
+
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  /*
+   * sweep
+   */
+  switch (format) {
+  case FORMAT_CSV:
+    printf("isa,dist,kernel,n,repeat,seconds,ns_per_elem,gb_per_sec\n");
+    break;
+
+  case FORMAT_TEXT:
+    printf("# isa=%s threads=%d\n",
+           cheap_simd_name(cheap_simd_level()), threads);
+    printf("%-10s %-10s %10s %12s %10s\n",
+           "dist", "kernel", "n", "ns/elem", "GB/s");
+    break;
+  }
+
+  for (n = MIN_N; n <= max_n; n *= 10) {
+    a = malloc(sizeof(double) * n);
+
+    if (a == NULL) {
+      fprintf(stderr, "memory allocation failed (n=%zu)\n", n);
+      break;
+    }
+
+    for (dist = 0; dist < N_DISTS; dist++) {
+      if (only >= 0 && dist != only) continue;
+
+      generate(dist, a, n);
+      memset(t, 0, sizeof(t));
+
+      rep = 0;
+      t0  = now();
+
+      do {
+        if (measure(a, n, threads, (n <= comb_max), t)) {
+          fprintf(stderr, "measurement failed (n=%zu)\n", n);
+          free(a);
+          return 1;
+        }
+
+        rep++;
+      } while ((now() - t0) < MIN_SECONDS && rep < MAX_REPEAT);
+
+      for (k = 0; k < N_KERNELS; k++) {
+        if (k == K_COMBSORT && n > comb_max) continue;
+        report(format, dist, k, n, rep, t[k] / rep);
+      }
+
+      fflush(stdout);
+    }
+
+    free(a);
+  }
+
+  return 0;
+}
@@ -0,0 +1,29 @@
+﻿/*
+ * Small statics library (internal definitions)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_COMMON_H__
+#define __CHEAP_COMMON_H__
+
+#include <stdlib.h>
+
+#define DEFAULT_ERROR         __LINE__
+#define INTERRUPTED_ERROR     (-1)    /* same as CHEAP_STATS_INTERRUPTED */
+
+#define ALLOC(t)              ((t*)malloc(sizeof(t)))
+#define NALLOC(t,n)           ((t*)malloc(sizeof(t) * (n)))
+#define FREE(var)             do {free(var);var = NULL;} while (0)
+
+/*
+ * interrupt flag of the running computation (thread local, and inherited
+ * by the workers of cheap_parallel()). long loops poll it and give up the
+ * computation when it is set by the other thread.
+ */
+extern __thread volatile int* cheap_interrupt_flag;
+
+#define IS_INTERRUPTED() \
+      (cheap_interrupt_flag != NULL && *cheap_interrupt_flag)
+
+#endif /* !defined(__CHEAP_COMMON_H__) */
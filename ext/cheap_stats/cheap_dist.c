@@ -0,0 +1,176 @@
+﻿/*
+ * Small statics library (distribution functions)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+
+#include "cheap_dist.h"
+
+#define MAX_ITERATION         300
+#define CF_EPSILON            1e-15
+#define CF_TINY               1e-300
+#define ISF_EPSILON           1e-13
+
+/*
+ * continued fraction of the incomplete beta function (modified Lentz)
+ */
+static double
+beta_cf(double x, double a, double b)
+{
+  double c;
+  double d;
+  double f;
+  double e;
+  double m2;
+  int m;
+
+  c = 1.0;
+  d = 1.0 - ((a + b) * x) / (a + 1.0);
+  if (fabs(d) < CF_TINY) d = CF_TINY;
+  d = 1.0 / d;
+  f = d;
+
+  for (m = 1; m <= MAX_ITERATION; m++) {
+    m2 = 2.0 * m;
+
+    /* even step */
+    e = (m * (b - m) * x) / ((a + m2 - 1.0) * (a + m2));
+    d = 1.0 + (e * d);
+    c = 1.0 + (e / c);
+    if (fabs(d) < CF_TINY) d = CF_TINY;
+    if (fabs(c) < CF_TINY) c = CF_TINY;
+    d  = 1.0 / d;
+    f *= d * c;
+
+    /* odd step */
+    e = -((a + m) * (a + b + m) * x) / ((a + m2) * (a + m2 + 1.0));
+    d = 1.0 + (e * d);
+    c = 1.0 + (e / c);
+    if (fabs(d) < CF_TINY) d = CF_TINY;
+    if (fabs(c) < CF_TINY) c = CF_TINY;
+    d  = 1.0 / d;
+    e  = d * c;
+    f *= e;
+
+    if (fabs(e - 1.0) < CF_EPSILON) break;
+  }
+
+  return f;
+}
+
+/*
+ * regularized incomplete beta function I_x(a, b)
+ */
+static double
+beta_inc(double x, double a, double b)
+{
+  double lf;
+
+  if (x <= 0.0) return 0.0;
+  if (x >= 1.0) return 1.0;
+
+  lf = lgamma(a + b) - lgamma(a) - lgamma(b) + (a * log(x)) + (b * log1p(-x));
+
+  if (x < (a + 1.0) / (a + b + 2.0)) {
+    return exp(lf) * beta_cf(x, a, b) / a;
+  } else {
+    return 1.0 - (exp(lf) * beta_cf(1.0 - x, b, a) / b);
+  }
+}
+
+static double
+t_pdf(double t, double df)
+{
+  double lc;
+
+  lc = lgamma((df + 1.0) / 2.0) - lgamma(df / 2.0) - (0.5 * log(df * M_PI));
+
+  return exp(lc - (((df + 1.0) / 2.0) * log1p((t * t) / df)));
+}
+
+double
+cheap_dist_t_sf(double t, double df)
+{
+  double p;
+
+  if (isnan(t) || !(df > 0.0)) return NAN;
+  if (isinf(t)) return (t > 0.0)? 0.0: 1.0;
+
+  /* P(|T| > |t|) = I_{df / (df + t^2)}(df / 2, 1 / 2) */
+  p = 0.5 * beta_inc(df / (df + (t * t)), df / 2.0, 0.5);
+
+  return (t > 0.0)? p: 1.0 - p;
+}
+
+double
+cheap_dist_t_isf(double p, double df)
+{
+  double lo;
+  double hi;
+  double t;
+  double q;
+  double d;
+  int i;
+
+  if (!(p > 0.0 && p < 1.0) || !(df > 0.0)) return NAN;
+  if (p > 0.5) return -cheap_dist_t_isf(1.0 - p, df);
+  if (p == 0.5) return 0.0;
+
+  /*
+   * bracket the root, then newton steps on log(sf) guarded by bisection
+   * (log scale keeps the steps sane in the far tail)
+   */
+  lo = 0.0;
+  hi = 1.0;
+
+  for (i = 0; i < MAX_ITERATION && cheap_dist_t_sf(hi, df) > p; i++) {
+    lo  = hi;
+    hi *= 2.0;
+  }
+
+  t = (lo + hi) / 2.0;
+
+  for (i = 0; i < MAX_ITERATION; i++) {
+    q = cheap_dist_t_sf(t, df);
+
+    if (q > p) {
+      lo = t;
+    } else {
+      hi = t;
+    }
+
+    d = (log(q) - log(p)) * q / t_pdf(t, df);
+    t = t + d;
+
+    if (!(t > lo && t < hi)) {
+      t = (lo + hi) / 2.0;
+    }
+
+    if (fabs(d) <= ISF_EPSILON * t || (hi - lo) <= ISF_EPSILON * hi) break;
+  }
+
+  return t;
+}
+
+double
+cheap_dist_grubbs_critical(size_t n, double alpha)
+{
+  double t;
+  double t2;
+
+  if (n < 3 || !(alpha > 0.0 && alpha < 1.0)) return NAN;
+
+  /*
+   * G = ((n - 1) / sqrt(n)) * sqrt(t^2 / (n - 2 + t^2))
+   *   where t is the upper alpha / (2n) point of t(n - 2)
+   */
+  t  = cheap_dist_t_isf(alpha / (2.0 * n), (double)(n - 2));
+  t2 = t * t;
+
+  return ((n - 1) / sqrt((double)n)) * sqrt(t2 / ((n - 2) + t2));
+}
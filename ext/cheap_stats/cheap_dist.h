@@ -0,0 +1,28 @@
+﻿/*
+ * Small statics library (distribution functions)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_DIST_H__
+#define __CHEAP_DIST_H__
+
+#include <stdlib.h>
+
+/*
+ * student's t distribution of df degrees of freedom. t_sf() is the upper
+ * tail probability P(T > t), and t_isf() is the inverse of it (t of the
+ * upper tail probability p, 0 < p < 1).
+ */
+double cheap_dist_t_sf(double t, double df);
+double cheap_dist_t_isf(double p, double df);
+
+/*
+ * critical value of the two-sided Smirnov-Grubbs test for n samples at the
+ * significance level alpha (the same value is the lambda of the generalized
+ * ESD test when n is the number of the remaining samples). n must be 3 or
+ * more.
+ */
+double cheap_dist_grubbs_critical(size_t n, double alpha);
+
+#endif /* !defined(__CHEAP_DIST_H__) */
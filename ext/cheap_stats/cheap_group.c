@@ -0,0 +1,460 @@
+﻿/*
+ * Small statics library (grouped statistics)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cheap_common.h"
+#include "cheap_sort.h"
+#include "cheap_simd.h"
+#include "cheap_thread.h"
+#include "cheap_group.h"
+
+#define MIN_TABLE_SIZE        1024
+#define POLL_INTERVAL         65536
+
+typedef struct {
+  size_t size;          // power of two
+  size_t* slot;         // group number + 1 (0 is empty)
+} table_t;
+
+typedef struct {
+  cheap_group_t* ptr;
+  int threads;
+  int err;
+} task_t;
+
+static uint64_t
+hash(int64_t key)
+{
+  uint64_t x;
+
+  /* finalizer of splitmix64 */
+  x  = (uint64_t)key;
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+
+  return x;
+}
+
+static int
+grow_table(table_t* tbl, int64_t* keys)
+{
+  size_t* slot;
+  size_t size;
+  size_t mask;
+  size_t i;
+  size_t j;
+
+  size = (tbl->size > 0)? tbl->size * 2: MIN_TABLE_SIZE;
+  mask = size - 1;
+
+  slot = (size_t*)calloc(size, sizeof(size_t));
+  if (slot == NULL) return DEFAULT_ERROR;
+
+  for (i = 0; i < tbl->size; i++) {
+    if (tbl->slot[i] == 0) continue;
+
+    j = hash(keys[tbl->slot[i] - 1]) & mask;
+    while (slot[j] != 0) j = (j + 1) & mask;
+
+    slot[j] = tbl->slot[i];
+  }
+
+  if (tbl->slot) free(tbl->slot);
+
+  tbl->slot = slot;
+  tbl->size = size;
+
+  return 0;
+}
+
+static int
+assign_groups(cheap_group_t* ptr, int64_t* keys, size_t n, size_t* ids)
+{
+  int ret;
+  table_t tbl;
+  size_t mask;
+  size_t i;
+  size_t j;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  memset(&tbl, 0, sizeof(tbl));
+
+  /*
+   * number the keys in the order of the first appearance
+   * (open addressing, kept under the half load)
+   */
+  ret = grow_table(&tbl, ptr->keys);
+
+  for (i = 0; !ret && i < n; i++) {
+    if ((i % POLL_INTERVAL) == 0 && IS_INTERRUPTED()) {
+      ret = INTERRUPTED_ERROR;
+      break;
+    }
+
+    mask = tbl.size - 1;
+    j    = hash(keys[i]) & mask;
+
+    while (tbl.slot[j] != 0 && ptr->keys[tbl.slot[j] - 1] != keys[i]) {
+      j = (j + 1) & mask;
+    }
+
+    if (tbl.slot[j] == 0) {
+      ptr->keys[ptr->groups] = keys[i];
+      tbl.slot[j]            = ++ptr->groups;
+    }
+
+    ids[i] = tbl.slot[j] - 1;
+
+    /* j is not valid after the growth */
+    if (ptr->groups * 2 > tbl.size) {
+      ret = grow_table(&tbl, ptr->keys);
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (tbl.slot) free(tbl.slot);
+
+  return ret;
+}
+
+static double
+calc_quantile(double* a, size_t n, double p)
+{
+  double h;
+  double f;
+  size_t l;
+
+  /*
+   * type 7 definition (same as cheap_stats_quantile())
+   */
+  h = (n - 1) * p;
+  l = (size_t)h;
+  f = h - l;
+
+  return (f > 0.0 && (l + 1) < n)? a[l] + (f * (a[l + 1] - a[l])): a[l];
+}
+
+static int
+summarize(double* a, size_t n, cheap_group_summary_t* dst)
+{
+  int ret;
+
+  ret = cheap_sort(a, n);
+
+  if (!ret) {
+    dst->n        = n;
+    dst->total    = cheap_simd_sum(a, n);
+    dst->mean     = dst->total / n;
+    dst->min      = a[0];
+    dst->max      = a[n - 1];
+    dst->q1       = a[n / 4];
+    dst->q3       = a[(3 * n) / 4];
+    dst->median   = a[n / 2];
+    dst->variance = cheap_simd_sum_sq_dev(a, n, dst->mean) / n;
+    dst->std      = sqrt(dst->variance);
+  }
+
+  return ret;
+}
+
+static void
+summarize_task(void* _t, int index)
+{
+  task_t* t;
+  cheap_group_t* ptr;
+  size_t lo;
+  size_t hi;
+  size_t g;
+  int err;
+
+  t   = (task_t*)_t;
+  ptr = t->ptr;
+
+  /*
+   * each worker takes the groups that start in its share of the arena
+   * (balanced by the number of the samples, not by the groups)
+   */
+  lo = (ptr->n * index) / t->threads;
+  hi = (ptr->n * (index + 1)) / t->threads;
+
+  for (g = 0; g < ptr->groups; g++) {
+    if (ptr->offset[g] < lo || ptr->offset[g] >= hi) continue;
+
+    err = summarize(ptr->arena + ptr->offset[g],
+                    ptr->offset[g + 1] - ptr->offset[g], ptr->sum + g);
+
+    if (err) {
+      t->err = err;
+      break;
+    }
+  }
+}
+
+int
+cheap_group_new(int64_t* keys, double* values, size_t n, int threads,
+                cheap_group_t** dst)
+{
+  int ret;
+  cheap_group_t* ptr;
+  size_t* ids;
+  size_t* pos;
+  task_t task;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ptr = NULL;
+  ids = NULL;
+  pos = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (keys == NULL || values == NULL || n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (threads < 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * alloc memory
+   */
+  if (!ret) do {
+    ptr = ALLOC(cheap_group_t);
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    memset(ptr, 0, sizeof(*ptr));
+
+    ptr->n     = n;
+    ptr->keys  = NALLOC(int64_t, n);
+    ptr->arena = NALLOC(double, n);
+    ids        = NALLOC(size_t, n);
+
+    if (ptr->keys == NULL || ptr->arena == NULL || ids == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * hash pass (group number of each sample)
+   */
+  if (!ret) {
+    ret = assign_groups(ptr, keys, n, ids);
+  }
+
+  if (!ret) do {
+    ptr->offset = (size_t*)calloc(ptr->groups + 1, sizeof(size_t));
+    pos         = NALLOC(size_t, ptr->groups);
+    ptr->sum    = NALLOC(cheap_group_summary_t, ptr->groups);
+
+    if (ptr->offset == NULL || pos == NULL || ptr->sum == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * counting sort into the arena (stable)
+   */
+  if (!ret) {
+    for (i = 0; i < n; i++) {
+      ptr->offset[ids[i] + 1]++;
+    }
+
+    for (i = 0; i < ptr->groups; i++) {
+      ptr->offset[i + 1] += ptr->offset[i];
+      pos[i]              = ptr->offset[i];
+    }
+
+    for (i = 0; i < n; i++) {
+      ptr->arena[pos[ids[i]]++] = values[i];
+    }
+
+    if (IS_INTERRUPTED()) ret = INTERRUPTED_ERROR;
+  }
+
+  /*
+   * sort and summarize each group
+   */
+  if (!ret) {
+    task.ptr     = ptr;
+    task.threads = (threads > 1)? threads: 1;
+    task.err     = 0;
+
+    /* the arena is split by this number (same as cheap_parallel()) */
+    if (task.threads > CHEAP_MAX_THREADS) {
+      task.threads = CHEAP_MAX_THREADS;
+    }
+
+    if ((size_t)task.threads > ptr->groups) {
+      task.threads = (int)ptr->groups;
+    }
+
+    cheap_parallel(task.threads, summarize_task, &task);
+
+    ret = task.err;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (ids) free(ids);
+  if (pos) free(pos);
+
+  if (ret && ptr) {
+    cheap_group_destroy(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_group_destroy(cheap_group_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    if (ptr->keys) free(ptr->keys);
+    if (ptr->offset) free(ptr->offset);
+    if (ptr->arena) free(ptr->arena);
+    if (ptr->sum) free(ptr->sum);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_group_quantile(cheap_group_t* ptr, size_t g, double p, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || g >= ptr->groups) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (!(p >= 0.0 && p <= 1.0)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = calc_quantile(ptr->arena + ptr->offset[g], ptr->sum[g].n, p);
+  }
+
+  return ret;
+}
+
+int
+cheap_group_cdf(cheap_group_t* ptr, size_t g, double v, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL || g >= ptr->groups) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * fraction of the samples less than v (same as cheap_stats_cdf())
+   */
+  if (!ret) {
+    if (isnan(v)) {
+      *dst = NAN;
+    } else {
+      *dst = (double)cheap_lower_bound(ptr->arena + ptr->offset[g],
+                                       ptr->sum[g].n, v) / ptr->sum[g].n;
+    }
+  }
+
+  return ret;
+}
@@ -0,0 +1,57 @@
+﻿/*
+ * Small statics library (grouped statistics)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_GROUP_H__
+#define __CHEAP_GROUP_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * summary of a group (same definitions as cheap_stats_t)
+ */
+typedef struct {
+  size_t n;
+
+  double total;
+  double mean;
+  double min;
+  double max;
+  double q1;
+  double q3;
+  double median;
+  double variance;
+  double std;
+} cheap_group_summary_t;
+
+/*
+ * the samples are bucketed by the key (hash pass and counting sort) into
+ * one arena, and each bucket is sorted in place. the groups are numbered
+ * in the order of the first appearance of the key.
+ */
+typedef struct {
+  size_t n;
+  size_t groups;
+
+  int64_t* keys;                 // key of each group
+  size_t* offset;                // start of each group in arena (+ sentinel)
+  double* arena;                 // samples sorted by group, then by value
+  cheap_group_summary_t* sum;    // summary of each group
+} cheap_group_t;
+
+/*
+ * threads is the number of threads for the sort and the summaries (0 or 1
+ * means single thread). CHEAP_STATS_INTERRUPTED is returned when it was
+ * interrupted (see cheap_stats_set_interrupt()).
+ */
+int cheap_group_new(int64_t* keys, double* values, size_t n, int threads,
+                    cheap_group_t** obj);
+int cheap_group_destroy(cheap_group_t* obj);
+
+int cheap_group_quantile(cheap_group_t* obj, size_t g, double p, double* dst);
+int cheap_group_cdf(cheap_group_t* obj, size_t g, double v, double* dst);
+
+#endif /* !defined(__CHEAP_GROUP_H__) */
@@ -0,0 +1,719 @@
+﻿/*
+ * Small statics library (log-bucketed histogram)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cheap_common.h"
+#include "cheap_hdr.h"
+
+#define MIN_DIGITS            1
+#define MAX_DIGITS            5
+#define MAX_BUCKETS           (1 << 24)
+#define MANTISSA_BITS         52
+
+#define DUMP_MAGIC            "CHDR"
+#define DUMP_VERSION          1
+#define DUMP_BYTE_ORDER       0x01020304U
+#define DUMP_HEADER_SIZE      64
+
+static int64_t
+to_key(cheap_hdr_t* ptr, double v)
+{
+  uint64_t bits;
+
+  /*
+   * the bit pattern of the non-negative double is monotonic, so the
+   * exponent and the upper mantissa bits make the log-linear bucket key
+   */
+  memcpy(&bits, &v, sizeof(bits));
+
+  return (int64_t)(bits >> (MANTISSA_BITS - ptr->sub_bits));
+}
+
+static double
+from_key(cheap_hdr_t* ptr, int64_t key)
+{
+  uint64_t bits;
+  double ret;
+
+  bits = (uint64_t)key << (MANTISSA_BITS - ptr->sub_bits);
+  memcpy(&ret, &bits, sizeof(ret));
+
+  return ret;
+}
+
+static size_t
+to_index(cheap_hdr_t* ptr, double v)
+{
+  int64_t i;
+
+  if (v < ptr->lowest) return 0;
+
+  i = to_key(ptr, v) - ptr->base + 1;
+
+  return ((size_t)i < ptr->size)? (size_t)i: ptr->size - 1;
+}
+
+static double
+bucket_value(cheap_hdr_t* ptr, size_t i)
+{
+  double lo;
+  double hi;
+  double ret;
+
+  /*
+   * middle of the bucket (clipped with the exact min and max)
+   */
+  if (i == 0) {
+    lo = 0.0;
+    hi = ptr->lowest;
+  } else {
+    lo = from_key(ptr, ptr->base + (int64_t)i - 1);
+    hi = from_key(ptr, ptr->base + (int64_t)i);
+  }
+
+  ret = lo + ((hi - lo) / 2.0);
+
+  if (ret < ptr->min) ret = ptr->min;
+  if (ret > ptr->max) ret = ptr->max;
+
+  return ret;
+}
+
+static void
+reset(cheap_hdr_t* ptr)
+{
+  memset(ptr->counts, 0, sizeof(uint64_t) * ptr->size);
+
+  ptr->n     = 0;
+  ptr->total = 0.0;
+  ptr->min   = NAN;
+  ptr->max   = NAN;
+}
+
+int
+cheap_hdr_new(double lowest, double highest, int digits, cheap_hdr_t** dst)
+{
+  int ret;
+  cheap_hdr_t* ptr;
+  int sub_bits;
+  int64_t span;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ptr = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (digits < MIN_DIGITS || digits > MAX_DIGITS) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (!(lowest > 0.0) || !(highest > lowest) || isinf(highest)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc layout (2^sub_bits buckets for each power of two, so the width of
+   * the bucket is less than 10^-digits of its value)
+   */
+  if (!ret) do {
+    sub_bits = (int)ceil(digits * log2(10.0));
+
+    ptr = ALLOC(cheap_hdr_t);
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    memset(ptr, 0, sizeof(*ptr));
+
+    ptr->digits   = digits;
+    ptr->sub_bits = sub_bits;
+    ptr->lowest   = lowest;
+    ptr->highest  = highest;
+    ptr->base     = to_key(ptr, lowest);
+
+    span = to_key(ptr, highest) - ptr->base;
+    if (span + 2 > MAX_BUCKETS) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ptr->size = (size_t)(span + 2);
+  } while (0);
+
+  /*
+   * alloc buckets
+   */
+  if (!ret) {
+    ptr->counts = NALLOC(uint64_t, ptr->size);
+    if (ptr->counts == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    reset(ptr);
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (ret && ptr != NULL) {
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_hdr_destroy(cheap_hdr_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    if (ptr->counts) free(ptr->counts);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_hdr_clear(cheap_hdr_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * reset counts
+   */
+  if (!ret) {
+    reset(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_hdr_record(cheap_hdr_t* ptr, double v)
+{
+  return cheap_hdr_record_many(ptr, &v, 1);
+}
+
+int
+cheap_hdr_record_many(cheap_hdr_t* ptr, double* a, size_t n)
+{
+  int ret;
+  size_t i;
+  double v;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (a == NULL && n > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * count samples (stop at the invalid value, the values before it are
+   * recorded)
+   */
+  for (i = 0; !ret && i < n; i++) {
+    v = a[i];
+
+    if (!(v >= 0.0)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0 || v < ptr->min) ptr->min = v;
+    if (ptr->n == 0 || v > ptr->max) ptr->max = v;
+
+    ptr->counts[to_index(ptr, v)]++;
+    ptr->total += v;
+    ptr->n++;
+  }
+
+  return ret;
+}
+
+int
+cheap_hdr_merge(cheap_hdr_t* ptr, cheap_hdr_t* src)
+{
+  int ret;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (src == NULL || src == ptr) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->digits != src->digits ||
+        ptr->lowest != src->lowest || ptr->highest != src->highest) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * add counts
+   */
+  if (!ret && src->n > 0) {
+    for (i = 0; i < ptr->size; i++) {
+      ptr->counts[i] += src->counts[i];
+    }
+
+    if (ptr->n == 0 || src->min < ptr->min) ptr->min = src->min;
+    if (ptr->n == 0 || src->max > ptr->max) ptr->max = src->max;
+
+    ptr->n     += src->n;
+    ptr->total += src->total;
+  }
+
+  return ret;
+}
+
+static int
+check_query(cheap_hdr_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  return ret;
+}
+
+int
+cheap_hdr_mean(cheap_hdr_t* ptr, double* dst)
+{
+  int ret;
+
+  ret = check_query(ptr, dst);
+  if (!ret) *dst = ptr->total / ptr->n;
+
+  return ret;
+}
+
+int
+cheap_hdr_percentile(cheap_hdr_t* ptr, double pct, double* dst)
+{
+  int ret;
+  uint64_t r;
+  uint64_t c;
+  size_t i;
+
+  /*
+   * value of the bucket that contains the rank
+   */
+  if (!(pct >= 0.0 && pct <= 100.0)) {
+    ret = DEFAULT_ERROR;
+  } else {
+    ret = check_query(ptr, dst);
+  }
+
+  if (!ret) {
+    if (pct == 0.0) {
+      *dst = ptr->min;
+
+    } else if (pct == 100.0) {
+      *dst = ptr->max;
+
+    } else {
+      r = (uint64_t)((ptr->n - 1) * (pct / 100.0));
+
+      for (i = 0, c = 0; i < ptr->size - 1; i++) {
+        c += ptr->counts[i];
+        if (c > r) break;
+      }
+
+      *dst = bucket_value(ptr, i);
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_hdr_cdf(cheap_hdr_t* ptr, double v, double* dst)
+{
+  int ret;
+  uint64_t c;
+  size_t e;
+  size_t i;
+
+  ret = check_query(ptr, dst);
+
+  /*
+   * counts of the buckets below the bucket of v
+   */
+  if (!ret) {
+    if (isnan(v)) {
+      *dst = NAN;
+
+    } else if (v <= ptr->min) {
+      *dst = 0.0;
+
+    } else if (v > ptr->max) {
+      *dst = 1.0;
+
+    } else {
+      e = to_index(ptr, v);
+
+      for (i = 0, c = 0; i < e; i++) {
+        c += ptr->counts[i];
+      }
+
+      *dst = (double)c / ptr->n;
+    }
+  }
+
+  return ret;
+}
+
+static void
+put(unsigned char** p, const void* src, size_t n)
+{
+  memcpy(*p, src, n);
+  *p += n;
+}
+
+static void
+get(const unsigned char** p, void* dst, size_t n)
+{
+  memcpy(dst, *p, n);
+  *p += n;
+}
+
+static size_t
+varint_size(uint64_t v)
+{
+  size_t ret;
+
+  for (ret = 1; v >= 0x80; v >>= 7) ret++;
+
+  return ret;
+}
+
+static void
+put_varint(unsigned char** p, uint64_t v)
+{
+  while (v >= 0x80) {
+    *(*p)++ = (unsigned char)(v | 0x80);
+    v >>= 7;
+  }
+
+  *(*p)++ = (unsigned char)v;
+}
+
+static int
+get_varint(const unsigned char** p, const unsigned char* tail, uint64_t* dst)
+{
+  uint64_t v;
+  int sft;
+
+  for (v = 0, sft = 0; *p < tail && sft < 64; sft += 7) {
+    v |= (uint64_t)(**p & 0x7f) << sft;
+
+    if (!(*(*p)++ & 0x80)) {
+      *dst = v;
+      return 0;
+    }
+  }
+
+  return DEFAULT_ERROR;
+}
+
+int
+cheap_hdr_dump(cheap_hdr_t* ptr, void* buf, size_t size, size_t* len)
+{
+  int ret;
+  unsigned char* p;
+  uint32_t u32;
+  uint64_t u64;
+  size_t sz;
+  size_t prev;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (len == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc size
+   *   header (64 bytes):
+   *     magic[4], byte order(u32), version(u32), digits(u32), lowest(f64),
+   *     highest(f64), n(u64), total(f64), min(f64), max(f64)
+   *   then the pairs of the gap from the previous non-empty bucket and the
+   *   count (LEB128)
+   */
+  if (!ret) {
+    sz = DUMP_HEADER_SIZE;
+
+    for (i = 0, prev = 0; i < ptr->size; i++) {
+      if (ptr->counts[i] > 0) {
+        sz   += varint_size(i - prev) + varint_size(ptr->counts[i]);
+        prev  = i;
+      }
+    }
+
+    *len = sz;
+  }
+
+  /*
+   * write data
+   */
+  if (!ret && buf != NULL && size >= sz) {
+    p = (unsigned char*)buf;
+
+    put(&p, DUMP_MAGIC, 4);
+    u32 = DUMP_BYTE_ORDER;   put(&p, &u32, sizeof(u32));
+    u32 = DUMP_VERSION;      put(&p, &u32, sizeof(u32));
+    u32 = ptr->digits;       put(&p, &u32, sizeof(u32));
+    put(&p, &ptr->lowest, sizeof(double));
+    put(&p, &ptr->highest, sizeof(double));
+    u64 = ptr->n;            put(&p, &u64, sizeof(u64));
+    put(&p, &ptr->total, sizeof(double));
+    put(&p, &ptr->min, sizeof(double));
+    put(&p, &ptr->max, sizeof(double));
+
+    for (i = 0, prev = 0; i < ptr->size; i++) {
+      if (ptr->counts[i] > 0) {
+        put_varint(&p, i - prev);
+        put_varint(&p, ptr->counts[i]);
+        prev = i;
+      }
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_hdr_load(const void* buf, size_t size, cheap_hdr_t** dst)
+{
+  int ret;
+  const unsigned char* p;
+  const unsigned char* tail;
+  char magic[4];
+  uint32_t order;
+  uint32_t version;
+  uint32_t digits;
+  double lowest;
+  double highest;
+  uint64_t n;
+  uint64_t gap;
+  uint64_t cnt;
+  uint64_t sum;
+  uint64_t i;
+  cheap_hdr_t* ptr;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  ptr  = NULL;
+  p    = (const unsigned char*)buf;
+  tail = p + size;
+
+  /*
+   * argument check
+   */
+  do {
+    if (buf == NULL || size < DUMP_HEADER_SIZE) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * read header
+   */
+  if (!ret) do {
+    get(&p, magic, 4);
+    get(&p, &order, sizeof(order));
+    get(&p, &version, sizeof(version));
+    get(&p, &digits, sizeof(digits));
+    get(&p, &lowest, sizeof(lowest));
+    get(&p, &highest, sizeof(highest));
+    get(&p, &n, sizeof(n));
+
+    if (memcmp(magic, DUMP_MAGIC, 4) != 0 || order != DUMP_BYTE_ORDER) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (version != DUMP_VERSION) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ret = cheap_hdr_new(lowest, highest, (int)digits, &ptr);
+  } while (0);
+
+  /*
+   * read buckets (the sum of the counts must be same as n)
+   */
+  if (!ret) do {
+    get(&p, &ptr->total, sizeof(double));
+    get(&p, &ptr->min, sizeof(double));
+    get(&p, &ptr->max, sizeof(double));
+
+    for (i = 0, sum = 0; !ret && p < tail; i += gap) {
+      ret = get_varint(&p, tail, &gap);
+      if (!ret) ret = get_varint(&p, tail, &cnt);
+
+      if (!ret && (gap > ptr->size || i + gap >= ptr->size || cnt == 0)) {
+        ret = DEFAULT_ERROR;
+      }
+
+      if (!ret) {
+        ptr->counts[i + gap] += cnt;
+        sum                  += cnt;
+      }
+    }
+
+    if (ret) break;
+
+    if (sum != n) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ptr->n = n;
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (ret && ptr != NULL) {
+    cheap_hdr_destroy(ptr);
+  }
+
+  return ret;
+}
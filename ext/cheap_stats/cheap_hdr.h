@@ -0,0 +1,76 @@
+﻿/*
+ * Small statics library (log-bucketed histogram)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_HDR_H__
+#define __CHEAP_HDR_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CHEAP_HDR_DEFAULT_LOWEST    1.0e-3
+#define CHEAP_HDR_DEFAULT_HIGHEST   1.0e+6
+#define CHEAP_HDR_DEFAULT_DIGITS    3
+
+/*
+ * HDR style histogram for the positive values (latency etc.). each power
+ * of two between lowest and highest is split into 2^sub_bits linear
+ * buckets, so the bucket index is taken from the exponent and the upper
+ * mantissa bits of the double directly (O(1) recording). the relative
+ * error of the reported values is within 10^-digits.
+ *
+ * bucket 0 counts the values less than lowest (including zero), and the
+ * values greater than highest are counted in the last bucket. total, min
+ * and max are exact.
+ */
+typedef struct {
+  int digits;
+  int sub_bits;
+  double lowest;
+  double highest;
+  int64_t base;         // bucket key of lowest
+  size_t size;          // number of buckets
+  uint64_t* counts;
+
+  uint64_t n;
+  double total;
+  double min;
+  double max;
+} cheap_hdr_t;
+
+int cheap_hdr_new(double lowest, double highest, int digits,
+                  cheap_hdr_t** obj);
+int cheap_hdr_destroy(cheap_hdr_t* obj);
+int cheap_hdr_clear(cheap_hdr_t* obj);
+
+/*
+ * negative value and NaN are rejected
+ */
+int cheap_hdr_record(cheap_hdr_t* obj, double v);
+int cheap_hdr_record_many(cheap_hdr_t* obj, double* a, size_t n);
+
+/*
+ * histograms must have the same configuration
+ */
+int cheap_hdr_merge(cheap_hdr_t* obj, cheap_hdr_t* src);
+
+/*
+ * query functions fail when the histogram is empty. percentile() takes
+ * 0..100, and cdf() is the fraction of the samples in the buckets below
+ * the bucket of the value.
+ */
+int cheap_hdr_mean(cheap_hdr_t* obj, double* dst);
+int cheap_hdr_percentile(cheap_hdr_t* obj, double pct, double* dst);
+int cheap_hdr_cdf(cheap_hdr_t* obj, double v, double* dst);
+
+/*
+ * serialized form (non-empty buckets as LEB128 coded gap and count pairs,
+ * native byte order for the header). same convention as cheap_sketch_dump()
+ * for the buffer size.
+ */
+int cheap_hdr_dump(cheap_hdr_t* obj, void* buf, size_t size, size_t* len);
+int cheap_hdr_load(const void* buf, size_t size, cheap_hdr_t** obj);
+
+#endif /* !defined(__CHEAP_HDR_H__) */
@@ -0,0 +1,305 @@
+﻿/*
+ * Small statics library (kernel density estimation)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cheap_common.h"
+#include "cheap_sort.h"
+#include "cheap_kde.h"
+
+/*
+ * kernel is cut off at CUTOFF * h (exp(-0.5 * 8^2) < 1.3e-14)
+ */
+#define CUTOFF                8.0
+
+/*
+ * grid spacing used for binning should be finer than h / MIN_RESOLUTION
+ */
+#define MIN_RESOLUTION        4.0
+
+/*
+ * the FFT grid larger than this is not used (fall back to point queries)
+ */
+#define MAX_FFT_SIZE          ((size_t)1 << 22)
+
+static double
+kernel_gaussian(double x)
+{
+  // 2.50662827463 == sqrt(2.0 * M_PI)
+  return exp(-(x * x) / 2.0) / 2.50662827463;
+}
+
+/*
+ * in-place radix-2 complex FFT (n must be power of 2)
+ */
+static void
+fft(double* re, double* im, size_t n, int inverse)
+{
+  size_t i;
+  size_t j;
+  size_t k;
+  size_t l;
+  double t;
+  double wr;
+  double wi;
+  double ur;
+  double ui;
+  double xr;
+  double xi;
+  double th;
+
+  /*
+   * bit reversal permutation
+   */
+  for (i = 1, j = 0; i < n; i++) {
+    for (k = n >> 1; j & k; k >>= 1) j ^= k;
+    j ^= k;
+
+    if (i < j) {
+      t = re[i]; re[i] = re[j]; re[j] = t;
+      t = im[i]; im[i] = im[j]; im[j] = t;
+    }
+  }
+
+  /*
+   * butterflies
+   */
+  for (l = 2; l <= n; l <<= 1) {
+    th = (inverse? 2.0: -2.0) * M_PI / l;
+    wr = cos(th);
+    wi = sin(th);
+
+    for (i = 0; i < n; i += l) {
+      ur = 1.0;
+      ui = 0.0;
+
+      for (j = 0; j < l / 2; j++) {
+        k  = i + j + (l / 2);
+        xr = (re[k] * ur) - (im[k] * ui);
+        xi = (re[k] * ui) + (im[k] * ur);
+
+        re[k]      = re[i + j] - xr;
+        im[k]      = im[i + j] - xi;
+        re[i + j] += xr;
+        im[i + j] += xi;
+
+        t  = (ur * wr) - (ui * wi);
+        ui = (ur * wi) + (ui * wr);
+        ur = t;
+      }
+    }
+  }
+
+  if (inverse) {
+    for (i = 0; i < n; i++) {
+      re[i] /= n;
+      im[i] /= n;
+    }
+  }
+}
+
+double
+cheap_kde_bandwidth(double n, double sig)
+{
+  /*
+   * Silverman's rule of thumb
+   */
+  return (0.9 * sig) / pow(n, 1.0 / 5.0);
+}
+
+double
+cheap_kde_point(double* a, size_t n, double h, double v)
+{
+  size_t i;
+  size_t l;
+  size_t r;
+  double s;
+
+  /*
+   * sum only the samples in the range of the cut off
+   */
+  l = cheap_lower_bound(a, n, v - (CUTOFF * h));
+  r = cheap_lower_bound(a, n, v + (CUTOFF * h));
+  s = 0.0;
+
+  for (i = l; i < r; i++) {
+    s += kernel_gaussian((v - a[i]) / h);
+  }
+
+  return (s / (n * h));
+}
+
+double
+cheap_kde_point_weighted(double* a, double* w, size_t n,
+                         double weight, double h, double v)
+{
+  size_t i;
+  size_t l;
+  size_t r;
+  double s;
+
+  /*
+   * same as cheap_kde_point() (each value counts w[i] times)
+   */
+  l = cheap_lower_bound(a, n, v - (CUTOFF * h));
+  r = cheap_lower_bound(a, n, v + (CUTOFF * h));
+  s = 0.0;
+
+  for (i = l; i < r; i++) {
+    s += w[i] * kernel_gaussian((v - a[i]) / h);
+  }
+
+  return (s / (weight * h));
+}
+
+int
+cheap_kde_grid(double* a, size_t n, double h,
+               double lo, double hi, size_t m, double* dst)
+{
+  int ret;
+  double* buf;
+  double* re;
+  double* im;
+  double* kr;
+  double* ki;
+  double d;
+  double g0;
+  double pos;
+  double w;
+  double t;
+  size_t r;
+  size_t p;
+  size_t l;
+  size_t sz;
+  size_t i;
+  size_t j;
+  size_t b;
+  size_t e;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  buf = NULL;
+
+  /*
+   * decide the binning grid. output points are on every r-th bin, and
+   * the grid is extended by the cut off length (p bins) on both sides.
+   */
+  if (m > 1 && hi > lo) {
+    d = (hi - lo) / (m - 1);
+    r = (d > (h / MIN_RESOLUTION))? (size_t)ceil(d / (h / MIN_RESOLUTION)): 1;
+    d /= r;
+  } else {
+    d = h / MIN_RESOLUTION;
+    r = 1;
+  }
+
+  if (m > 1 && !(hi > lo)) {
+    /* zero width range has no grid spacing */
+    sz = MAX_FFT_SIZE + 1;
+
+  } else if (((CUTOFF * h) / d) > MAX_FFT_SIZE) {
+    sz = MAX_FFT_SIZE + 1;
+
+  } else {
+    p  = (size_t)ceil((CUTOFF * h) / d);
+    l  = ((m - 1) * r) + 1 + (p * 2);
+
+    for (sz = 1; sz < (l + p) && sz <= MAX_FFT_SIZE; sz <<= 1);
+  }
+
+  /*
+   * too fine grid (or zero width range), evaluate each point directly
+   */
+  if (sz > MAX_FFT_SIZE) {
+    for (i = 0; i < m; i++) {
+      if (IS_INTERRUPTED()) {
+        ret = INTERRUPTED_ERROR;
+        break;
+      }
+
+      t      = (m > 1)? lo + (((hi - lo) * i) / (m - 1)): lo;
+      dst[i] = cheap_kde_point(a, n, h, t);
+    }
+
+    return ret;
+  }
+
+  /*
+   * alloc memory
+   */
+  buf = calloc(sz * 4, sizeof(double));
+  if (buf == NULL) ret = DEFAULT_ERROR;
+
+  if (!ret) {
+    re = buf;
+    im = buf + sz;
+    kr = buf + (sz * 2);
+    ki = buf + (sz * 3);
+    g0 = lo - (p * d);
+
+    /*
+     * linear binning (samples out of the grid have no effect to the
+     * output points)
+     */
+    b = cheap_lower_bound(a, n, g0);
+    e = cheap_lower_bound(a, n, g0 + ((l - 1) * d));
+
+    for (i = b; i < e; i++) {
+      pos = (a[i] - g0) / d;
+      j   = (size_t)pos;
+      w   = pos - j;
+
+      if (j >= l) continue;
+
+      re[j] += 1.0 - w;
+      if ((j + 1) < l) re[j + 1] += w;
+    }
+
+    /*
+     * sampled kernel (wrapped around)
+     */
+    for (i = 0; i <= p; i++) {
+      t = kernel_gaussian((i * d) / h);
+
+      kr[i] = t;
+      if (i > 0) kr[sz - i] = t;
+    }
+
+    /*
+     * circular convolution by FFT
+     */
+    fft(re, im, sz, 0);
+    fft(kr, ki, sz, 0);
+
+    for (i = 0; i < sz; i++) {
+      t     = (re[i] * kr[i]) - (im[i] * ki[i]);
+      im[i] = (re[i] * ki[i]) + (im[i] * kr[i]);
+      re[i] = t;
+    }
+
+    fft(re, im, sz, !0);
+
+    /*
+     * put return parameter
+     */
+    for (i = 0; i < m; i++) {
+      t      = re[p + (i * r)] / (n * h);
+      dst[i] = (t > 0.0)? t: 0.0;
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (buf) free(buf);
+
+  return ret;
+}
@@ -0,0 +1,22 @@
+﻿/*
+ * Small statics library (kernel density estimation)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_KDE_H__
+#define __CHEAP_KDE_H__
+
+#include <stdlib.h>
+
+/*
+ * gaussian kernel. all functions take the sorted samples.
+ */
+double cheap_kde_bandwidth(double n, double sig);
+double cheap_kde_point(double* a, size_t n, double h, double v);
+double cheap_kde_point_weighted(double* a, double* w, size_t n,
+                                double weight, double h, double v);
+int cheap_kde_grid(double* a, size_t n, double h,
+                   double lo, double hi, size_t m, double* dst);
+
+#endif /* !defined(__CHEAP_KDE_H__) */
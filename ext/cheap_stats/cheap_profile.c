@@ -0,0 +1,25 @@
+﻿/*
+ * Small statics library (profiling)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "cheap_profile.h"
+
+#ifdef CHEAP_PROFILE
+__thread cheap_profile_t* cheap_profile_current = NULL;
+
+double
+cheap_profile_now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + (ts.tv_nsec * 1e-9);
+}
+#endif /* defined(CHEAP_PROFILE) */
@@ -0,0 +1,85 @@
+﻿/*
+ * Small statics library (profiling)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_PROFILE_H__
+#define __CHEAP_PROFILE_H__
+
+#include <stdlib.h>
+
+/*
+ * phases of the computation
+ */
+#define CHEAP_PROFILE_CONVERT     0   // conversion of the source (wrapper)
+#define CHEAP_PROFILE_COPY        1   // copy of the samples
+#define CHEAP_PROFILE_SUM         2   // total and mean
+#define CHEAP_PROFILE_SORT        3
+#define CHEAP_PROFILE_SELECT      4   // partial ordering for the quantiles
+#define CHEAP_PROFILE_SEARCH      5   // CDF
+#define CHEAP_PROFILE_VARIANCE    6
+#define CHEAP_PROFILE_MOMENTS     7
+#define CHEAP_PROFILE_KDE         8
+#define CHEAP_PROFILE_PHASES      9
+
+/*
+ * accumulated on each object when the library is built with CHEAP_PROFILE
+ * (see cheap_stats_profile()). the counters are taken on the calling
+ * thread; the multithreaded sort counts the moves of its passes instead
+ * of the workers.
+ *
+ *   compares   comparisons of the sort, the selection and the searches
+ *   swaps      swaps of the comparison sorts, and the element moves of
+ *              the insertion sort and the radix sort passes
+ */
+typedef struct {
+  double time[CHEAP_PROFILE_PHASES];    // elapsed seconds (monotonic clock)
+  size_t calls[CHEAP_PROFILE_PHASES];
+  size_t bytes_copied;
+  size_t allocs;
+  size_t compares;
+  size_t swaps;
+
+  double start[CHEAP_PROFILE_PHASES];   // (internal use)
+} cheap_profile_t;
+
+/*
+ * instrumentation (all of them are compiled to nothing without
+ * CHEAP_PROFILE). the phases must not be nested, and PROF_ADD() counts
+ * into the phase that is running on the calling thread. accumulate the
+ * counts of the inner loops into a local, and add it once after the loop
+ * (PROF_ADD() reads the thread local variable).
+ */
+#ifdef CHEAP_PROFILE
+extern __thread cheap_profile_t* cheap_profile_current;
+
+double cheap_profile_now(void);
+
+#define PROF_BEGIN(p,ph) \
+      do { \
+        cheap_profile_current = (p); \
+        (p)->start[ph]        = cheap_profile_now(); \
+      } while (0)
+
+#define PROF_END(p,ph) \
+      do { \
+        (p)->time[ph]        += cheap_profile_now() - (p)->start[ph]; \
+        (p)->calls[ph]++; \
+        cheap_profile_current = NULL; \
+      } while (0)
+
+#define PROF_ADD(field,k) \
+      do { \
+        if (cheap_profile_current != NULL) { \
+          cheap_profile_current->field += (k); \
+        } \
+      } while (0)
+
+#else /* defined(CHEAP_PROFILE) */
+#define PROF_BEGIN(p,ph)
+#define PROF_END(p,ph)
+#define PROF_ADD(field,k) do { (void)(k); } while (0)
+#endif /* defined(CHEAP_PROFILE) */
+
+#endif /* !defined(__CHEAP_PROFILE_H__) */
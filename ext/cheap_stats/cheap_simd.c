@@ -0,0 +1,635 @@
+﻿/*
+ * Small statics library (SIMD reduction kernels)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#include "cheap_common.h"
+#include "cheap_simd.h"
+#include "cheap_thread.h"
+
+/*
+ * number of elements summed up directly by the kernel (the block sums
+ * are added pairwise)
+ */
+#define BLOCK_SIZE            4096
+
+/*
+ * the parallel reduction gives each worker the leaves of this size
+ */
+#define PARALLEL_GRAIN        (BLOCK_SIZE * 64)
+
+#define KIND_SUM              0
+#define KIND_SQ_DEV           1
+#define KIND_POWERS           2
+
+#define MAP_Z_SCORES          0
+#define MAP_NORMAL_PDF        1
+#define MAP_NORMAL_CDF        2
+
+/*
+ * constants of the element-wise math kernels (cheap_simd_math.h)
+ */
+#define LN2_HI                6.93147180369123816490e-01
+#define LN2_LO                1.90821492927058770002e-10
+#define LOG2E                 1.44269504088896338700e+00
+#define SHIFTER               6755399441055744.0  // 1.5 * 2^52
+#define EXP_MIN               (-708.0)
+#define SIGN_MASK             ((int64_t)1 << 63)
+#define ERFC_TERMS            28
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_X86_KERNELS      1
+#endif
+
+typedef struct {
+  double (*sum)(double* a, size_t n);
+  double (*sum_sq_dev)(double* a, size_t n, double c);
+  void (*sum_dev_powers)(double* a, size_t n, double c, double* dst);
+  void (*z_scores)(double* a, size_t n, double c, double s, double* dst);
+  void (*normal_pdf)(double* a, size_t n,
+                     double c, double s, double scale, double* dst);
+  void (*normal_cdf)(double* a, size_t n, double c, double s, double* dst);
+} kernel_set_t;
+
+typedef struct {
+  const kernel_set_t* ks;
+  int kind;
+  int width;
+  int threads;
+  double c;
+
+  size_t n_leaf;
+  double** leaf;
+  size_t* len;
+  double* res;
+} reduce_t;
+
+typedef struct {
+  const kernel_set_t* ks;
+  int kind;
+  int threads;
+  double c;
+  double s;
+  double scale;
+
+  double* a;
+  size_t n;
+  double* dst;
+} map_t;
+
+/*
+ * Chebyshev coefficients of log(erfc(z) * exp(z^2) / t) on t = 2 / (2 + z)
+ * (z >= 0). the relative error of erfc() is below 1e-14 for z < 10.
+ */
+static const double erfc_coef[ERFC_TERMS] = {
+  -1.30265371978170941e+00,  6.41969792356490210e-01,
+   1.94764732041858360e-02, -9.56151478680863226e-03,
+  -9.46595344482036916e-04,  3.66839497852761447e-04,
+   4.25233248069077689e-05, -2.02785781125342418e-05,
+  -1.62429000464702561e-06,  1.30365583558052324e-06,
+   1.56264417220661419e-08, -8.52380959149265415e-08,
+   6.52905443909885149e-09,  5.05934349555146930e-09,
+  -9.91364156493033066e-10, -2.27365122293183597e-10,
+   9.64679110201552702e-11,  2.39403808303911459e-12,
+  -6.88602752649755322e-12,  8.94487927309072531e-13,
+   3.13092139934295813e-13, -1.12708223613672523e-13,
+   3.81090525518923205e-16,  7.10609761360923712e-15,
+  -1.52302820145710434e-15, -9.45749457129123340e-17,
+   1.21023718922427899e-16, -2.81666308774717710e-17,
+};
+
+/*
+ * scalar version
+ */
+#define KERNEL(name)          scalar_##name
+#define TARGET
+#define VEC                   double
+#define LANES                 1
+#include "cheap_simd_kernel.h"
+#undef KERNEL
+#undef TARGET
+#undef VEC
+#undef LANES
+
+static void
+scalar_normal_pdf(double* a, size_t n,
+                  double c, double s, double scale, double* dst)
+{
+  double t;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    t      = (a[i] - c) / s;
+    dst[i] = exp(-0.5 * (t * t)) * scale;
+  }
+}
+
+static void
+scalar_normal_cdf(double* a, size_t n, double c, double s, double* dst)
+{
+  double t;
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    t      = (a[i] - c) / s;
+    dst[i] = 0.5 * erfc(-t * M_SQRT1_2);
+  }
+}
+
+#ifdef HAVE_X86_KERNELS
+typedef double v2d_t __attribute__((vector_size(16)));
+typedef double v4d_t __attribute__((vector_size(32)));
+typedef double v8d_t __attribute__((vector_size(64)));
+typedef int64_t v2i_t __attribute__((vector_size(16)));
+typedef int64_t v4i_t __attribute__((vector_size(32)));
+typedef int64_t v8i_t __attribute__((vector_size(64)));
+
+/*
+ * SSE2 version
+ */
+#define KERNEL(name)          sse2_##name
+#define TARGET                __attribute__((target("sse2")))
+#define VEC                   v2d_t
+#define LANES                 2
+#define IVEC                  v2i_t
+#include "cheap_simd_kernel.h"
+#include "cheap_simd_math.h"
+#undef KERNEL
+#undef TARGET
+#undef VEC
+#undef LANES
+#undef IVEC
+
+/*
+ * AVX2 version
+ */
+#define KERNEL(name)          avx2_##name
+#define TARGET                __attribute__((target("avx2")))
+#define VEC                   v4d_t
+#define LANES                 4
+#define IVEC                  v4i_t
+#include "cheap_simd_kernel.h"
+#include "cheap_simd_math.h"
+#undef KERNEL
+#undef TARGET
+#undef VEC
+#undef LANES
+#undef IVEC
+
+/*
+ * AVX-512 version
+ */
+#define KERNEL(name)          avx512_##name
+#define TARGET                __attribute__((target("avx512f")))
+#define VEC                   v8d_t
+#define LANES                 8
+#define IVEC                  v8i_t
+#include "cheap_simd_kernel.h"
+#include "cheap_simd_math.h"
+#undef KERNEL
+#undef TARGET
+#undef VEC
+#undef LANES
+#undef IVEC
+#endif /* defined(HAVE_X86_KERNELS) */
+
+static const kernel_set_t kernel_sets[] = {
+  {
+    scalar_sum, scalar_sum_sq_dev, scalar_sum_dev_powers,
+    scalar_z_scores, scalar_normal_pdf, scalar_normal_cdf
+  },
+#ifdef HAVE_X86_KERNELS
+  {
+    sse2_sum, sse2_sum_sq_dev, sse2_sum_dev_powers,
+    sse2_z_scores, sse2_normal_pdf, sse2_normal_cdf
+  },
+  {
+    avx2_sum, avx2_sum_sq_dev, avx2_sum_dev_powers,
+    avx2_z_scores, avx2_normal_pdf, avx2_normal_cdf
+  },
+  {
+    avx512_sum, avx512_sum_sq_dev, avx512_sum_dev_powers,
+    avx512_z_scores, avx512_normal_pdf, avx512_normal_cdf
+  },
+#endif /* defined(HAVE_X86_KERNELS) */
+};
+
+static const char* level_names[] = {
+  "scalar",
+  "sse2",
+  "avx2",
+  "avx512",
+};
+
+static int current_level = -1;
+
+static int
+detect_level(void)
+{
+  int ret;
+
+  ret = CHEAP_SIMD_SCALAR;
+
+#ifdef HAVE_X86_KERNELS
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("sse2")) ret = CHEAP_SIMD_SSE2;
+  if (__builtin_cpu_supports("avx2")) ret = CHEAP_SIMD_AVX2;
+  if (__builtin_cpu_supports("avx512f")) ret = CHEAP_SIMD_AVX512;
+#endif /* defined(HAVE_X86_KERNELS) */
+
+  return ret;
+}
+
+static const kernel_set_t*
+get_kernels(void)
+{
+  const char* env;
+  int i;
+
+  if (current_level < 0) {
+    env = getenv("CHEAP_STATS_SIMD");
+    i   = CHEAP_SIMD_AVX512;
+
+    if (env != NULL) {
+      for (i = 0; i < (int)(sizeof(level_names) / sizeof(*level_names)); i++) {
+        if (strcasecmp(env, level_names[i]) == 0) break;
+      }
+    }
+
+    cheap_simd_select(i);
+  }
+
+  return kernel_sets + current_level;
+}
+
+int
+cheap_simd_select(int level)
+{
+  int max;
+
+  max = detect_level();
+
+  if (level < CHEAP_SIMD_SCALAR) level = CHEAP_SIMD_SCALAR;
+  if (level > max) level = max;
+
+  current_level = level;
+
+  return level;
+}
+
+int
+cheap_simd_level(void)
+{
+  get_kernels();
+
+  return current_level;
+}
+
+const char*
+cheap_simd_name(int level)
+{
+  const char* ret;
+
+  if (level >= 0 && level < (int)(sizeof(level_names) / sizeof(*level_names))) {
+    ret = level_names[level];
+  } else {
+    ret = NULL;
+  }
+
+  return ret;
+}
+
+static double
+pairwise_sum(const kernel_set_t* ks, double* a, size_t n)
+{
+  size_t h;
+
+  if (IS_INTERRUPTED()) return 0.0;
+  if (n <= BLOCK_SIZE) return ks->sum(a, n);
+
+  h = ((n / BLOCK_SIZE) / 2) * BLOCK_SIZE;
+  if (h == 0) h = BLOCK_SIZE;
+
+  return pairwise_sum(ks, a, h) + pairwise_sum(ks, a + h, n - h);
+}
+
+static double
+pairwise_sum_sq_dev(const kernel_set_t* ks, double* a, size_t n, double c)
+{
+  size_t h;
+
+  if (IS_INTERRUPTED()) return 0.0;
+  if (n <= BLOCK_SIZE) return ks->sum_sq_dev(a, n, c);
+
+  h = ((n / BLOCK_SIZE) / 2) * BLOCK_SIZE;
+  if (h == 0) h = BLOCK_SIZE;
+
+  return pairwise_sum_sq_dev(ks, a, h, c) +
+         pairwise_sum_sq_dev(ks, a + h, n - h, c);
+}
+
+static void
+pairwise_sum_dev_powers(const kernel_set_t* ks,
+                        double* a, size_t n, double c, double* dst)
+{
+  double t[CHEAP_SIMD_POWERS];
+  size_t h;
+  int k;
+
+  if (IS_INTERRUPTED()) {
+    memset(dst, 0, sizeof(double) * CHEAP_SIMD_POWERS);
+
+  } else if (n <= BLOCK_SIZE) {
+    ks->sum_dev_powers(a, n, c, dst);
+
+  } else {
+    h = ((n / BLOCK_SIZE) / 2) * BLOCK_SIZE;
+    if (h == 0) h = BLOCK_SIZE;
+
+    pairwise_sum_dev_powers(ks, a, h, c, dst);
+    pairwise_sum_dev_powers(ks, a + h, n - h, c, t);
+
+    for (k = 0; k < CHEAP_SIMD_POWERS; k++) dst[k] += t[k];
+  }
+}
+
+static void
+pairwise(const kernel_set_t* ks, int kind,
+         double* a, size_t n, double c, double* dst)
+{
+  switch (kind) {
+  case KIND_SUM:
+    dst[0] = pairwise_sum(ks, a, n);
+    break;
+
+  case KIND_SQ_DEV:
+    dst[0] = pairwise_sum_sq_dev(ks, a, n, c);
+    break;
+
+  case KIND_POWERS:
+    pairwise_sum_dev_powers(ks, a, n, c, dst);
+    break;
+  }
+}
+
+/*
+ * parallel reduction. the array is split by the same rule as the pairwise
+ * summation down to PARALLEL_GRAIN, the leaves are reduced by the workers,
+ * and the results are combined in the same order. so the result does not
+ * depend on the number of threads.
+ */
+static size_t
+count_leaves(size_t n)
+{
+  size_t h;
+
+  if (n <= PARALLEL_GRAIN) return 1;
+
+  h = ((n / BLOCK_SIZE) / 2) * BLOCK_SIZE;
+
+  return count_leaves(h) + count_leaves(n - h);
+}
+
+static void
+collect_leaves(reduce_t* r, double* a, size_t n)
+{
+  size_t h;
+
+  if (n <= PARALLEL_GRAIN) {
+    r->leaf[r->n_leaf] = a;
+    r->len[r->n_leaf]  = n;
+    r->n_leaf++;
+
+  } else {
+    h = ((n / BLOCK_SIZE) / 2) * BLOCK_SIZE;
+
+    collect_leaves(r, a, h);
+    collect_leaves(r, a + h, n - h);
+  }
+}
+
+static void
+combine_leaves(reduce_t* r, size_t n, size_t* idx, double* dst)
+{
+  double t[CHEAP_SIMD_POWERS];
+  size_t h;
+  int k;
+
+  if (n <= PARALLEL_GRAIN) {
+    memcpy(dst, r->res + (*idx * r->width), sizeof(double) * r->width);
+    (*idx)++;
+
+  } else {
+    h = ((n / BLOCK_SIZE) / 2) * BLOCK_SIZE;
+
+    combine_leaves(r, h, idx, dst);
+    combine_leaves(r, n - h, idx, t);
+
+    for (k = 0; k < r->width; k++) dst[k] += t[k];
+  }
+}
+
+static void
+reduce_task(void* _r, int index)
+{
+  reduce_t* r;
+  size_t i;
+
+  r = (reduce_t*)_r;
+
+  for (i = index; i < r->n_leaf; i += r->threads) {
+    pairwise(r->ks, r->kind, r->leaf[i], r->len[i], r->c,
+             r->res + (i * r->width));
+  }
+}
+
+static void
+reduce(int kind, double* a, size_t n, double c, double* dst, int threads)
+{
+  const kernel_set_t* ks;
+  reduce_t r;
+  size_t m;
+  size_t idx;
+
+  ks = get_kernels();
+
+  /*
+   * small input or single thread
+   */
+  if (threads <= 1 || n <= PARALLEL_GRAIN) {
+    pairwise(ks, kind, a, n, c, dst);
+    return;
+  }
+
+  /* the leaves are dealt by this number (same as cheap_parallel()) */
+  if (threads > CHEAP_MAX_THREADS) threads = CHEAP_MAX_THREADS;
+
+  /*
+   * alloc memory (on failure, fall back to the single thread, that gives
+   * the same result)
+   */
+  m = count_leaves(n);
+
+  memset(&r, 0, sizeof(r));
+
+  r.ks      = ks;
+  r.kind    = kind;
+  r.c       = c;
+  r.width   = (kind == KIND_POWERS)? CHEAP_SIMD_POWERS: 1;
+  r.threads = ((size_t)threads < m)? threads: (int)m;
+  r.leaf    = NALLOC(double*, m);
+  r.len     = NALLOC(size_t, m);
+  r.res     = NALLOC(double, m * r.width);
+
+  if (r.leaf == NULL || r.len == NULL || r.res == NULL) {
+    pairwise(ks, kind, a, n, c, dst);
+
+  } else {
+    collect_leaves(&r, a, n);
+    cheap_parallel(r.threads, reduce_task, &r);
+
+    idx = 0;
+    combine_leaves(&r, n, &idx, dst);
+  }
+
+  /*
+   * post process
+   */
+  if (r.leaf) free(r.leaf);
+  if (r.len) free(r.len);
+  if (r.res) free(r.res);
+}
+
+double
+cheap_simd_sum(double* a, size_t n)
+{
+  return cheap_simd_sum_mt(a, n, 1);
+}
+
+double
+cheap_simd_sum_sq_dev(double* a, size_t n, double c)
+{
+  return cheap_simd_sum_sq_dev_mt(a, n, c, 1);
+}
+
+void
+cheap_simd_sum_dev_powers(double* a, size_t n, double c, double* dst)
+{
+  cheap_simd_sum_dev_powers_mt(a, n, c, dst, 1);
+}
+
+double
+cheap_simd_sum_mt(double* a, size_t n, int threads)
+{
+  double ret;
+
+  reduce(KIND_SUM, a, n, 0.0, &ret, threads);
+
+  return ret;
+}
+
+double
+cheap_simd_sum_sq_dev_mt(double* a, size_t n, double c, int threads)
+{
+  double ret;
+
+  reduce(KIND_SQ_DEV, a, n, c, &ret, threads);
+
+  return ret;
+}
+
+void
+cheap_simd_sum_dev_powers_mt(double* a, size_t n, double c,
+                             double* dst, int threads)
+{
+  reduce(KIND_POWERS, a, n, c, dst, threads);
+}
+
+/*
+ * element-wise maps. each worker takes a contiguous range, and processes
+ * it by the blocks to poll the interrupt.
+ */
+static void
+map_task(void* _m, int index)
+{
+  map_t* m;
+  size_t lo;
+  size_t hi;
+  size_t l;
+
+  m  = (map_t*)_m;
+  lo = (m->n * index) / m->threads;
+  hi = (m->n * (index + 1)) / m->threads;
+
+  for (; lo < hi; lo += l) {
+    if (IS_INTERRUPTED()) break;
+
+    l = ((hi - lo) < BLOCK_SIZE)? (hi - lo): BLOCK_SIZE;
+
+    switch (m->kind) {
+    case MAP_Z_SCORES:
+      m->ks->z_scores(m->a + lo, l, m->c, m->s, m->dst + lo);
+      break;
+
+    case MAP_NORMAL_PDF:
+      m->ks->normal_pdf(m->a + lo, l, m->c, m->s, m->scale, m->dst + lo);
+      break;
+
+    case MAP_NORMAL_CDF:
+      m->ks->normal_cdf(m->a + lo, l, m->c, m->s, m->dst + lo);
+      break;
+    }
+  }
+}
+
+static void
+map(int kind, double* a, size_t n,
+    double c, double s, double scale, double* dst, int threads)
+{
+  map_t m;
+
+  m.ks      = get_kernels();
+  m.kind    = kind;
+  m.c       = c;
+  m.s       = s;
+  m.scale   = scale;
+  m.a       = a;
+  m.n       = n;
+  m.dst     = dst;
+  m.threads = (threads > 1 && n > PARALLEL_GRAIN)? threads: 1;
+
+  /* the range is split by this number (same as cheap_parallel()) */
+  if (m.threads > CHEAP_MAX_THREADS) m.threads = CHEAP_MAX_THREADS;
+
+  cheap_parallel(m.threads, map_task, &m);
+}
+
+void
+cheap_simd_z_scores(double* a, size_t n,
+                    double c, double s, double* dst, int threads)
+{
+  map(MAP_Z_SCORES, a, n, c, s, 0.0, dst, threads);
+}
+
+void
+cheap_simd_normal_pdf(double* a, size_t n, double c, double s,
+                      double scale, double* dst, int threads)
+{
+  map(MAP_NORMAL_PDF, a, n, c, s, scale, dst, threads);
+}
+
+void
+cheap_simd_normal_cdf(double* a, size_t n,
+                      double c, double s, double* dst, int threads)
+{
+  map(MAP_NORMAL_CDF, a, n, c, s, 0.0, dst, threads);
+}
@@ -0,0 +1,69 @@
+﻿/*
+ * Small statics library (SIMD reduction kernels)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_SIMD_H__
+#define __CHEAP_SIMD_H__
+
+#include <stdlib.h>
+
+#define CHEAP_SIMD_SCALAR     0
+#define CHEAP_SIMD_SSE2       1
+#define CHEAP_SIMD_AVX2       2
+#define CHEAP_SIMD_AVX512     3
+
+#define CHEAP_SIMD_POWERS     8
+
+/*
+ * the kernel set is selected by CPUID on first use. it can be limited by
+ * the environment variable CHEAP_STATS_SIMD (scalar, sse2, avx2, avx512)
+ * or by cheap_simd_select(), which returns the level actually selected.
+ */
+int cheap_simd_select(int level);
+int cheap_simd_level(void);
+const char* cheap_simd_name(int level);
+
+/*
+ * reductions (pairwise summation over the blocks)
+ *
+ *   cheap_simd_sum()             sum(a[i])
+ *   cheap_simd_sum_sq_dev()      sum((a[i] - c)^2)
+ *   cheap_simd_sum_dev_powers()  dst[k - 1] = sum((a[i] - c)^k), k = 1..8
+ *
+ * when the computation is interrupted, the results are meaningless (the
+ * caller should check IS_INTERRUPTED()).
+ */
+double cheap_simd_sum(double* a, size_t n);
+double cheap_simd_sum_sq_dev(double* a, size_t n, double c);
+void cheap_simd_sum_dev_powers(double* a, size_t n, double c, double* dst);
+
+/*
+ * multithreaded versions (the results are identical to the above for any
+ * number of threads)
+ */
+double cheap_simd_sum_mt(double* a, size_t n, int threads);
+double cheap_simd_sum_sq_dev_mt(double* a, size_t n, double c, int threads);
+void cheap_simd_sum_dev_powers_mt(double* a, size_t n, double c,
+                                  double* dst, int threads);
+
+/*
+ * element-wise maps (dst may be same as a, threads is the number of the
+ * threads, 0 or 1 means single thread)
+ *
+ *   cheap_simd_z_scores()        dst[i] = (a[i] - c) / s
+ *   cheap_simd_normal_pdf()      dst[i] = exp(-((a[i] - c) / s)^2 / 2) * scale
+ *   cheap_simd_normal_cdf()      dst[i] = Phi((a[i] - c) / s)
+ *
+ * the vector versions compute exp() and erfc() by the polynomials (within
+ * a few ulp of libm, and the results under 1e-308 are flushed to zero).
+ */
+void cheap_simd_z_scores(double* a, size_t n,
+                         double c, double s, double* dst, int threads);
+void cheap_simd_normal_pdf(double* a, size_t n, double c, double s,
+                           double scale, double* dst, int threads);
+void cheap_simd_normal_cdf(double* a, size_t n,
+                           double c, double s, double* dst, int threads);
+
+#endif /* !defined(__CHEAP_SIMD_H__) */
@@ -0,0 +1,191 @@
+﻿/*
+ * Small statics library (reduction kernel template)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * this file is included by cheap_simd.c once for each instruction set,
+ * with following macros defined (so there is no include guard).
+ *
+ *   KERNEL(name)   name of the function for the instruction set
+ *   TARGET         function attribute that enables the instruction set
+ *   VEC            vector type (or double for the scalar version)
+ *   LANES          number of doubles in VEC
+ */
+
+TARGET static inline double
+KERNEL(hsum)(VEC v)
+{
+  double t[LANES];
+  double ret;
+  int l;
+
+  memcpy(t, &v, sizeof(t));
+
+  for (l = 0, ret = 0.0; l < LANES; l++) ret += t[l];
+
+  return ret;
+}
+
+TARGET static double
+KERNEL(sum)(double* a, size_t n)
+{
+  VEC s0;
+  VEC s1;
+  VEC s2;
+  VEC s3;
+  VEC x0;
+  VEC x1;
+  VEC x2;
+  VEC x3;
+  double ret;
+  size_t i;
+
+  s0 = s1 = s2 = s3 = (VEC){0};
+
+  for (i = 0; (i + (LANES * 4)) <= n; i += (LANES * 4)) {
+    memcpy(&x0, a + i + (LANES * 0), sizeof(VEC));
+    memcpy(&x1, a + i + (LANES * 1), sizeof(VEC));
+    memcpy(&x2, a + i + (LANES * 2), sizeof(VEC));
+    memcpy(&x3, a + i + (LANES * 3), sizeof(VEC));
+
+    s0 += x0;
+    s1 += x1;
+    s2 += x2;
+    s3 += x3;
+  }
+
+  ret = KERNEL(hsum)((s0 + s1) + (s2 + s3));
+
+  for (; i < n; i++) ret += a[i];
+
+  return ret;
+}
+
+TARGET static double
+KERNEL(sum_sq_dev)(double* a, size_t n, double c)
+{
+  VEC s0;
+  VEC s1;
+  VEC s2;
+  VEC s3;
+  VEC x0;
+  VEC x1;
+  VEC x2;
+  VEC x3;
+  double ret;
+  double d;
+  size_t i;
+
+  s0 = s1 = s2 = s3 = (VEC){0};
+
+  for (i = 0; (i + (LANES * 4)) <= n; i += (LANES * 4)) {
+    memcpy(&x0, a + i + (LANES * 0), sizeof(VEC));
+    memcpy(&x1, a + i + (LANES * 1), sizeof(VEC));
+    memcpy(&x2, a + i + (LANES * 2), sizeof(VEC));
+    memcpy(&x3, a + i + (LANES * 3), sizeof(VEC));
+
+    x0 -= c;
+    x1 -= c;
+    x2 -= c;
+    x3 -= c;
+
+    s0 += x0 * x0;
+    s1 += x1 * x1;
+    s2 += x2 * x2;
+    s3 += x3 * x3;
+  }
+
+  ret = KERNEL(hsum)((s0 + s1) + (s2 + s3));
+
+  for (; i < n; i++) {
+    d    = a[i] - c;
+    ret += d * d;
+  }
+
+  return ret;
+}
+
+TARGET static void
+KERNEL(sum_dev_powers)(double* a, size_t n, double c, double* dst)
+{
+  VEC s[CHEAP_SIMD_POWERS];
+  VEC q[4];
+  VEC x;
+  VEC p;
+  double d;
+  double t;
+  size_t i;
+  size_t j;
+  int k;
+
+  /*
+   * the squares (k == 1) are summed in the same order as sum_sq_dev(), by
+   * four accumulators and the scalar tail. so the second order moment is
+   * the same value as the variance bit by bit.
+   */
+  for (k = 0; k < CHEAP_SIMD_POWERS; k++) s[k] = (VEC){0};
+  for (j = 0; j < 4; j++) q[j] = (VEC){0};
+
+  for (i = 0; (i + (LANES * 4)) <= n; i += (LANES * 4)) {
+    for (j = 0; j < 4; j++) {
+      memcpy(&x, a + i + (LANES * j), sizeof(VEC));
+
+      x    -= c;
+      p     = x;
+      q[j] += x * x;
+
+      for (k = 0; k < CHEAP_SIMD_POWERS; k++) {
+        if (k != 1) s[k] += p;
+        p *= x;
+      }
+    }
+  }
+
+  for (j = i; (j + LANES) <= n; j += LANES) {
+    memcpy(&x, a + j, sizeof(VEC));
+
+    x -= c;
+    p  = x;
+
+    for (k = 0; k < CHEAP_SIMD_POWERS; k++) {
+      if (k != 1) s[k] += p;
+      p *= x;
+    }
+  }
+
+  for (k = 0; k < CHEAP_SIMD_POWERS; k++) dst[k] = KERNEL(hsum)(s[k]);
+
+  dst[1] = KERNEL(hsum)((q[0] + q[1]) + (q[2] + q[3]));
+
+  for (; i < n; i++) {
+    d       = a[i] - c;
+    dst[1] += d * d;
+  }
+
+  for (; j < n; j++) {
+    d = a[j] - c;
+    t = d;
+
+    for (k = 0; k < CHEAP_SIMD_POWERS; k++) {
+      if (k != 1) dst[k] += t;
+      t *= d;
+    }
+  }
+}
+
+TARGET static void
+KERNEL(z_scores)(double* a, size_t n, double c, double s, double* dst)
+{
+  VEC x;
+  size_t i;
+
+  for (i = 0; (i + LANES) <= n; i += LANES) {
+    memcpy(&x, a + i, sizeof(VEC));
+    x = (x - c) / s;
+    memcpy(dst + i, &x, sizeof(VEC));
+  }
+
+  for (; i < n; i++) dst[i] = (a[i] - c) / s;
+}
@@ -0,0 +1,159 @@
+﻿/*
+ * Small statics library (element-wise math kernel template)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+/*
+ * this file is included by cheap_simd.c once for each vector instruction
+ * set after cheap_simd_kernel.h, with the same macros and following one
+ * defined (so there is no include guard).
+ *
+ *   IVEC           signed 64 bit integer vector of the same width as VEC
+ *
+ * the scalar versions are written with libm in cheap_simd.c.
+ */
+
+TARGET static inline VEC
+KERNEL(blend)(IVEC m, VEC a, VEC b)
+{
+  /* m ? a : b for each lane (m is the result of the comparison) */
+  return (VEC)((m & (IVEC)a) | (~m & (IVEC)b));
+}
+
+/*
+ * exp(x) for x <= 0. the argument is reduced as x = k * ln2 + r
+ * (|r| <= ln2 / 2), exp(r) is given by the Taylor polynomial of degree 13,
+ * and 2^k is put into the exponent field. the results below EXP_MIN are
+ * flushed to zero (no subnormals), and NaN is passed through.
+ */
+TARGET static inline VEC
+KERNEL(exp_neg)(VEC x)
+{
+  VEC k;
+  VEC r;
+  VEC p;
+  IVEC e;
+  IVEC tiny;
+  IVEC nan;
+
+  nan  = (x != x);
+  tiny = (x < EXP_MIN);
+  x    = KERNEL(blend)(tiny, (VEC){0} + EXP_MIN, x);
+
+  k = (x * LOG2E) + SHIFTER;
+  e = ((IVEC)k + 1023) << 52;
+  k = k - SHIFTER;
+  r = (x - (k * LN2_HI)) - (k * LN2_LO);
+
+  p = (VEC){0} + (1.0 / 6227020800.0);
+  p = (p * r) + (1.0 / 479001600.0);
+  p = (p * r) + (1.0 / 39916800.0);
+  p = (p * r) + (1.0 / 3628800.0);
+  p = (p * r) + (1.0 / 362880.0);
+  p = (p * r) + (1.0 / 40320.0);
+  p = (p * r) + (1.0 / 5040.0);
+  p = (p * r) + (1.0 / 720.0);
+  p = (p * r) + (1.0 / 120.0);
+  p = (p * r) + (1.0 / 24.0);
+  p = (p * r) + (1.0 / 6.0);
+  p = (p * r) + 0.5;
+  p = (p * r) + 1.0;
+  p = (p * r) + 1.0;
+
+  p = (VEC)((IVEC)(p * (VEC)e) & ~tiny);
+
+  return KERNEL(blend)(nan, x, p);
+}
+
+/*
+ * erfc(z) for z >= 0 (Chebyshev expansion of log(erfc(z) * exp(z^2) / t)
+ * on t = 2 / (2 + z), see erfc_coef[] in cheap_simd.c)
+ */
+TARGET static inline VEC
+KERNEL(erfc_pos)(VEC z)
+{
+  VEC t;
+  VEC ty;
+  VEC d;
+  VEC dd;
+  VEC tmp;
+  VEC y;
+  int j;
+
+  t  = 2.0 / (2.0 + z);
+  ty = (4.0 * t) - 2.0;
+  d  = (VEC){0};
+  dd = d;
+
+  for (j = ERFC_TERMS - 1; j > 0; j--) {
+    tmp = d;
+    d   = ((ty * d) - dd) + erfc_coef[j];
+    dd  = tmp;
+  }
+
+  y = (0.5 * (erfc_coef[0] + (ty * d))) - dd;
+
+  return t * KERNEL(exp_neg)(y - (z * z));
+}
+
+TARGET static inline VEC
+KERNEL(pdf_lanes)(VEC x, double c, double s, double scale)
+{
+  x = (x - c) / s;
+
+  return KERNEL(exp_neg)(-0.5 * (x * x)) * scale;
+}
+
+TARGET static inline VEC
+KERNEL(cdf_lanes)(VEC x, double c, double s)
+{
+  VEC e;
+
+  /* Phi(x) = erfc(-x / sqrt(2)) / 2 (by the symmetry on |x|) */
+  x = (x - c) / s;
+  e = 0.5 * KERNEL(erfc_pos)((VEC)((IVEC)x & ~SIGN_MASK) * M_SQRT1_2);
+
+  return KERNEL(blend)(x < 0.0, e, 1.0 - e);
+}
+
+TARGET static void
+KERNEL(normal_pdf)(double* a, size_t n, double c, double s, double scale,
+                   double* dst)
+{
+  VEC x;
+  size_t i;
+
+  for (i = 0; (i + LANES) <= n; i += LANES) {
+    memcpy(&x, a + i, sizeof(VEC));
+    x = KERNEL(pdf_lanes)(x, c, s, scale);
+    memcpy(dst + i, &x, sizeof(VEC));
+  }
+
+  if (i < n) {
+    x = (VEC){0};
+    memcpy(&x, a + i, sizeof(double) * (n - i));
+    x = KERNEL(pdf_lanes)(x, c, s, scale);
+    memcpy(dst + i, &x, sizeof(double) * (n - i));
+  }
+}
+
+TARGET static void
+KERNEL(normal_cdf)(double* a, size_t n, double c, double s, double* dst)
+{
+  VEC x;
+  size_t i;
+
+  for (i = 0; (i + LANES) <= n; i += LANES) {
+    memcpy(&x, a + i, sizeof(VEC));
+    x = KERNEL(cdf_lanes)(x, c, s);
+    memcpy(dst + i, &x, sizeof(VEC));
+  }
+
+  if (i < n) {
+    x = (VEC){0};
+    memcpy(&x, a + i, sizeof(double) * (n - i));
+    x = KERNEL(cdf_lanes)(x, c, s);
+    memcpy(dst + i, &x, sizeof(double) * (n - i));
+  }
+}
@@ -0,0 +1,903 @@
+﻿/*
+ * Small statics library (quantile sketch)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cheap_common.h"
+#include "cheap_sort.h"
+#include "cheap_sketch.h"
+
+#define MIN_K                 8
+#define MAX_K                 65535
+#define MIN_CAPACITY          8
+#define CAPACITY_RATIO        (2.0 / 3.0)
+
+#define DUMP_MAGIC            "CKLL"
+#define DUMP_VERSION          1
+#define DUMP_BYTE_ORDER       0x01020304U
+#define DUMP_HEADER_SIZE      48
+
+typedef struct {
+  double v;
+  uint64_t w;
+} weighted_t;
+
+static uint32_t
+next_bit(cheap_sketch_t* ptr)
+{
+  uint32_t x;
+
+  /*
+   * xorshift32 (deterministic, so the merged result is reproducible)
+   */
+  x          = ptr->seed;
+  x         ^= x << 13;
+  x         ^= x >> 17;
+  x         ^= x << 5;
+  ptr->seed  = x;
+
+  return x >> 31;
+}
+
+static size_t
+level_capacity(cheap_sketch_t* ptr, int h)
+{
+  double c;
+
+  /*
+   * the capacity decreases geometrically from the top level
+   */
+  c = ceil(ptr->k * pow(CAPACITY_RATIO, ptr->levels - 1 - h));
+
+  return (c > MIN_CAPACITY)? (size_t)c: MIN_CAPACITY;
+}
+
+static void
+update_limit(cheap_sketch_t* ptr)
+{
+  int h;
+
+  ptr->limit = 0;
+
+  for (h = 0; h < ptr->levels; h++) {
+    ptr->limit += level_capacity(ptr, h);
+  }
+}
+
+static int
+reserve(cheap_sketch_t* ptr, int h, size_t need)
+{
+  double* p;
+  size_t sz;
+
+  if (ptr->cap[h] < need) {
+    sz = (ptr->cap[h] > 0)? ptr->cap[h] * 2: MIN_CAPACITY * 2;
+    if (sz < need) sz = need;
+
+    p = (double*)realloc(ptr->item[h], sizeof(double) * sz);
+    if (p == NULL) return DEFAULT_ERROR;
+
+    ptr->item[h] = p;
+    ptr->cap[h]  = sz;
+  }
+
+  return 0;
+}
+
+static int
+compact(cheap_sketch_t* ptr)
+{
+  int ret;
+  int h;
+  size_t m;
+  size_t keep;
+  size_t i;
+  double* a;
+
+  /*
+   * find the lowest level that is over its capacity (add a level when it
+   * is the top level)
+   */
+  for (h = 0; h < ptr->levels - 1; h++) {
+    if (ptr->len[h] >= level_capacity(ptr, h)) break;
+  }
+
+  if (h == ptr->levels - 1) {
+    if (ptr->levels >= CHEAP_SKETCH_MAX_LEVELS) return DEFAULT_ERROR;
+
+    ptr->levels++;
+    update_limit(ptr);
+  }
+
+  /*
+   * sort the level, and promote every other item from the random offset
+   * (the smallest item is left when the number of the items is odd)
+   */
+  m    = ptr->len[h];
+  keep = m & 1;
+
+  ret  = reserve(ptr, h + 1, ptr->len[h + 1] + (m / 2));
+
+  if (!ret) {
+    a = ptr->item[h];
+    cheap_sort(a, m);
+
+    for (i = keep + next_bit(ptr); i < m; i += 2) {
+      ptr->item[h + 1][ptr->len[h + 1]++] = a[i];
+    }
+
+    ptr->len[h]  = keep;
+    ptr->size   -= (m - keep) / 2;
+  }
+
+  return ret;
+}
+
+static int
+fit(cheap_sketch_t* ptr)
+{
+  int ret;
+
+  ret = 0;
+
+  while (!ret && ptr->size > ptr->limit) {
+    ret = compact(ptr);
+  }
+
+  return ret;
+}
+
+static int
+push(cheap_sketch_t* ptr, double v)
+{
+  int ret;
+
+  /*
+   * NaN is not counted
+   */
+  if (isnan(v)) return 0;
+
+  ret = reserve(ptr, 0, ptr->len[0] + 1);
+
+  if (!ret) {
+    if (ptr->n == 0 || v < ptr->min) ptr->min = v;
+    if (ptr->n == 0 || v > ptr->max) ptr->max = v;
+
+    ptr->item[0][ptr->len[0]++] = v;
+    ptr->size++;
+    ptr->n++;
+    ptr->viewed = 0;
+
+    ret = fit(ptr);
+  }
+
+  return ret;
+}
+
+static int
+compare_weighted(const void* _a, const void* _b)
+{
+  double a;
+  double b;
+
+  a = ((const weighted_t*)_a)->v;
+  b = ((const weighted_t*)_b)->v;
+
+  return (a > b) - (a < b);
+}
+
+static int
+prepare_view(cheap_sketch_t* ptr)
+{
+  int ret;
+  weighted_t* tmp;
+  double* val;
+  uint64_t* cum;
+  uint64_t c;
+  size_t i;
+  size_t j;
+  int h;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  tmp = NULL;
+
+  if (ptr->viewed) return 0;
+
+  /*
+   * alloc memory
+   */
+  do {
+    tmp = NALLOC(weighted_t, ptr->size);
+    if (tmp == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    val = (double*)realloc(ptr->vval, sizeof(double) * ptr->size);
+    if (val == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ptr->vval = val;
+
+    cum = (uint64_t*)realloc(ptr->vcum, sizeof(uint64_t) * ptr->size);
+    if (cum == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ptr->vcum = cum;
+  } while (0);
+
+  /*
+   * sort the weighted items, and accumulate the weights
+   */
+  if (!ret) {
+    for (h = 0, j = 0; h < ptr->levels; h++) {
+      for (i = 0; i < ptr->len[h]; i++, j++) {
+        tmp[j].v = ptr->item[h][i];
+        tmp[j].w = (uint64_t)1 << h;
+      }
+    }
+
+    qsort(tmp, j, sizeof(*tmp), compare_weighted);
+
+    for (i = 0, c = 0; i < j; i++) {
+      c            += tmp[i].w;
+      ptr->vval[i]  = tmp[i].v;
+      ptr->vcum[i]  = c;
+    }
+
+    ptr->vn     = j;
+    ptr->viewed = !0;
+  }
+
+  /*
+   * post process
+   */
+  if (tmp) free(tmp);
+
+  return ret;
+}
+
+static double
+get_rank(cheap_sketch_t* ptr, uint64_t r)
+{
+  size_t l;
+  size_t h;
+  size_t m;
+
+  /*
+   * first item that its accumulated weight is over the rank
+   */
+  l = 0;
+  h = ptr->vn - 1;
+
+  while (l < h) {
+    m = (l + h) / 2;
+
+    if (ptr->vcum[m] > r) {
+      h = m;
+    } else {
+      l = m + 1;
+    }
+  }
+
+  return ptr->vval[l];
+}
+
+static void
+reset(cheap_sketch_t* ptr)
+{
+  int h;
+
+  for (h = 0; h < CHEAP_SKETCH_MAX_LEVELS; h++) {
+    ptr->len[h] = 0;
+  }
+
+  ptr->n      = 0;
+  ptr->min    = NAN;
+  ptr->max    = NAN;
+  ptr->seed   = 2463534242U;
+  ptr->levels = 1;
+  ptr->size   = 0;
+  ptr->viewed = 0;
+  ptr->vn     = 0;
+
+  update_limit(ptr);
+}
+
+int
+cheap_sketch_new(int k, cheap_sketch_t** dst)
+{
+  int ret;
+  cheap_sketch_t* ptr;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ptr = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (k < MIN_K || k > MAX_K) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    ptr = ALLOC(cheap_sketch_t);
+    if (ptr == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    memset(ptr, 0, sizeof(*ptr));
+
+    ptr->k = k;
+    reset(ptr);
+
+    *dst = ptr;
+  }
+
+  return ret;
+}
+
+int
+cheap_sketch_destroy(cheap_sketch_t* ptr)
+{
+  int ret;
+  int h;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    for (h = 0; h < CHEAP_SKETCH_MAX_LEVELS; h++) {
+      if (ptr->item[h]) free(ptr->item[h]);
+    }
+
+    if (ptr->vval) free(ptr->vval);
+    if (ptr->vcum) free(ptr->vcum);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_sketch_clear(cheap_sketch_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * reset sketch (the buffers are reused)
+   */
+  if (!ret) {
+    reset(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_sketch_push(cheap_sketch_t* ptr, double v)
+{
+  return cheap_sketch_push_many(ptr, &v, 1);
+}
+
+int
+cheap_sketch_push_many(cheap_sketch_t* ptr, double* a, size_t n)
+{
+  int ret;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (a == NULL && n > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * push samples
+   */
+  for (i = 0; !ret && i < n; i++) {
+    ret = push(ptr, a[i]);
+  }
+
+  return ret;
+}
+
+int
+cheap_sketch_merge(cheap_sketch_t* ptr, cheap_sketch_t* src)
+{
+  int ret;
+  int h;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (src == NULL || src == ptr) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->k != src->k) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * append the items of each level, then compact to the capacity
+   */
+  if (!ret && src->n > 0) {
+    if (ptr->levels < src->levels) {
+      ptr->levels = src->levels;
+      update_limit(ptr);
+    }
+
+    for (h = 0; !ret && h < src->levels; h++) {
+      ret = reserve(ptr, h, ptr->len[h] + src->len[h]);
+
+      if (!ret) {
+        memcpy(ptr->item[h] + ptr->len[h],
+               src->item[h], sizeof(double) * src->len[h]);
+
+        ptr->len[h] += src->len[h];
+        ptr->size   += src->len[h];
+      }
+    }
+
+    if (!ret) {
+      if (ptr->n == 0 || src->min < ptr->min) ptr->min = src->min;
+      if (ptr->n == 0 || src->max > ptr->max) ptr->max = src->max;
+
+      ptr->n      += src->n;
+      ptr->viewed  = 0;
+
+      ret = fit(ptr);
+    }
+  }
+
+  return ret;
+}
+
+static int
+check_query(cheap_sketch_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * build the sorted view
+   */
+  if (!ret) {
+    ret = prepare_view(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_sketch_min(cheap_sketch_t* ptr, double* dst)
+{
+  int ret;
+
+  ret = check_query(ptr, dst);
+  if (!ret) *dst = ptr->min;
+
+  return ret;
+}
+
+int
+cheap_sketch_max(cheap_sketch_t* ptr, double* dst)
+{
+  int ret;
+
+  ret = check_query(ptr, dst);
+  if (!ret) *dst = ptr->max;
+
+  return ret;
+}
+
+int
+cheap_sketch_q1(cheap_sketch_t* ptr, double* dst)
+{
+  int ret;
+
+  ret = check_query(ptr, dst);
+  if (!ret) *dst = get_rank(ptr, ptr->n / 4);
+
+  return ret;
+}
+
+int
+cheap_sketch_q3(cheap_sketch_t* ptr, double* dst)
+{
+  int ret;
+
+  ret = check_query(ptr, dst);
+  if (!ret) *dst = get_rank(ptr, (3 * ptr->n) / 4);
+
+  return ret;
+}
+
+int
+cheap_sketch_median(cheap_sketch_t* ptr, double* dst)
+{
+  int ret;
+
+  ret = check_query(ptr, dst);
+  if (!ret) *dst = get_rank(ptr, ptr->n / 2);
+
+  return ret;
+}
+
+int
+cheap_sketch_quantile(cheap_sketch_t* ptr, double p, double* dst)
+{
+  int ret;
+
+  /*
+   * the item at the approximated rank (no interpolation between items)
+   */
+  if (!(p >= 0.0 && p <= 1.0)) {
+    ret = DEFAULT_ERROR;
+  } else {
+    ret = check_query(ptr, dst);
+  }
+
+  if (!ret) {
+    if (p == 0.0) {
+      *dst = ptr->min;
+    } else if (p == 1.0) {
+      *dst = ptr->max;
+    } else {
+      *dst = get_rank(ptr, (uint64_t)((ptr->n - 1) * p));
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_sketch_cdf(cheap_sketch_t* ptr, double v, double* dst)
+{
+  int ret;
+  size_t i;
+
+  ret = check_query(ptr, dst);
+
+  /*
+   * weight of the items less than v
+   */
+  if (!ret) {
+    if (isnan(v)) {
+      *dst = NAN;
+
+    } else {
+      i    = cheap_lower_bound(ptr->vval, ptr->vn, v);
+      *dst = (i > 0)? (double)ptr->vcum[i - 1] / ptr->n: 0.0;
+    }
+  }
+
+  return ret;
+}
+
+static void
+put(unsigned char** p, const void* src, size_t n)
+{
+  memcpy(*p, src, n);
+  *p += n;
+}
+
+static void
+get(const unsigned char** p, void* dst, size_t n)
+{
+  memcpy(dst, *p, n);
+  *p += n;
+}
+
+int
+cheap_sketch_dump(cheap_sketch_t* ptr, void* buf, size_t size, size_t* len)
+{
+  int ret;
+  unsigned char* p;
+  uint32_t u32;
+  uint64_t u64;
+  size_t sz;
+  int h;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (len == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc size
+   *   header (48 bytes):
+   *     magic[4], byte order(u32), version(u32), k(u32), levels(u32),
+   *     seed(u32), n(u64), min(f64), max(f64)
+   *   length of each level (u64 * levels), then the items (f64)
+   */
+  if (!ret) {
+    sz = DUMP_HEADER_SIZE + (sizeof(uint64_t) * ptr->levels) +
+         (sizeof(double) * ptr->size);
+
+    *len = sz;
+  }
+
+  /*
+   * write data
+   */
+  if (!ret && buf != NULL && size >= sz) {
+    p = (unsigned char*)buf;
+
+    put(&p, DUMP_MAGIC, 4);
+    u32 = DUMP_BYTE_ORDER;   put(&p, &u32, sizeof(u32));
+    u32 = DUMP_VERSION;      put(&p, &u32, sizeof(u32));
+    u32 = ptr->k;            put(&p, &u32, sizeof(u32));
+    u32 = ptr->levels;       put(&p, &u32, sizeof(u32));
+    u32 = ptr->seed;         put(&p, &u32, sizeof(u32));
+    u64 = ptr->n;            put(&p, &u64, sizeof(u64));
+    put(&p, &ptr->min, sizeof(double));
+    put(&p, &ptr->max, sizeof(double));
+
+    for (h = 0; h < ptr->levels; h++) {
+      u64 = ptr->len[h];
+      put(&p, &u64, sizeof(u64));
+    }
+
+    for (h = 0; h < ptr->levels; h++) {
+      put(&p, ptr->item[h], sizeof(double) * ptr->len[h]);
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_sketch_load(const void* buf, size_t size, cheap_sketch_t** dst)
+{
+  int ret;
+  const unsigned char* p;
+  char magic[4];
+  uint32_t order;
+  uint32_t version;
+  uint32_t k;
+  uint32_t levels;
+  uint32_t seed;
+  uint64_t n;
+  uint64_t w;
+  uint64_t len[CHEAP_SKETCH_MAX_LEVELS];
+  size_t total;
+  cheap_sketch_t* ptr;
+  int h;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ptr = NULL;
+  p   = (const unsigned char*)buf;
+
+  /*
+   * argument check
+   */
+  do {
+    if (buf == NULL || size < DUMP_HEADER_SIZE) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * read header
+   */
+  if (!ret) do {
+    get(&p, magic, 4);
+    get(&p, &order, sizeof(order));
+    get(&p, &version, sizeof(version));
+    get(&p, &k, sizeof(k));
+    get(&p, &levels, sizeof(levels));
+    get(&p, &seed, sizeof(seed));
+    get(&p, &n, sizeof(n));
+
+    if (memcmp(magic, DUMP_MAGIC, 4) != 0 || order != DUMP_BYTE_ORDER) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (version != DUMP_VERSION) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (levels < 1 || levels > CHEAP_SKETCH_MAX_LEVELS) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (size < DUMP_HEADER_SIZE + (sizeof(uint64_t) * levels)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ret = cheap_sketch_new(k, &ptr);
+  } while (0);
+
+  /*
+   * read levels (the sum of the weights must be same as n)
+   */
+  if (!ret) do {
+    get(&p, &ptr->min, sizeof(double));
+    get(&p, &ptr->max, sizeof(double));
+
+    for (h = 0, total = 0, w = 0; h < (int)levels; h++) {
+      get(&p, &len[h], sizeof(uint64_t));
+
+      if (len[h] > (size - DUMP_HEADER_SIZE) / sizeof(double)) break;
+
+      total += len[h];
+      w     += len[h] << h;
+    }
+
+    if (h != (int)levels || w != n ||
+        size != DUMP_HEADER_SIZE + (sizeof(uint64_t) * levels) +
+                (sizeof(double) * total)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (h = 0; !ret && h < (int)levels; h++) {
+      ret = reserve(ptr, h, len[h]);
+
+      if (!ret) {
+        get(&p, ptr->item[h], sizeof(double) * len[h]);
+        ptr->len[h] = len[h];
+      }
+    }
+
+    if (ret) break;
+
+    ptr->n      = n;
+    ptr->seed   = seed;
+    ptr->levels = levels;
+    ptr->size   = total;
+    update_limit(ptr);
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (ret && ptr != NULL) {
+    cheap_sketch_destroy(ptr);
+  }
+
+  return ret;
+}
@@ -0,0 +1,76 @@
+﻿/*
+ * Small statics library (quantile sketch)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_SKETCH_H__
+#define __CHEAP_SKETCH_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CHEAP_SKETCH_DEFAULT_K      200
+#define CHEAP_SKETCH_MAX_LEVELS     64
+
+/*
+ * KLL sketch (Karnin, Lang and Liberty). the items of level h stand for
+ * 2^h samples each, and the level is compacted (sorted, and every other
+ * item is promoted) when the sketch exceeds its capacity. the memory is
+ * bounded by about 3k items, and the rank error is about 1.7 / k (with
+ * high probability, k = 200 gives 0.85%).
+ *
+ * the order statistics follow the definitions of cheap_stats_t on the
+ * approximated ranks, and cdf() is the fraction of the samples less than
+ * the value (same as cheap_stats_cdf()). NaN is not counted.
+ */
+typedef struct {
+  int k;
+  uint64_t n;
+  double min;
+  double max;
+  uint32_t seed;
+
+  int levels;
+  double* item[CHEAP_SKETCH_MAX_LEVELS];
+  size_t len[CHEAP_SKETCH_MAX_LEVELS];
+  size_t cap[CHEAP_SKETCH_MAX_LEVELS];   // allocated size of item[]
+  size_t size;                           // number of items on all levels
+  size_t limit;                          // capacity of all levels
+
+  /*
+   * sorted view of the weighted items (built on query)
+   */
+  int viewed;
+  size_t vn;
+  double* vval;
+  uint64_t* vcum;
+} cheap_sketch_t;
+
+int cheap_sketch_new(int k, cheap_sketch_t** obj);
+int cheap_sketch_destroy(cheap_sketch_t* obj);
+int cheap_sketch_clear(cheap_sketch_t* obj);
+int cheap_sketch_push(cheap_sketch_t* obj, double v);
+int cheap_sketch_push_many(cheap_sketch_t* obj, double* a, size_t n);
+int cheap_sketch_merge(cheap_sketch_t* obj, cheap_sketch_t* src);
+
+/*
+ * query functions fail when the sketch is empty
+ */
+int cheap_sketch_min(cheap_sketch_t* obj, double* dst);
+int cheap_sketch_max(cheap_sketch_t* obj, double* dst);
+int cheap_sketch_q1(cheap_sketch_t* obj, double* dst);
+int cheap_sketch_q3(cheap_sketch_t* obj, double* dst);
+int cheap_sketch_median(cheap_sketch_t* obj, double* dst);
+int cheap_sketch_quantile(cheap_sketch_t* obj, double p, double* dst);
+int cheap_sketch_cdf(cheap_sketch_t* obj, double v, double* dst);
+
+/*
+ * serialized form (native byte order, rejected on the other order).
+ * dump() puts the required size into *len, and writes into buf when the
+ * size is enough (buf can be NULL to get the size).
+ */
+int cheap_sketch_dump(cheap_sketch_t* obj, void* buf, size_t size, size_t* len);
+int cheap_sketch_load(const void* buf, size_t size, cheap_sketch_t** obj);
+
+#endif /* !defined(__CHEAP_SKETCH_H__) */
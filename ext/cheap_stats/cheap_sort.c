@@ -0,0 +1,639 @@
+﻿/*
+ * Small statics library (sort, selection and search routines)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "cheap_common.h"
+#include "cheap_profile.h"
+#include "cheap_sort.h"
+#include "cheap_thread.h"
+
+#define INSERTION_THRESHOLD   64
+#define COMBSORT_THRESHOLD    1024
+#define RADIX_BITS            11
+#define RADIX_SIZE            (1 << RADIX_BITS)
+#define RADIX_PASSES          ((64 + RADIX_BITS - 1) / RADIX_BITS)
+
+#define SELECT_THRESHOLD      32
+#define PARALLEL_THRESHOLD    (1 << 16)
+
+#define PHASE_KEYS            0
+#define PHASE_COUNT           1
+#define PHASE_SCATTER         2
+#define PHASE_RESTORE         3
+
+#define SIGN_BIT              UINT64_C(0x8000000000000000)
+#define SHRINK(n)             ((n * 10) / 13)
+#define SWAP(a,b)             do {double t; t = b; b = a; a = t;} while(0)
+
+typedef struct {
+  int threads;
+  int phase;
+  int pass;
+  size_t n;
+
+  double* a;
+  uint64_t* src;
+  uint64_t* dst;
+  size_t* hist;     // [threads][RADIX_PASSES][RADIX_SIZE]
+  size_t* offset;   // [threads][RADIX_SIZE]
+} radix_ctx_t;
+
+/*
+ * map IEEE-754 double to an unsigned key that keeps the order of values.
+ * (negative values are inverted, positive values get the sign bit, NaNs are
+ * mapped to the largest key)
+ */
+static inline uint64_t
+to_key(double v)
+{
+  uint64_t u;
+
+  if (isnan(v)) return UINT64_MAX;
+
+  memcpy(&u, &v, sizeof(u));
+
+  return (u & SIGN_BIT)? ~u: (u | SIGN_BIT);
+}
+
+static inline double
+from_key(uint64_t k)
+{
+  uint64_t u;
+  double ret;
+
+  u = (k & SIGN_BIT)? (k & ~SIGN_BIT): ~k;
+  memcpy(&ret, &u, sizeof(ret));
+
+  return ret;
+}
+
+/*
+ * move NaNs to the tail, and return number of the other values
+ */
+static size_t
+gather_nan(double* a, size_t n)
+{
+  size_t i;
+  size_t m;
+
+  for (i = 0, m = 0; i < n; i++) {
+    if (!isnan(a[i])) {
+      if (i != m) SWAP(a[i], a[m]);
+      m++;
+    }
+  }
+
+  return m;
+}
+
+void
+cheap_combsort11(double* a, size_t n)
+{
+  size_t h;
+  size_t i;
+  size_t f;
+
+  /*
+   * sort by ascending order
+   */
+
+  h = n;
+  f = 0;
+
+  while (h > 1 || f) {
+    if (IS_INTERRUPTED()) break;
+
+    f = 0;
+    h = SHRINK(h);
+
+    if (h == 9 || h == 10) h = 11;
+    if (h < 1) h = 1;
+
+    for (i = 0; i + h < n; i++) {
+      if (a[i] > a[i + h]) {
+        SWAP(a[i], a[i + h]);
+        f++;
+      }
+    }
+
+    PROF_ADD(compares, i);
+    PROF_ADD(swaps, f);
+  }
+}
+
+void
+cheap_insertion_sort(double* a, size_t n)
+{
+  size_t i;
+  size_t j;
+  size_t s;
+  size_t c;
+  double v;
+
+  s = 0;
+  c = 0;
+
+  for (i = 1; i < n; i++) {
+    v = a[i];
+
+    for (j = i; j > 0 && a[j - 1] > v; j--) {
+      a[j] = a[j - 1];
+    }
+
+    a[j] = v;
+
+    s += i - j;
+    c += (j > 0);
+  }
+
+  PROF_ADD(compares, s + c);
+  PROF_ADD(swaps, s);
+}
+
+int
+cheap_radix_sort(double* a, size_t n)
+{
+  int ret;
+  uint64_t* src;
+  uint64_t* dst;
+  uint64_t* tmp;
+  uint64_t* t;
+  size_t (*hist)[RADIX_SIZE];
+  size_t i;
+  size_t s;
+  size_t c;
+  uint64_t k;
+  int p;
+
+  /*
+   * initialize
+   */
+  ret  = 0;
+  tmp  = NULL;
+  hist = NULL;
+
+  /*
+   * alloc memory
+   */
+  do {
+    tmp = NALLOC(uint64_t, n);
+    if (tmp == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    hist = calloc(RADIX_PASSES, sizeof(*hist));
+    if (hist == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * LSD radix sort on the bit-flipped keys. the keys are written over the
+   * source buffer, and all digit histograms are built in a single pass.
+   */
+  if (!ret) {
+    src = (uint64_t*)a;
+    dst = tmp;
+
+    for (i = 0; i < n; i++) {
+      k      = to_key(a[i]);
+      src[i] = k;
+
+      for (p = 0; p < RADIX_PASSES; p++) {
+        hist[p][(k >> (p * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+      }
+    }
+
+    for (p = 0; p < RADIX_PASSES; p++) {
+      /* the keys are restored to the values (partially sorted) */
+      if (IS_INTERRUPTED()) {
+        ret = INTERRUPTED_ERROR;
+        break;
+      }
+
+      /* skip the digit that is same on all keys */
+      if (hist[p][(src[0] >> (p * RADIX_BITS)) & (RADIX_SIZE - 1)] == n) {
+        continue;
+      }
+
+      for (i = 0, s = 0; i < RADIX_SIZE; i++) {
+        c          = hist[p][i];
+        hist[p][i] = s;
+        s         += c;
+      }
+
+      for (i = 0; i < n; i++) {
+        k = src[i];
+        dst[hist[p][(k >> (p * RADIX_BITS)) & (RADIX_SIZE - 1)]++] = k;
+      }
+
+      PROF_ADD(swaps, n);
+
+      t   = src;
+      src = dst;
+      dst = t;
+    }
+
+    for (i = 0; i < n; i++) {
+      a[i] = from_key(src[i]);
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (tmp) free(tmp);
+  if (hist) free(hist);
+
+  return ret;
+}
+
+static void
+radix_task(void* _ctx, int index)
+{
+  radix_ctx_t* ctx;
+  size_t* h;
+  size_t* o;
+  size_t lo;
+  size_t hi;
+  size_t i;
+  uint64_t k;
+  int sh;
+  int p;
+
+  ctx = (radix_ctx_t*)_ctx;
+  lo  = (ctx->n * index) / ctx->threads;
+  hi  = (ctx->n * (index + 1)) / ctx->threads;
+  sh  = ctx->pass * RADIX_BITS;
+  h   = ctx->hist + ((size_t)index * RADIX_PASSES * RADIX_SIZE);
+  o   = ctx->offset + ((size_t)index * RADIX_SIZE);
+
+  switch (ctx->phase) {
+  case PHASE_KEYS:
+    for (i = lo; i < hi; i++) {
+      k           = to_key(ctx->a[i]);
+      ctx->src[i] = k;
+
+      for (p = 0; p < RADIX_PASSES; p++) {
+        h[(p * RADIX_SIZE) + ((k >> (p * RADIX_BITS)) & (RADIX_SIZE - 1))]++;
+      }
+    }
+    break;
+
+  case PHASE_COUNT:
+    memset(o, 0, sizeof(size_t) * RADIX_SIZE);
+
+    for (i = lo; i < hi; i++) {
+      o[(ctx->src[i] >> sh) & (RADIX_SIZE - 1)]++;
+    }
+    break;
+
+  case PHASE_SCATTER:
+    for (i = lo; i < hi; i++) {
+      k = ctx->src[i];
+      ctx->dst[o[(k >> sh) & (RADIX_SIZE - 1)]++] = k;
+    }
+    break;
+
+  case PHASE_RESTORE:
+    for (i = lo; i < hi; i++) {
+      ctx->a[i] = from_key(ctx->src[i]);
+    }
+    break;
+  }
+}
+
+int
+cheap_radix_sort_mt(double* a, size_t n, int threads)
+{
+  int ret;
+  radix_ctx_t ctx;
+  uint64_t* tmp;
+  uint64_t* t;
+  size_t total[RADIX_SIZE];
+  size_t s;
+  size_t c;
+  size_t i;
+  int j;
+  int p;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  tmp = NULL;
+
+  if (threads > CHEAP_MAX_THREADS) threads = CHEAP_MAX_THREADS;
+  if (threads <= 1) return cheap_radix_sort(a, n);
+
+  memset(&ctx, 0, sizeof(ctx));
+
+  /*
+   * alloc memory
+   */
+  do {
+    tmp = NALLOC(uint64_t, n);
+    if (tmp == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ctx.hist = calloc((size_t)threads * RADIX_PASSES * RADIX_SIZE,
+                      sizeof(size_t));
+    if (ctx.hist == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ctx.offset = NALLOC(size_t, (size_t)threads * RADIX_SIZE);
+    if (ctx.offset == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * same as cheap_radix_sort(), but each worker counts and scatters its
+   * own chunk. the offsets of the chunks are given in the order of the
+   * workers, so the sort is stable as the single thread version.
+   */
+  if (!ret) {
+    ctx.threads = threads;
+    ctx.n       = n;
+    ctx.a       = a;
+    ctx.src     = (uint64_t*)a;
+    ctx.dst     = tmp;
+    ctx.phase   = PHASE_KEYS;
+
+    cheap_parallel(threads, radix_task, &ctx);
+
+    for (p = 0; p < RADIX_PASSES; p++) {
+      /* the keys are restored to the values (partially sorted) */
+      if (IS_INTERRUPTED()) {
+        ret = INTERRUPTED_ERROR;
+        break;
+      }
+
+      /* skip the digit that is same on all keys */
+      memset(total, 0, sizeof(total));
+
+      for (j = 0; j < threads; j++) {
+        for (i = 0; i < RADIX_SIZE; i++) {
+          total[i] += ctx.hist[(((j * RADIX_PASSES) + p) * RADIX_SIZE) + i];
+        }
+      }
+
+      if (total[(ctx.src[0] >> (p * RADIX_BITS)) & (RADIX_SIZE - 1)] == n) {
+        continue;
+      }
+
+      ctx.pass  = p;
+      ctx.phase = PHASE_COUNT;
+      cheap_parallel(threads, radix_task, &ctx);
+
+      for (i = 0, s = 0; i < RADIX_SIZE; i++) {
+        for (j = 0; j < threads; j++) {
+          c                                = ctx.offset[(j * RADIX_SIZE) + i];
+          ctx.offset[(j * RADIX_SIZE) + i] = s;
+          s                               += c;
+        }
+      }
+
+      ctx.phase = PHASE_SCATTER;
+      cheap_parallel(threads, radix_task, &ctx);
+
+      PROF_ADD(swaps, n);
+
+      t       = ctx.src;
+      ctx.src = ctx.dst;
+      ctx.dst = t;
+    }
+
+    ctx.phase = PHASE_RESTORE;
+    cheap_parallel(threads, radix_task, &ctx);
+  }
+
+  /*
+   * post process
+   */
+  if (tmp) free(tmp);
+  if (ctx.hist) free(ctx.hist);
+  if (ctx.offset) free(ctx.offset);
+
+  return ret;
+}
+
+int
+cheap_sort(double* a, size_t n)
+{
+  int ret;
+
+  /*
+   * select algorithm by size
+   */
+  if (n <= INSERTION_THRESHOLD) {
+    cheap_insertion_sort(a, gather_nan(a, n));
+    ret = 0;
+
+  } else if (n <= COMBSORT_THRESHOLD) {
+    cheap_combsort11(a, gather_nan(a, n));
+    ret = IS_INTERRUPTED()? INTERRUPTED_ERROR: 0;
+
+  } else {
+    ret = cheap_radix_sort(a, n);
+  }
+
+  return ret;
+}
+
+static void
+select_range(double* a, size_t lo, size_t hi,
+             size_t* ranks, size_t k, int depth)
+{
+  size_t lt;
+  size_t gt;
+  size_t i;
+  size_t m;
+  size_t j;
+  double x;
+  double y;
+  double z;
+  double pv;
+
+  while (k > 0) {
+    if (IS_INTERRUPTED()) break;
+
+    /*
+     * small range or too deep recursion: fall back to the full sort
+     */
+    if ((hi - lo) < SELECT_THRESHOLD) {
+      cheap_insertion_sort(a + lo, hi - lo);
+      break;
+    }
+
+    if (depth <= 0) {
+      cheap_combsort11(a + lo, hi - lo);
+      break;
+    }
+
+    depth--;
+
+    /*
+     * median of three pivot
+     */
+    x  = a[lo];
+    y  = a[lo + ((hi - lo) / 2)];
+    z  = a[hi - 1];
+    pv = (x < y)? ((y < z)? y: ((x < z)? z: x)):
+                  ((x < z)? x: ((y < z)? z: y));
+
+    /*
+     * three-way partition: [lo, lt) < pv, [lt, gt) == pv, [gt, hi) > pv
+     */
+    lt = lo;
+    gt = hi;
+    i  = lo;
+
+    while (i < gt) {
+      if (a[i] < pv) {
+        SWAP(a[i], a[lt]);
+        lt++;
+        i++;
+
+      } else if (a[i] > pv) {
+        gt--;
+        SWAP(a[i], a[gt]);
+
+      } else {
+        i++;
+      }
+    }
+
+    /* one comparison for the values less than pv, two for the others */
+    PROF_ADD(compares, (2 * (hi - lo)) - (lt - lo));
+    PROF_ADD(swaps, (lt - lo) + (hi - gt));
+
+    /*
+     * split the requested ranks, recurse into the left part, and continue
+     * on the right part
+     */
+    for (m = 0; m < k && ranks[m] < lt; m++);
+    for (j = m; j < k && ranks[j] < gt; j++);
+
+    if (m > 0) select_range(a, lo, lt, ranks, m, depth);
+
+    lo     = gt;
+    ranks += j;
+    k     -= j;
+  }
+}
+
+int
+cheap_select(double* a, size_t n, size_t* ranks, size_t k)
+{
+  int ret;
+  size_t m;
+  size_t l;
+  size_t d;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (a == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ranks == NULL && k > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (l = 0; l < k; l++) {
+      if (ranks[l] >= n || (l > 0 && ranks[l] <= ranks[l - 1])) break;
+    }
+
+    if (l != k) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * multi selection (introselect). NaNs are moved to the tail first, so the
+   * ranks that point to there need no work.
+   */
+  if (!ret) {
+    m = gather_nan(a, n);
+
+    for (l = 0; l < k && ranks[l] < m; l++);
+    for (d = 0; ((size_t)1 << d) < m; d++);
+
+    select_range(a, 0, m, ranks, l, 2 * (int)d);
+
+    /* the array is still a permutation of the source */
+    if (IS_INTERRUPTED()) ret = INTERRUPTED_ERROR;
+  }
+
+  return ret;
+}
+
+size_t
+cheap_lower_bound(double* a, size_t n, double v)
+{
+  double* base;
+  size_t half;
+  size_t c;
+
+  /*
+   * branchless binary search (number of the values less than v)
+   */
+  if (n == 0) return 0;
+
+  base = a;
+  c    = 1;
+
+  while (n > 1) {
+    half  = n / 2;
+    base  = (base[half] < v)? base + half: base;
+    n    -= half;
+    c++;
+  }
+
+  PROF_ADD(compares, c);
+
+  return (base - a) + (*base < v);
+}
+
+int
+cheap_sort_mt(double* a, size_t n, int threads)
+{
+  int ret;
+
+  /*
+   * use the workers only for the large input
+   */
+  if (threads > 1 && n >= PARALLEL_THRESHOLD) {
+    ret = cheap_radix_sort_mt(a, n, threads);
+  } else {
+    ret = cheap_sort(a, n);
+  }
+
+  return ret;
+}
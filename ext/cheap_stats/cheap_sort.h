@@ -0,0 +1,43 @@
+﻿/*
+ * Small statics library (sort, selection and search routines)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_SORT_H__
+#define __CHEAP_SORT_H__
+
+#include <stdlib.h>
+
+/*
+ * all routines sort by ascending order. cheap_sort() places NaNs at the
+ * tail, and cheap_radix_sort() also places -0.0 before +0.0 (the other
+ * routines treat both zeros as equal).
+ *
+ * when the computation is interrupted (see cheap_common.h), the sort
+ * routines return INTERRUPTED_ERROR and the array is left as a permutation
+ * of the source (not sorted).
+ */
+int cheap_sort(double* a, size_t n);
+void cheap_combsort11(double* a, size_t n);
+void cheap_insertion_sort(double* a, size_t n);
+int cheap_radix_sort(double* a, size_t n);
+
+/*
+ * multithreaded versions (the result is same as the single thread)
+ */
+int cheap_sort_mt(double* a, size_t n, int threads);
+int cheap_radix_sort_mt(double* a, size_t n, int threads);
+
+/*
+ * partially reorder the array so that a[r] holds the value of the sorted
+ * order for every r in ranks (ranks must be in strictly ascending order).
+ */
+int cheap_select(double* a, size_t n, size_t* ranks, size_t k);
+
+/*
+ * number of the values less than v in the sorted array
+ */
+size_t cheap_lower_bound(double* a, size_t n, double v);
+
+#endif /* !defined(__CHEAP_SORT_H__) */
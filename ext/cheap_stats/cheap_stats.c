@@ -6,220 +6,2229 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <errno.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include "cheap_common.h"
 #include "cheap_stats.h"
+#include "cheap_sort.h"
+#include "cheap_kde.h"
+#include "cheap_dist.h"
+#include "cheap_simd.h"
+#include "cheap_thread.h"
 
-#define DEFAULT_ERROR         __LINE__
 #define MIN_SAMPLES           10
 
-#define ALLOC(t)              ((t*)malloc(sizeof(t)))
-#define NALLOC(t,n)           ((t*)malloc(sizeof(t) * (n)))
-#define FREE(var)             do {free(var);var = NULL;} while (0)
-#define SHRINK(n)             ((n * 10) / 13)
-#define SWAP(a,b)             do {double t; t = b; b = a; a = t;} while(0)
+#if CHEAP_SIMD_POWERS < CHEAP_STATS_MOMENT_ORDER
+#error "CHEAP_SIMD_POWERS must cover CHEAP_STATS_MOMENT_ORDER"
+#endif
+
+#if INTERRUPTED_ERROR != CHEAP_STATS_INTERRUPTED
+#error "INTERRUPTED_ERROR must be same as CHEAP_STATS_INTERRUPTED"
+#endif
+
+#define MERGE_RATIO           16
+#define MERGE_POLL_INTERVAL   65536
+
+#define SNAPSHOT_MAGIC        "CSTS"
+#define SNAPSHOT_VERSION      1
+#define SNAPSHOT_BYTE_ORDER   0x01020304U
+#define SNAPSHOT_HEADER_SIZE  192
+#define SNAPSHOT_SCALARS      (9 + CHEAP_STATS_MOMENT_ORDER + 1)
+#define CHECKSUM_SEED         0xcbf29ce484222325ULL
+#define CHECKSUM_PRIME        0x100000001b3ULL
+#define CHECKSUM_BLOCK        (1024 * 1024)
+#define MAX_KERNEL_ORDER      8
+
+#define TRIM_RECALC_RATIO     1e-4
+
+#define NORMAL_Z_SCORE        0
+#define NORMAL_PDF            1
+#define NORMAL_CDF            2
+#define MAX_INTEGER_ORDER     64
+
+#define CACHED_MINMAX         0x0001
+#define CACHED_SORTED         0x0002
+#define CACHED_VARIANCE       0x0004
+#define CACHED_MOMENTS        0x0008
+
+#define IS_CACHED(p,f)        (((p)->cached & (f)) != 0)
+
+/*
+ * running state of the outlier tests (a[lo, hi) remains)
+ */
+typedef struct {
+  double* a;
+  size_t lo;
+  size_t hi;
+  double mean;
+  double m2;      // sum of squared deviations
+  double m2_ref;  // m2 at the last recalc
+  int threads;
+} trim_t;
+
+static double
+calc_sum(double* a, size_t n, int threads)
+{
+  return cheap_simd_sum_mt(a, n, threads);
+}
+
+static double
+calc_variance(double* a, size_t n, double mean, int threads)
+{
+  return cheap_simd_sum_sq_dev_mt(a, n, mean, threads) / n;
+}
+
+static double
+calc_cdf(double* a, size_t n, double v)
+{
+  /*
+   * fraction of the samples less than v (the definition shared by all of
+   * the cdf functions)
+   */
+  return isnan(v)? NAN: (double)cheap_lower_bound(a, n, v) / n;
+}
+
+static int
+is_ascending(double* a, size_t n)
+{
+  size_t i;
+
+  for (i = 1; i < n; i++) {
+    if (!(a[i - 1] <= a[i])) return 0;
+  }
+
+  return !0;
+}
 
 static void
-combsort11(double* a, size_t n)
+calc_cdf_many(double* a, size_t n, double* xs, size_t m, double* dst)
 {
-  int h;
-  int f;
+  size_t i;
+  size_t j;
+
+  if (is_ascending(xs, m) && (m * MERGE_RATIO) >= n) {
+    /*
+     * merge walk over both of the sorted arrays
+     */
+    for (i = 0, j = 0; i < m; i++) {
+      while (j < n && a[j] < xs[i]) j++;
+      dst[i] = (double)j / n;
+    }
+
+    PROF_ADD(compares, m + j);
+
+  } else {
+    for (i = 0; i < m; i++) {
+      dst[i] = calc_cdf(a, n, xs[i]);
+    }
+  }
+}
+
+static inline double
+ipow(double x, int k)
+{
+  double ret;
+
+  /*
+   * exponentiation by squaring (fully unrolled when k is a constant)
+   */
+  ret = 1.0;
+
+  while (k > 0) {
+    if (k & 1) ret *= x;
+    x  *= x;
+    k >>= 1;
+  }
+
+  return ret;
+}
+
+static inline double
+sum_powers(double* a, size_t n, double c, int k)
+{
+  size_t i;
+  double s0;
+  double s1;
+  double s2;
+  double s3;
+
+  /*
+   * four partial sums to break the dependency chain of the additions
+   */
+  s0 = s1 = s2 = s3 = 0.0;
+
+  for (i = 0; (i + 4) <= n; i += 4) {
+    s0 += ipow(a[i + 0] - c, k);
+    s1 += ipow(a[i + 1] - c, k);
+    s2 += ipow(a[i + 2] - c, k);
+    s3 += ipow(a[i + 3] - c, k);
+  }
+
+  for (; i < n; i++) {
+    s0 += ipow(a[i] - c, k);
+  }
+
+  return (s0 + s1) + (s2 + s3);
+}
+
+/*
+ * specialized kernels for the integer orders (sum of (a[i] - c)^k)
+ */
+#define DEFINE_POWER_KERNEL(k) \
+  static double \
+  sum_powers_##k(double* a, size_t n, double c) \
+  { \
+    return sum_powers(a, n, c, k); \
+  }
+
+DEFINE_POWER_KERNEL(1)
+DEFINE_POWER_KERNEL(2)
+DEFINE_POWER_KERNEL(3)
+DEFINE_POWER_KERNEL(4)
+DEFINE_POWER_KERNEL(5)
+DEFINE_POWER_KERNEL(6)
+DEFINE_POWER_KERNEL(7)
+DEFINE_POWER_KERNEL(8)
+
+static double (*const power_kernels[])(double*, size_t, double) = {
+  NULL,
+  sum_powers_1,
+  sum_powers_2,
+  sum_powers_3,
+  sum_powers_4,
+  sum_powers_5,
+  sum_powers_6,
+  sum_powers_7,
+  sum_powers_8,
+};
+
+static double
+calc_power_sum(double* a, size_t n, double k, double c)
+{
+  double ret;
   int i;
 
+  if (k >= 1.0 && k <= MAX_KERNEL_ORDER && k == floor(k)) {
+    ret = power_kernels[(int)k](a, n, c);
+
+  } else if (k >= 0.0 && k <= MAX_INTEGER_ORDER && k == floor(k)) {
+    ret = sum_powers(a, n, c, (int)k);
+
+  } else {
+    /* fractional (or negative) order */
+    ret = 0.0;
+
+    for (i = 0; i < (int)n; i++) {
+      ret += pow(a[i] - c, k);
+    }
+  }
+
+  return ret;
+}
+
+static double
+calc_moment(double* a, size_t n, double k)
+{
+  return calc_power_sum(a, n, k, 0.0) / n;
+}
+
+static double
+calc_central_moment(double* a, size_t n, double k, double mean)
+{
+  return calc_power_sum(a, n, k, mean) / n;
+}
+
+static void
+calc_central_moments(double* a, size_t n, double mean, double* dst,
+                     int threads)
+{
+  double s[CHEAP_SIMD_POWERS];
+  int k;
+
+  /*
+   * power sums of the deviations from the mean for all of the orders
+   * (1..CHEAP_STATS_MOMENT_ORDER) in one pass
+   */
+  cheap_simd_sum_dev_powers_mt(a, n, mean, s, threads);
+
+  dst[0] = 1.0;
+
+  for (k = 1; k <= CHEAP_STATS_MOMENT_ORDER; k++) {
+    dst[k] = s[k - 1] / n;
+  }
+}
+
+static double
+calc_normal_pdf(double* a, size_t n,
+                double mean, double std, double total, double v)
+{
+  double t;
+
+  t = (v - mean) / std;
+
+  // 2.50662827463 == sqrt(2.0 * M_PI)
+  return (exp(-0.5 * (t * t)) / (std * 2.50662827463)) / total;
+}
+
+static void
+calc_minmax(double* a, size_t n, double* min, double* max)
+{
+  size_t i;
+  double l;
+  double h;
+
   /*
-   * sort by ascending order
+   * NaN is treated as the largest value (same as the sorted order)
    */
+  l = a[0];
+  h = a[0];
+
+  for (i = 1; i < n; i++) {
+    if (a[i] < l || isnan(l)) l = a[i];
+    if (a[i] > h || isnan(a[i])) h = a[i];
+  }
 
-  h = n;
+  *min = l;
+  *max = h;
+}
 
-  while (h > 1 || f) {
-    f = 0;
-    h = SHRINK(h);
+static size_t
+count_nan_tail(double* a, size_t n)
+{
+  size_t ret;
 
-    if (h == 9 || h == 10) h = 11;
+  for (ret = 0; ret < n && isnan(a[n - 1 - ret]); ret++);
 
-    for (i = 0; i < ((int)n - h); i++) {
-      if (a[i] > a[i + h]) {
-        SWAP(a[i], a[i + h]);
-        f = !0;
-      }
+  return ret;
+}
+
+static int
+merge_sorted(double* a, size_t na, double* b, size_t nb, double* dst)
+{
+  size_t ta;
+  size_t tb;
+  size_t i;
+  size_t j;
+  size_t k;
+  size_t e;
+  int f;
+
+  /*
+   * NaNs are at the tail of both, so merge the other values and append
+   * the NaNs after them
+   */
+  ta  = count_nan_tail(a, na);
+  tb  = count_nan_tail(b, nb);
+  na -= ta;
+  nb -= tb;
+
+  /*
+   * linear merge (branch free selection, polled for the interrupt per
+   * block)
+   */
+  i = 0;
+  j = 0;
+  k = 0;
+
+  while (i < na && j < nb) {
+    if (IS_INTERRUPTED()) return INTERRUPTED_ERROR;
+
+    e = k + MERGE_POLL_INTERVAL;
+
+    while (k < e && i < na && j < nb) {
+      f        = (b[j] < a[i]);
+      dst[k++] = f? b[j]: a[i];
+      j       += f;
+      i       += !f;
+    }
+  }
+
+  memcpy(dst + k, a + i, sizeof(double) * (na - i));
+  k += na - i;
+
+  memcpy(dst + k, b + j, sizeof(double) * (nb - j));
+  k += nb - j;
+
+  memcpy(dst + k, a + na, sizeof(double) * ta);
+  memcpy(dst + k + ta, b + nb, sizeof(double) * tb);
+
+  return 0;
+}
+
+static void
+merge_moments(cheap_stats_t* a, double* ca, cheap_stats_t* b, double* cb,
+              double mean, int order, double* dst)
+{
+  double na;
+  double nb;
+  double da[CHEAP_STATS_MOMENT_ORDER + 1];
+  double db[CHEAP_STATS_MOMENT_ORDER + 1];
+  double c[CHEAP_STATS_MOMENT_ORDER + 1];
+  double sa;
+  double sb;
+  int p;
+  int k;
+
+  /*
+   * pairwise combination of the central moments (Chan et al., extended to
+   * the higher orders by Pebay). each part is shifted to the merged mean
+   * by the binomial expansion.
+   */
+  na    = (double)a->n;
+  nb    = (double)b->n;
+  da[0] = 1.0;
+  db[0] = 1.0;
+
+  for (k = 1; k <= order; k++) {
+    da[k] = da[k - 1] * (a->mean - mean);
+    db[k] = db[k - 1] * (b->mean - mean);
+  }
+
+  dst[0] = 1.0;
+  c[0]   = 1.0;
+
+  for (p = 1; p <= order; p++) {
+    /* binomial coefficients of the order p */
+    c[p] = 1.0;
+    for (k = p - 1; k > 0; k--) c[k] += c[k - 1];
+
+    for (k = 0, sa = 0.0, sb = 0.0; k <= p; k++) {
+      sa += c[k] * da[k] * ca[p - k];
+      sb += c[k] * db[k] * cb[p - k];
+    }
+
+    dst[p] = ((na * sa) + (nb * sb)) / (na + nb);
+  }
+}
+
+static int
+prepare_minmax(cheap_stats_t* ptr)
+{
+  if (!IS_CACHED(ptr, CACHED_MINMAX)) {
+    if (IS_CACHED(ptr, CACHED_SORTED)) {
+      ptr->min = ptr->a1[0];
+      ptr->max = ptr->a1[ptr->n - 1];
+
+    } else {
+      calc_minmax(ptr->a0, ptr->n, &ptr->min, &ptr->max);
     }
+
+    ptr->cached |= CACHED_MINMAX;
   }
+
+  return 0;
 }
 
 static int
-binsearch(double* a, size_t n, double v)
+prepare_workspace(cheap_stats_t* ptr)
 {
-  int l;
-  int r;
   int ret;
 
-  l = 0;
-  r = n - 1;
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * allocate a1 as copy of a0 (it is sorted or partially ordered later).
+   * in the lean mode, the owned a0 is used as a1 in place, and the
+   * borrowed a0 is replaced by the copy.
+   */
+  if (ptr->a1 == NULL) {
+    if (!ptr->keep_order && !ptr->borrowed) {
+      ptr->a1 = ptr->a0;
+
+    } else {
+      PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_COPY);
 
-  while (1) {
-    ret = (l + r) / 2;
+      ptr->a1 = NALLOC(double, ptr->n);
 
-    if (r <= l) break;
+      if (ptr->a1 == NULL) {
+        ret = DEFAULT_ERROR;
+      } else {
+        memcpy(ptr->a1, ptr->a0, sizeof(double) * ptr->n);
+        PROF_ADD(allocs, 1);
+        PROF_ADD(bytes_copied, sizeof(double) * ptr->n);
+      }
 
-    if (a[ret] < v) {
-      l = ret + 1;
-      continue;
-    } 
-    
-    if (a[ret] > v) {
-      r = ret - 1;
-      continue;
+      PROF_END(&ptr->profile, CHEAP_PROFILE_COPY);
     }
 
-    break;
+    if (!ret && !ptr->keep_order && ptr->borrowed) {
+      if (ptr->map) {
+        munmap(ptr->map, ptr->map_size);
+        ptr->map = NULL;
+      }
+
+      ptr->a0       = ptr->a1;
+      ptr->borrowed = 0;
+    }
   }
 
   return ret;
 }
 
-static double
-calc_sum(double* a, size_t n)
+static int
+prepare_sorted(cheap_stats_t* ptr)
 {
-  int i;
-  double s;
+  int ret;
+  double* a1;
+  size_t n;
 
-  s = 0;
+  /*
+   * initialize
+   */
+  ret = 0;
+  n   = ptr->n;
+
+  if (!IS_CACHED(ptr, CACHED_SORTED)) {
+    /*
+     * sort
+     */
+    ret = prepare_workspace(ptr);
+
+    if (!ret) {
+      PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_SORT);
+      ret = cheap_sort_mt(ptr->a1, n, ptr->threads);
+      PROF_END(&ptr->profile, CHEAP_PROFILE_SORT);
+    }
 
-  for (i = 0; i < (int)n; i++) {
-    s += a[i];
+    /*
+     * put order statistics
+     */
+    if (!ret) {
+      a1           = ptr->a1;
+      ptr->min     = a1[0];
+      ptr->max     = a1[n - 1];
+      ptr->q1      = a1[n / 4];
+      ptr->q3      = a1[(3 * n) / 4];
+      ptr->median  = a1[n / 2];
+      ptr->cached |= (CACHED_SORTED | CACHED_MINMAX);
+    }
   }
 
-  return s;
+  return ret;
 }
 
-static double
-calc_variance(double* a, size_t n, double mean)
+/*
+ * in the lean mode, the selection leaves a0 (== a1) partially ordered by
+ * the history of the queries. such a0 is sorted before the reductions, so
+ * they run over either the original or the sorted order.
+ */
+static int
+prepare_order(cheap_stats_t* ptr)
 {
-  int i;
+  int ret;
 
-  double d;
-  double s;
+  ret = 0;
+
+  if (ptr->a1 == ptr->a0 && !IS_CACHED(ptr, CACHED_SORTED)) {
+    ret = prepare_sorted(ptr);
+  }
+
+  return ret;
+}
+
+static int
+prepare_variance(cheap_stats_t* ptr)
+{
+  int ret;
+  double v;
+
+  ret = 0;
 
-  s = 0;
+  if (!IS_CACHED(ptr, CACHED_VARIANCE)) {
+    ret = prepare_order(ptr);
+  }
+
+  if (!ret && !IS_CACHED(ptr, CACHED_VARIANCE)) {
+    PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_VARIANCE);
+    v = calc_variance(ptr->a0, ptr->n, ptr->mean, ptr->threads);
+    PROF_END(&ptr->profile, CHEAP_PROFILE_VARIANCE);
 
-  for (i = 0; i < (int)n; i++) {
-    d  = a[i] - mean; 
-    s += (d * d);
+    if (IS_INTERRUPTED()) return INTERRUPTED_ERROR;
+
+    ptr->variance = v;
+    ptr->std      = sqrt(ptr->variance);
+    ptr->cached  |= CACHED_VARIANCE;
   }
 
-  return s / n;
+  return ret;
 }
 
-static double
-calc_cdf(double* a, size_t n, double v)
+static int
+prepare_moments(cheap_stats_t* ptr)
 {
-  int idx;
+  int ret;
 
-  if (v > a[n - 1]) {
-    idx = n;
-  } else {
-    idx = binsearch(a, n, v);
+  ret = 0;
+
+  if (!IS_CACHED(ptr, CACHED_MOMENTS)) {
+    ret = prepare_order(ptr);
   }
 
-  return (double)idx / n;
+  if (!ret && !IS_CACHED(ptr, CACHED_MOMENTS)) {
+    PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_MOMENTS);
+    calc_central_moments(ptr->a0, ptr->n, ptr->mean, ptr->cm, ptr->threads);
+    PROF_END(&ptr->profile, CHEAP_PROFILE_MOMENTS);
+
+    if (IS_INTERRUPTED()) return INTERRUPTED_ERROR;
+
+    ptr->cached |= CACHED_MOMENTS;
+
+    /* cm[2] is summed in the same order as calc_variance() */
+    if (!IS_CACHED(ptr, CACHED_VARIANCE)) {
+      ptr->variance = ptr->cm[2];
+      ptr->std      = sqrt(ptr->variance);
+      ptr->cached  |= CACHED_VARIANCE;
+    }
+  }
+
+  return ret;
 }
 
-static double
-calc_moment(double* a, size_t n, double k)
+static int
+get_central_moment(cheap_stats_t* ptr, double k, double* dst)
 {
-  double s;
-  int i;
+  int ret;
+
+  /*
+   * the integer orders are read from the cache
+   */
+  if (k >= 0.0 && k <= CHEAP_STATS_MOMENT_ORDER && k == floor(k)) {
+    ret = prepare_moments(ptr);
+    if (!ret) *dst = ptr->cm[(int)k];
 
-  for (i = 0; i < (int)n; i++) {
-    s += pow(a[i], k);
+  } else {
+    ret  = 0;
+    *dst = calc_central_moment(ptr->a0, ptr->n, k, ptr->mean);
   }
 
-  return s / n;
+  return ret;
 }
 
-static double
-calc_central_moment(double* a, size_t n, double k, double mean)
+static int
+get_std_moment(cheap_stats_t* ptr, double k, double* dst)
 {
-  double s;
-  int i;
+  int ret;
+  double m;
 
-  for (i = 0; i < (int)n; i++) {
-    s += pow(a[i] - mean, k);
+  ret = get_central_moment(ptr, k, &m);
+
+  if (!ret) {
+    ret = prepare_variance(ptr);
+  }
+
+  if (!ret) {
+    *dst = m / pow(ptr->std, k);
   }
 
-  return s / n;
+  return ret;
 }
 
-static double
-calc_std_moment(double* a, size_t n, double k, double mean, double std)
+static int
+compare_rank(const void* _a, const void* _b)
 {
-  return calc_central_moment(a, n, k, mean) / pow(std, k);
+  size_t a;
+  size_t b;
+
+  a = *(const size_t*)_a;
+  b = *(const size_t*)_b;
+
+  return (a > b) - (a < b);
 }
 
-static double
-calc_normal_pdf(double* a, size_t n,
-                double mean, double std, double total, double v)
+static int
+get_threads(cheap_stats_opts_t* opts)
 {
-  double t;
+  /*
+   * the work is split by this number, so it must not exceed the number of
+   * the workers that cheap_parallel() runs
+   */
+  if (opts == NULL || opts->threads <= 1) return 1;
+
+  return (opts->threads < CHEAP_MAX_THREADS)? opts->threads: CHEAP_MAX_THREADS;
+}
+
+static double
+calc_quantile(double* a, size_t n, double p)
+{
+  double h;
+  double f;
+  size_t l;
+
+  /*
+   * linear interpolation between the closest ranks
+   * (same as the type 7 definition of Hyndman and Fan)
+   */
+  h = (n - 1) * p;
+  l = (size_t)h;
+  f = h - l;
+
+  return (f > 0.0 && (l + 1) < n)? a[l] + (f * (a[l + 1] - a[l])): a[l];
+}
+
+int
+cheap_stats_new(double* src, size_t n, cheap_stats_t** dst)
+{
+  return cheap_stats_new_ex(src, n, NULL, dst);
+}
+
+int
+cheap_stats_new_ex(double* src, size_t n,
+                   cheap_stats_opts_t* opts, cheap_stats_t** dst)
+{
+  int ret;
+  double* a0;
+  cheap_stats_t* ptr;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ptr = NULL;
+  a0  = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (src == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (n < MIN_SAMPLES) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (opts != NULL && opts->threads < 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * alloc memory
+   */
+  if (!ret) do {
+    ptr = ALLOC(cheap_stats_t);
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (opts != NULL && (opts->borrow || opts->adopt)) break;
+
+    a0 = NALLOC(double, n);
+    if (a0 == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   * (the sorted array and the derived values are computed on demand)
+   */
+  if (!ret) {
+    memset(ptr, 0, sizeof(*ptr));
+
+    if (a0 != NULL) {
+      PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_COPY);
+      memcpy(a0, src, sizeof(double) * n);
+      PROF_ADD(allocs, 1);
+      PROF_ADD(bytes_copied, sizeof(double) * n);
+      PROF_END(&ptr->profile, CHEAP_PROFILE_COPY);
+
+      ptr->a0       = a0;
+      ptr->borrowed = 0;
+    } else {
+      ptr->a0       = src;
+      ptr->borrowed = !opts->adopt;
+    }
+
+    ptr->a1         = NULL;
+    ptr->n          = n;
+    ptr->cached     = 0;
+    ptr->threads    = get_threads(opts);
+    ptr->keep_order = (opts != NULL && opts->keep_order);
+
+    PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_SUM);
+    ptr->total      = calc_sum(ptr->a0, n, ptr->threads);
+    ptr->mean       = ptr->total / n;
+    PROF_END(&ptr->profile, CHEAP_PROFILE_SUM);
+
+    if (IS_INTERRUPTED()) {
+      ret = INTERRUPTED_ERROR;
+    } else {
+      *dst = ptr;
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (ptr) free(ptr);
+    if (a0) free(a0);
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_new_mmap(const char* path, int dtype,
+                     cheap_stats_opts_t* opts, cheap_stats_t** dst)
+{
+  int ret;
+  int fd;
+  struct stat st;
+  size_t sz;
+  void* map;
+  double* a0;
+  float* f;
+  size_t n;
+  size_t i;
+  cheap_stats_opts_t o;
+  cheap_stats_t* ptr;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  fd  = -1;
+  map = MAP_FAILED;
+  a0  = NULL;
+  ptr = NULL;
+  n   = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (path == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dtype == CHEAP_STATS_FLOAT64) {
+      sz = sizeof(double);
+    } else if (dtype == CHEAP_STATS_FLOAT32) {
+      sz = sizeof(float);
+    } else {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * map file
+   */
+  if (!ret) do {
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size % sz != 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    n = st.st_size / sz;
+    if (n < MIN_SAMPLES) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    /* the construction and the copy to a1 read it sequentially */
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+  } while (0);
+
+  /*
+   * convert to double
+   */
+  if (!ret && dtype == CHEAP_STATS_FLOAT32) {
+    a0 = NALLOC(double, n);
+
+    if (a0 == NULL) {
+      ret = DEFAULT_ERROR;
+    } else {
+      f = (float*)map;
+
+      for (i = 0; i < n; i++) {
+        a0[i] = f[i];
+      }
+    }
+  }
+
+  /*
+   * create object on the mapped (or converted) array
+   */
+  if (!ret) {
+    memset(&o, 0, sizeof(o));
+    if (opts != NULL) o = *opts;
+
+    if (a0 != NULL) {
+      o.adopt  = !0;
+      o.borrow = 0;
+      ret      = cheap_stats_new_ex(a0, n, &o, &ptr);
+      if (!ret) a0 = NULL;
+
+    } else {
+      o.adopt  = 0;
+      o.borrow = !0;
+      ret      = cheap_stats_new_ex((double*)map, n, &o, &ptr);
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    if (ptr->borrowed) {
+      ptr->map      = map;
+      ptr->map_size = st.st_size;
+      map           = MAP_FAILED;
+    }
+
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (map != MAP_FAILED) munmap(map, st.st_size);
+  if (fd >= 0) close(fd);
+  if (a0) free(a0);
+
+  return ret;
+}
+
+int
+cheap_stats_merge(cheap_stats_t* a, cheap_stats_t* b, cheap_stats_t** dst)
+{
+  int ret;
+  double* a0;
+  cheap_stats_t* ptr;
+  size_t n;
+  double va[3];
+  double vb[3];
+  double vm[3];
+
+  /*
+   * initialize
+   */
+  ret   = 0;
+  a0    = NULL;
+  ptr   = NULL;
+
+  va[0] = 1.0;
+  va[1] = 0.0;
+  vb[0] = 1.0;
+  vb[1] = 0.0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (a == NULL || b == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * moments and sort of both parts (no-op for the already cached ones)
+   */
+  if (!ret) {
+    ret = prepare_moments(a);
+  }
+
+  if (!ret) {
+    ret = prepare_moments(b);
+  }
+
+  if (!ret) {
+    ret = prepare_sorted(a);
+  }
+
+  if (!ret) {
+    ret = prepare_sorted(b);
+  }
+
+  /*
+   * alloc memory
+   */
+  if (!ret) do {
+    n = a->n + b->n;
+
+    ptr = ALLOC(cheap_stats_t);
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    a0 = NALLOC(double, n);
+    if (a0 == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * merge sorted arrays (the merged object is in the lean mode, a1 == a0)
+   */
+  if (!ret) {
+    ret = merge_sorted(a->a1, a->n, b->a1, b->n, a0);
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    memset(ptr, 0, sizeof(*ptr));
+
+    ptr->a0         = a0;
+    ptr->a1         = a0;
+    ptr->n          = n;
+    ptr->threads    = (a->threads > b->threads)? a->threads: b->threads;
+    ptr->borrowed   = 0;
+    ptr->keep_order = 0;
+    ptr->total      = a->total + b->total;
+    ptr->mean       = a->mean + ((b->mean - a->mean) * ((double)b->n / n));
+
+    ptr->min        = a0[0];
+    ptr->max        = a0[n - 1];
+    ptr->q1         = a0[n / 4];
+    ptr->q3         = a0[(3 * n) / 4];
+    ptr->median     = a0[n / 2];
+    ptr->cached     = (CACHED_SORTED | CACHED_MINMAX |
+                       CACHED_VARIANCE | CACHED_MOMENTS);
+
+    merge_moments(a, a->cm, b, b->cm,
+                  ptr->mean, CHEAP_STATS_MOMENT_ORDER, ptr->cm);
+
+    va[2]           = a->variance;
+    vb[2]           = b->variance;
+    merge_moments(a, va, b, vb, ptr->mean, 2, vm);
+
+    ptr->variance   = vm[2];
+    ptr->std        = sqrt(ptr->variance);
+
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (ptr) free(ptr);
+    if (a0) free(a0);
+  }
+
+  return ret;
+}
+
+static int
+calc_checksum(const void* buf, size_t size, uint64_t* dst)
+{
+  const unsigned char* p;
+  uint64_t h;
+  uint64_t w;
+  size_t i;
+
+  /*
+   * FNV-1a like hash on 64bit words (polled for the interrupt per block)
+   */
+  p = (const unsigned char*)buf;
+  h = CHECKSUM_SEED;
+
+  for (i = 0; i + sizeof(w) <= size; i += sizeof(w)) {
+    if ((i % CHECKSUM_BLOCK) == 0 && IS_INTERRUPTED()) {
+      return INTERRUPTED_ERROR;
+    }
+
+    memcpy(&w, p + i, sizeof(w));
+    h  = (h ^ w) * CHECKSUM_PRIME;
+    h ^= h >> 32;
+  }
+
+  for (; i < size; i++) {
+    h = (h ^ p[i]) * CHECKSUM_PRIME;
+  }
+
+  *dst = h;
+
+  return 0;
+}
+
+static int
+prepare_snapshot(cheap_stats_t* ptr)
+{
+  int ret;
+
+  /*
+   * everything that is restored without a pass over the samples
+   */
+  ret = prepare_sorted(ptr);
+  if (!ret) ret = prepare_moments(ptr);
+  if (!ret) ret = prepare_variance(ptr);
+
+  return ret;
+}
+
+static int
+write_header(cheap_stats_t* ptr, unsigned char* buf)
+{
+  int ret;
+  unsigned char* p;
+  uint32_t u32;
+  uint64_t u64;
+  double v[SNAPSHOT_SCALARS];
+  int i;
+
+  /*
+   * header (192 bytes):
+   *   magic[4], byte order(u32), version(u32), cached flags(u32), n(u64),
+   *   total, mean, min, max, q1, q3, median, variance, std, cm[0..8] (f64),
+   *   reserved(u64), checksum of the payload(u64), checksum of the header
+   *   before it(u64)
+   * then the sorted samples (f64 * n, 8 bytes aligned).
+   */
+  v[0] = ptr->total;
+  v[1] = ptr->mean;
+  v[2] = ptr->min;
+  v[3] = ptr->max;
+  v[4] = ptr->q1;
+  v[5] = ptr->q3;
+  v[6] = ptr->median;
+  v[7] = ptr->variance;
+  v[8] = ptr->std;
+
+  for (i = 0; i <= CHEAP_STATS_MOMENT_ORDER; i++) {
+    v[9 + i] = ptr->cm[i];
+  }
+
+  memset(buf, 0, SNAPSHOT_HEADER_SIZE);
+  p = buf;
+
+  memcpy(p, SNAPSHOT_MAGIC, 4);                  p += 4;
+  u32 = SNAPSHOT_BYTE_ORDER;  memcpy(p, &u32, 4); p += 4;
+  u32 = SNAPSHOT_VERSION;     memcpy(p, &u32, 4); p += 4;
+  u32 = ptr->cached;          memcpy(p, &u32, 4); p += 4;
+  u64 = ptr->n;               memcpy(p, &u64, 8); p += 8;
+  memcpy(p, v, sizeof(v));                       p += sizeof(v);
+  p += sizeof(uint64_t);                         // reserved
+
+  ret = calc_checksum(ptr->a1, sizeof(double) * ptr->n, &u64);
+
+  if (!ret) {
+    memcpy(p, &u64, 8);
+    p += 8;
+
+    ret = calc_checksum(buf, p - buf, &u64);
+  }
+
+  if (!ret) {
+    memcpy(p, &u64, 8);
+  }
+
+  return ret;
+}
+
+static int
+read_header(const unsigned char* buf, size_t size,
+            cheap_stats_t* dst, uint64_t* sum)
+{
+  int ret;
+  const unsigned char* p;
+  uint32_t order;
+  uint32_t version;
+  uint32_t cached;
+  uint64_t n;
+  uint64_t h;
+  double v[SNAPSHOT_SCALARS];
+  int i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  p   = buf;
+
+  /*
+   * check header
+   */
+  do {
+    if (size < SNAPSHOT_HEADER_SIZE) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    memcpy(&order, p + 4, 4);
+    memcpy(&version, p + 8, 4);
+
+    if (memcmp(p, SNAPSHOT_MAGIC, 4) != 0 || order != SNAPSHOT_BYTE_ORDER) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (version != SNAPSHOT_VERSION) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ret = calc_checksum(buf, SNAPSHOT_HEADER_SIZE - 8, &h);
+    if (ret) break;
+
+    if (memcmp(buf + SNAPSHOT_HEADER_SIZE - 8, &h, 8) != 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    memcpy(&cached, p + 12, 4);
+    memcpy(&n, p + 16, 8);
+    memcpy(v, p + 24, sizeof(v));
+    memcpy(sum, buf + SNAPSHOT_HEADER_SIZE - 16, 8);
+
+    if (n < MIN_SAMPLES || !(cached & CACHED_SORTED) ||
+        n > (size - SNAPSHOT_HEADER_SIZE) / sizeof(double) ||
+        size != SNAPSHOT_HEADER_SIZE + (sizeof(double) * n)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put scalar fields
+   */
+  if (!ret) {
+    dst->n        = n;
+    dst->cached   = cached & (CACHED_MINMAX | CACHED_SORTED |
+                              CACHED_VARIANCE | CACHED_MOMENTS);
+    dst->total    = v[0];
+    dst->mean     = v[1];
+    dst->min      = v[2];
+    dst->max      = v[3];
+    dst->q1       = v[4];
+    dst->q3       = v[5];
+    dst->median   = v[6];
+    dst->variance = v[7];
+    dst->std      = v[8];
+
+    for (i = 0; i <= CHEAP_STATS_MOMENT_ORDER; i++) {
+      dst->cm[i] = v[9 + i];
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_dump(cheap_stats_t* ptr, void* buf, size_t size, size_t* len)
+{
+  int ret;
+  size_t sz;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (len == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc size
+   */
+  if (!ret) {
+    sz   = SNAPSHOT_HEADER_SIZE + (sizeof(double) * ptr->n);
+    *len = sz;
+  }
+
+  /*
+   * write data (the samples are sorted first if not yet)
+   */
+  if (!ret && buf != NULL && size >= sz) {
+    ret = prepare_snapshot(ptr);
+
+    if (!ret) {
+      ret = write_header(ptr, (unsigned char*)buf);
+    }
+
+    if (!ret) {
+      memcpy((unsigned char*)buf + SNAPSHOT_HEADER_SIZE,
+             ptr->a1, sizeof(double) * ptr->n);
+    }
+  }
+
+  return ret;
+}
+
+static int
+write_all(int fd, const void* buf, size_t size)
+{
+  const unsigned char* p;
+  ssize_t l;
+
+  p = (const unsigned char*)buf;
+
+  while (size > 0) {
+    l = write(fd, p, size);
+
+    if (l < 0) {
+      if (errno == EINTR) continue;
+      return DEFAULT_ERROR;
+    }
+
+    p    += l;
+    size -= l;
+  }
+
+  return 0;
+}
+
+int
+cheap_stats_save(cheap_stats_t* ptr, const char* path)
+{
+  int ret;
+  int fd;
+  unsigned char hdr[SNAPSHOT_HEADER_SIZE];
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  fd  = -1;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (path == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * build header
+   */
+  if (!ret) {
+    ret = prepare_snapshot(ptr);
+  }
+
+  if (!ret) {
+    ret = write_header(ptr, hdr);
+  }
+
+  /*
+   * write file
+   */
+  if (!ret) do {
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    ret = write_all(fd, hdr, sizeof(hdr));
+    if (ret) break;
+
+    ret = write_all(fd, ptr->a1, sizeof(double) * ptr->n);
+  } while (0);
+
+  /*
+   * post process
+   */
+  if (fd >= 0) {
+    if (close(fd) < 0 && !ret) ret = DEFAULT_ERROR;
+  }
+
+  return ret;
+}
+
+static int
+verify_payload(const void* a, size_t n, uint64_t sum)
+{
+  int ret;
+  uint64_t h;
+
+  ret = calc_checksum(a, sizeof(double) * n, &h);
+
+  if (!ret && h != sum) {
+    ret = DEFAULT_ERROR;
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_load(const void* buf, size_t size,
+                 cheap_stats_opts_t* opts, cheap_stats_t** dst)
+{
+  int ret;
+  cheap_stats_t* ptr;
+  double* a0;
+  uint64_t sum;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ptr = NULL;
+  a0  = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (buf == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (opts != NULL && opts->threads < 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    ptr = ALLOC(cheap_stats_t);
+    if (ptr == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * read header, and verify the payload (it is copied anyway)
+   */
+  if (!ret) {
+    memset(ptr, 0, sizeof(*ptr));
+    ret = read_header((const unsigned char*)buf, size, ptr, &sum);
+  }
+
+  if (!ret) {
+    ret = verify_payload((const unsigned char*)buf + SNAPSHOT_HEADER_SIZE,
+                         ptr->n, sum);
+  }
+
+  if (!ret) {
+    a0 = NALLOC(double, ptr->n);
+    if (a0 == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * put return parameter (the sorted samples in the lean mode)
+   */
+  if (!ret) {
+    memcpy(a0, (const unsigned char*)buf + SNAPSHOT_HEADER_SIZE,
+           sizeof(double) * ptr->n);
+
+    ptr->a0      = a0;
+    ptr->a1      = a0;
+    ptr->threads = get_threads(opts);
+
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (ret) {
+    if (ptr) free(ptr);
+    if (a0) free(a0);
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_load_mmap(const char* path, int verify,
+                      cheap_stats_opts_t* opts, cheap_stats_t** dst)
+{
+  int ret;
+  int fd;
+  struct stat st;
+  void* map;
+  cheap_stats_t* ptr;
+  uint64_t sum;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  fd  = -1;
+  map = MAP_FAILED;
+  ptr = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (path == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (opts != NULL && opts->threads < 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * map file
+   */
+  if (!ret) do {
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size < SNAPSHOT_HEADER_SIZE) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * read header (the payload is verified only when requested, since it
+   * reads the whole file)
+   */
+  if (!ret) {
+    ptr = ALLOC(cheap_stats_t);
+    if (ptr == NULL) ret = DEFAULT_ERROR;
+  }
+
+  if (!ret) {
+    memset(ptr, 0, sizeof(*ptr));
+    ret = read_header((const unsigned char*)map, st.st_size, ptr, &sum);
+  }
+
+  if (!ret && verify) {
+    ret = verify_payload((unsigned char*)map + SNAPSHOT_HEADER_SIZE,
+                         ptr->n, sum);
+  }
+
+  /*
+   * put return parameter (the sorted samples are borrowed from the map)
+   */
+  if (!ret) {
+    ptr->a0       = (double*)((unsigned char*)map + SNAPSHOT_HEADER_SIZE);
+    ptr->a1       = ptr->a0;
+    ptr->borrowed = !0;
+    ptr->map      = map;
+    ptr->map_size = st.st_size;
+    ptr->threads  = get_threads(opts);
+    map           = MAP_FAILED;
+
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (ret && ptr) free(ptr);
+  if (map != MAP_FAILED) munmap(map, st.st_size);
+  if (fd >= 0) close(fd);
+
+  return ret;
+}
+
+void
+cheap_stats_set_interrupt(volatile int* flag)
+{
+  cheap_interrupt_flag = flag;
+}
+
+int
+cheap_stats_profile(cheap_stats_t* ptr, cheap_profile_t* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+#ifdef CHEAP_PROFILE
+    memcpy(dst, &ptr->profile, sizeof(*dst));
+#else /* defined(CHEAP_PROFILE) */
+    ret = DEFAULT_ERROR;
+#endif /* defined(CHEAP_PROFILE) */
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_destroy(cheap_stats_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    if (ptr->a0 && !ptr->borrowed) free(ptr->a0);
+    if (ptr->a1 && ptr->a1 != ptr->a0) free(ptr->a1);
+    if (ptr->map) munmap(ptr->map, ptr->map_size);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_min(cheap_stats_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get min value
+   */
+  if (!ret) {
+    ret = prepare_minmax(ptr);
+  }
+
+  if (!ret) {
+    *dst = ptr->min;
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_max(cheap_stats_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get max value
+   */
+  if (!ret) {
+    ret = prepare_minmax(ptr);
+  }
+
+  if (!ret) {
+    *dst = ptr->max;
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_q1(cheap_stats_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get 1/4 quartile value
+   */
+  if (!ret) {
+    ret = prepare_sorted(ptr);
+  }
+
+  if (!ret) {
+    *dst = ptr->q1;
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_q3(cheap_stats_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get 3/4 quartile value
+   */
+  if (!ret) {
+    ret = prepare_sorted(ptr);
+  }
+
+  if (!ret) {
+    *dst = ptr->q3;
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_median(cheap_stats_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get median
+   */
+  if (!ret) {
+    ret = prepare_sorted(ptr);
+  }
+
+  if (!ret) {
+    *dst = ptr->median;
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_variance(cheap_stats_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get variance
+   */
+  if (!ret) {
+    ret = prepare_variance(ptr);
+  }
+
+  if (!ret) {
+    *dst = ptr->variance;
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_std(cheap_stats_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get standard deviation
+   */
+  if (!ret) {
+    ret = prepare_variance(ptr);
+  }
+
+  if (!ret) {
+    *dst = ptr->std;
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_cdf(cheap_stats_t* ptr, double v, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc CDF
+   */
+  if (!ret) {
+    ret = prepare_sorted(ptr);
+  }
+
+  if (!ret) {
+    PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_SEARCH);
+    *dst = calc_cdf(ptr->a1, ptr->n, v); 
+    PROF_END(&ptr->profile, CHEAP_PROFILE_SEARCH);
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_cdf_many(cheap_stats_t* ptr, double* xs, size_t m, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (xs == NULL && m > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL && m > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc CDF
+   */
+  if (!ret) {
+    ret = prepare_sorted(ptr);
+  }
+
+  if (!ret) {
+    PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_SEARCH);
+    calc_cdf_many(ptr->a1, ptr->n, xs, m, dst);
+    PROF_END(&ptr->profile, CHEAP_PROFILE_SEARCH);
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_quantiles(cheap_stats_t* ptr, double* ps, size_t k, double* dst)
+{
+  int ret;
+  size_t* ranks;
+  size_t n;
+  size_t m;
+  size_t i;
+  size_t l;
+
+  /*
+   * initialize
+   */
+  ret   = 0;
+  ranks = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ps == NULL || k == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (i = 0; i < k; i++) {
+      if (!(ps[i] >= 0.0 && ps[i] <= 1.0)) break;
+    }
+
+    if (i != k) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * when not sorted yet, select only the ranks that are needed for the
+   * interpolation in the workspace instead of sorting the whole array
+   */
+  if (!ret && !IS_CACHED(ptr, CACHED_SORTED)) {
+    n   = ptr->n;
+    ret = prepare_workspace(ptr);
+
+    if (!ret) {
+      ranks = NALLOC(size_t, k * 2);
+      if (ranks == NULL) ret = DEFAULT_ERROR;
+    }
+
+    if (!ret) {
+      PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_SELECT);
+
+      for (i = 0, m = 0; i < k; i++) {
+        l = (size_t)((n - 1) * ps[i]);
+
+        ranks[m++] = l;
+        if ((l + 1) < n) ranks[m++] = l + 1;
+      }
+
+      qsort(ranks, m, sizeof(*ranks), compare_rank);
+
+      for (i = 1, l = 1; i < m; i++) {
+        if (ranks[i] != ranks[l - 1]) ranks[l++] = ranks[i];
+      }
+
+      ret = cheap_select(ptr->a1, n, ranks, l);
+
+      PROF_END(&ptr->profile, CHEAP_PROFILE_SELECT);
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    for (i = 0; i < k; i++) {
+      dst[i] = calc_quantile(ptr->a1, ptr->n, ps[i]);
+    }
+  }
+
+  /*
+   * post process
+   */
+  if (ranks) free(ranks);
+
+  return ret;
+}
+
+int
+cheap_stats_quantile(cheap_stats_t* ptr, double p, double* dst)
+{
+  return cheap_stats_quantiles(ptr, &p, 1, dst);
+}
+
+int
+cheap_stats_normal_pdf(cheap_stats_t* ptr, double v, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc CDF
+   */
+  if (!ret) {
+    ret = prepare_variance(ptr);
+  }
 
-  t = (v - mean) / std;
+  if (!ret) {
+    *dst = calc_normal_pdf(ptr->a0, ptr->n, ptr->mean, ptr->std, ptr->total, v);
+  }
 
-  // 2.50662827463 == sqrt(2.0 * M_PI)
-  return (exp(-0.5 * (t * t)) / (std * 2.50662827463)) / total;
+  return ret;
 }
 
-static double
-kernel_gaussian(double x)
+static int
+prepare_bandwidth(cheap_stats_t* ptr, double* dst)
 {
-  // 2.50662827463 == sqrt(2.0 * M_PI)
-  return exp(-(x * x) / 2.0) / 2.50662827463;
-}
+  int ret;
+  double sig;
 
-static double
-calc_kde(double* a, size_t n, double sig, double v)
-{
-  double h;
-  double s;
-  int i;
+  /*
+   * initialize
+   */
+  ret = prepare_sorted(ptr);
 
-  h = (0.9 * sig) / pow(n, 1.0 / 5.0);
-  s = 0.0;
+  if (!ret) {
+    ret = prepare_variance(ptr);
+  }
+
+  /*
+   * calc bandwidth (when IQR is zero, use standard deviation)
+   */
+  if (!ret) {
+    sig = ptr->q3 - ptr->q1;
+    if (sig > ptr->std || sig <= 0.0) sig = ptr->std;
 
-  for (i = 0; i < (int)n; i++) {
-    s += kernel_gaussian((v - a[i]) / h);
+    if (!(sig > 0.0)) {
+      ret = DEFAULT_ERROR;
+    } else {
+      *dst = cheap_kde_bandwidth(ptr->n, sig);
+    }
   }
 
-  return (s / (n * h));
+  return ret;
 }
 
 int
-cheap_stats_new(double* src, size_t n, cheap_stats_t** dst)
+cheap_stats_estimated_pdf(cheap_stats_t* ptr, double v, double* dst)
 {
-	int ret;
-  double* a0;
-  double* a1;
-  cheap_stats_t* ptr;
+  int ret;
+  double h;
 
   /*
    * initialize
    */
   ret = 0;
-  ptr = NULL;
-  a0  = NULL;
-  a1  = NULL;
 
   /*
    * argument check
    */
   do {
-    if (src == NULL) {
-      ret = DEFAULT_ERROR;
-      break;
-    }
-
-    if (n < MIN_SAMPLES) {
+    if (ptr == NULL) {
       ret = DEFAULT_ERROR;
       break;
     }
@@ -231,66 +2240,77 @@ cheap_stats_new(double* src, size_t n, cheap_stats_t** dst)
   } while (0);
 
   /*
-   * alloc memory
+   * calc KDE
    */
-  if (!ret) do {
-    a0 = NALLOC(double, n);
-    if (a0 == NULL) {
+  if (!ret) {
+    ret = prepare_bandwidth(ptr, &h);
+  }
+
+  if (!ret) {
+    PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_KDE);
+    *dst = cheap_kde_point(ptr->a1, ptr->n, h, v); 
+    PROF_END(&ptr->profile, CHEAP_PROFILE_KDE);
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_estimated_pdf_grid(cheap_stats_t* ptr,
+                               double lo, double hi, size_t m, double* dst)
+{
+  int ret;
+  double h;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
       ret = DEFAULT_ERROR;
       break;
     }
 
-    a1 = NALLOC(double, n);
-    if (a1 == NULL) {
+    if (!(lo <= hi) || isinf(lo) || isinf(hi)) {
       ret = DEFAULT_ERROR;
       break;
     }
 
-    ptr = ALLOC(cheap_stats_t);
-    if (ptr == NULL) {
+    if (m == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
       ret = DEFAULT_ERROR;
       break;
     }
   } while (0);
 
   /*
-   * put return parameter
+   * calc KDE on the grid (linear binning and FFT convolution)
    */
   if (!ret) {
-    memcpy(a0, src, sizeof(double) * n);
-    memcpy(a1, src, sizeof(double) * n);
-    combsort11(a1, n);
-
-    ptr->a0       = a0;
-    ptr->a1       = a1;
-    ptr->n        = n;
-    ptr->total    = calc_sum(a0, n);
-    ptr->mean     = ptr->total / n;
-    ptr->min      = ptr->a1[0];
-    ptr->max      = ptr->a1[n - 1];
-    ptr->q1       = ptr->a1[n / 4];
-    ptr->q3       = ptr->a1[(3 * n) / 4];
-    ptr->median   = ptr->a1[n / 2];
-    ptr->variance = calc_variance(a0, n, ptr->mean);
-    ptr->std      = sqrt(ptr->variance);
-
-    *dst = ptr;
+    ret = prepare_bandwidth(ptr, &h);
   }
 
-  /*
-   * post process
-   */
-  if (ret) {
-    if (ptr) free(ptr);
-    if (a0) free(a0);
-    if (a1) free(a1);
+  if (!ret) {
+    PROF_BEGIN(&ptr->profile, CHEAP_PROFILE_KDE);
+    ret = cheap_kde_grid(ptr->a1, ptr->n, h, lo, hi, m, dst);
+    PROF_END(&ptr->profile, CHEAP_PROFILE_KDE);
   }
 
   return ret;
 }
 
+
 int
-cheap_stats_destroy(cheap_stats_t* ptr)
+cheap_stats_moment(cheap_stats_t* ptr, double k, double* dst)
 {
   int ret;
 
@@ -302,24 +2322,30 @@ cheap_stats_destroy(cheap_stats_t* ptr)
   /*
    * argument check
    */
-  if (ptr == NULL) {
-    ret = DEFAULT_ERROR;
-  }
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
 
   /*
-   * release memory
+   * calc raw moment
    */
   if (!ret) {
-    if (ptr->a0) free(ptr->a0);
-    if (ptr->a1) free(ptr->a1);
-    free(ptr);
+    *dst = calc_moment(ptr->a0, ptr->n, k); 
   }
 
   return ret;
 }
 
 int
-cheap_stats_cdf(cheap_stats_t* ptr, double v, double* dst)
+cheap_stats_central_moment(cheap_stats_t* ptr, double k, double* dst)
 {
   int ret;
 
@@ -344,17 +2370,17 @@ cheap_stats_cdf(cheap_stats_t* ptr, double v, double* dst)
   } while (0);
 
   /*
-   * calc CDF
+   * calc central moment
    */
   if (!ret) {
-    *dst = calc_cdf(ptr->a1, ptr->n, v); 
+    ret = get_central_moment(ptr, k, dst);
   }
 
   return ret;
 }
 
 int
-cheap_stats_normal_pdf(cheap_stats_t* ptr, double v, double* dst)
+cheap_stats_std_moment(cheap_stats_t* ptr, double k, double* dst)
 {
   int ret;
 
@@ -379,20 +2405,19 @@ cheap_stats_normal_pdf(cheap_stats_t* ptr, double v, double* dst)
   } while (0);
 
   /*
-   * calc CDF
+   * calc standardized moment
    */
   if (!ret) {
-    *dst = calc_normal_pdf(ptr->a1, ptr->n, ptr->mean, ptr->std, ptr->total, v);
+    ret = get_std_moment(ptr, k, dst);
   }
 
   return ret;
 }
 
 int
-cheap_stats_estimated_pdf(cheap_stats_t* ptr, double v, double* dst)
+cheap_stats_skewness(cheap_stats_t* ptr, double* dst)
 {
   int ret;
-  double sig;
 
   /*
    * initialize
@@ -415,21 +2440,17 @@ cheap_stats_estimated_pdf(cheap_stats_t* ptr, double v, double* dst)
   } while (0);
 
   /*
-   * calc CDF
+   * calc skewness
    */
   if (!ret) {
-    sig  = ptr->q3 - ptr->q1;
-    if (sig > ptr->std) sig = ptr->std;
-
-    *dst = calc_kde(ptr->a1, ptr->n, sig, v); 
+    ret = get_std_moment(ptr, 3.0, dst);
   }
 
   return ret;
 }
 
-
 int
-cheap_stats_moment(cheap_stats_t* ptr, double k, double* dst)
+cheap_stats_kurtosis(cheap_stats_t* ptr, double* dst)
 {
   int ret;
 
@@ -454,17 +2475,35 @@ cheap_stats_moment(cheap_stats_t* ptr, double k, double* dst)
   } while (0);
 
   /*
-   * calc raw moment
+   * calc kurtosis
    */
   if (!ret) {
-    *dst = calc_moment(ptr->a1, ptr->n, k); 
+    ret = get_std_moment(ptr, 4.0, dst);
   }
 
   return ret;
 }
 
 int
-cheap_stats_central_moment(cheap_stats_t* ptr, double k, double* dst)
+cheap_stats_excess_kurtosis(cheap_stats_t* ptr, double* dst)
+{
+  int ret;
+  double v;
+
+  /*
+   * calc excess kurtosis (kurtosis of the normal distribution is 3)
+   */
+  ret = cheap_stats_kurtosis(ptr, &v);
+
+  if (!ret) {
+    *dst = v - 3.0;
+  }
+
+  return ret;
+}
+
+int
+cheap_stats_pearson_skewness(cheap_stats_t* ptr, double* dst)
 {
   int ret;
 
@@ -492,14 +2531,22 @@ cheap_stats_central_moment(cheap_stats_t* ptr, double k, double* dst)
    * calc raw moment
    */
   if (!ret) {
-    *dst = calc_central_moment(ptr->a1, ptr->n, k, ptr->mean); 
+    ret = prepare_sorted(ptr);
+  }
+
+  if (!ret) {
+    ret = prepare_variance(ptr);
+  }
+
+  if (!ret) {
+    *dst = (3.0 * (ptr->mean - ptr->median)) / (ptr->std + 1e-15);
   }
 
   return ret;
 }
 
 int
-cheap_stats_std_moment(cheap_stats_t* ptr, double k, double* dst)
+cheap_stats_z_score(cheap_stats_t* ptr, double v, double* dst)
 {
   int ret;
 
@@ -524,17 +2571,21 @@ cheap_stats_std_moment(cheap_stats_t* ptr, double k, double* dst)
   } while (0);
 
   /*
-   * calc raw moment
+   * standard score (see grubbs_outliers() for the test)
    */
   if (!ret) {
-    *dst = calc_std_moment(ptr->a1, ptr->n, k, ptr->mean, ptr->std); 
+    ret = prepare_variance(ptr);
+  }
+
+  if (!ret) {
+    *dst = (v - ptr->mean) / ptr->std;
   }
 
   return ret;
 }
 
 int
-cheap_stats_skewness(cheap_stats_t* ptr, double* dst)
+cheap_stats_normal_cdf(cheap_stats_t* ptr, double v, double* dst)
 {
   int ret;
 
@@ -559,19 +2610,25 @@ cheap_stats_skewness(cheap_stats_t* ptr, double* dst)
   } while (0);
 
   /*
-   * calc raw moment
+   * calc CDF of the fitted normal distribution
    */
   if (!ret) {
-    *dst = calc_std_moment(ptr->a1, ptr->n, 3.0, ptr->mean, ptr->std); 
+    ret = prepare_variance(ptr);
+  }
+
+  if (!ret) {
+    *dst = 0.5 * erfc(-((v - ptr->mean) / ptr->std) * M_SQRT1_2);
   }
 
   return ret;
 }
 
-int
-cheap_stats_pearson_skewness(cheap_stats_t* ptr, double* dst)
+static int
+calc_normal_many(cheap_stats_t* ptr, int kind,
+                 double* xs, size_t m, double* dst)
 {
   int ret;
+  double scale;
 
   /*
    * initialize
@@ -587,31 +2644,146 @@ cheap_stats_pearson_skewness(cheap_stats_t* ptr, double* dst)
       break;
     }
 
-    if (dst == NULL) {
+    if (xs == NULL && m > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL && m > 0) {
       ret = DEFAULT_ERROR;
       break;
     }
   } while (0);
 
+  if (!ret) {
+    ret = prepare_variance(ptr);
+  }
+
   /*
-   * calc raw moment
+   * evaluate by the SIMD kernels
    */
   if (!ret) {
-    *dst = (3.0 * (ptr->mean - ptr->median)) / (ptr->std + 1e-15);
+    switch (kind) {
+    case NORMAL_Z_SCORE:
+      cheap_simd_z_scores(xs, m, ptr->mean, ptr->std, dst, ptr->threads);
+      break;
+
+    case NORMAL_PDF:
+      // 2.50662827463 == sqrt(2.0 * M_PI) (same as calc_normal_pdf())
+      scale = (1.0 / (ptr->std * 2.50662827463)) / ptr->total;
+      cheap_simd_normal_pdf(xs, m, ptr->mean, ptr->std,
+                            scale, dst, ptr->threads);
+      break;
+
+    case NORMAL_CDF:
+      cheap_simd_normal_cdf(xs, m, ptr->mean, ptr->std, dst, ptr->threads);
+      break;
+    }
+
+    if (IS_INTERRUPTED()) ret = INTERRUPTED_ERROR;
   }
 
   return ret;
 }
 
 int
-cheap_stats_z_score(cheap_stats_t* ptr, double v, double* dst)
+cheap_stats_z_scores(cheap_stats_t* ptr, double* xs, size_t m, double* dst)
+{
+  return calc_normal_many(ptr, NORMAL_Z_SCORE, xs, m, dst);
+}
+
+int
+cheap_stats_normal_pdf_many(cheap_stats_t* ptr,
+                            double* xs, size_t m, double* dst)
+{
+  return calc_normal_many(ptr, NORMAL_PDF, xs, m, dst);
+}
+
+int
+cheap_stats_normal_cdf_many(cheap_stats_t* ptr,
+                            double* xs, size_t m, double* dst)
+{
+  return calc_normal_many(ptr, NORMAL_CDF, xs, m, dst);
+}
+
+static void
+trim_recalc(trim_t* t)
+{
+  size_t m;
+
+  m = t->hi - t->lo;
+
+  if (m > 0) {
+    t->mean = calc_sum(t->a + t->lo, m, t->threads) / m;
+    t->m2   = cheap_simd_sum_sq_dev_mt(t->a + t->lo, m, t->mean, t->threads);
+  } else {
+    t->mean = NAN;
+    t->m2   = 0.0;
+  }
+
+  t->m2_ref = t->m2;
+}
+
+/*
+ * test statistic max|x - mean| / s of the remaining samples. the farthest
+ * sample is at either end of the sorted array (*high is set when it is at
+ * the upper end).
+ */
+static double
+trim_peek(trim_t* t, int* high)
+{
+  double dl;
+  double dh;
+  double s;
+
+  dl    = t->mean - t->a[t->lo];
+  dh    = t->a[t->hi - 1] - t->mean;
+  s     = sqrt(t->m2 / (t->hi - t->lo - 1));
+  *high = (dh >= dl);
+
+  return (s > 0.0)? ((*high)? dh: dl) / s: 0.0;
+}
+
+/*
+ * remove the sample at the end, and update the mean and the sum of squared
+ * deviations incrementally (O(1)). they are summed again when the sum is
+ * decreased so much that the cancellation error is not negligible.
+ */
+static double
+trim_pop(trim_t* t, int high)
+{
+  double x;
+  double d;
+
+  x = (high)? t->a[--t->hi]: t->a[t->lo++];
+  d = x - t->mean;
+
+  t->mean -= d / (t->hi - t->lo);
+  t->m2   -= d * (x - t->mean);
+
+  if (t->m2 < t->m2_ref * TRIM_RECALC_RATIO) {
+    trim_recalc(t);
+  }
+
+  return x;
+}
+
+static int
+calc_outliers(cheap_stats_t* ptr, int esd,
+              double alpha, size_t max, double* dst, size_t* k)
 {
   int ret;
+  trim_t t;
+  size_t i;
+  size_t n;
+  double r;
+  int high;
 
   /*
    * initialize
    */
   ret = 0;
+  n   = 0;
 
   /*
    * argument check
@@ -622,18 +2794,77 @@ cheap_stats_z_score(cheap_stats_t* ptr, double v, double* dst)
       break;
     }
 
-    if (dst == NULL) {
+    if (!(alpha > 0.0 && alpha < 1.0)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if ((max > 0 && dst == NULL) || k == NULL) {
       ret = DEFAULT_ERROR;
       break;
     }
   } while (0);
 
   /*
-   * do test (by Smirnov-Grubbs test)
+   * sums over the sorted samples (NaNs at the tail are not tested)
    */
   if (!ret) {
-    *dst = (v - ptr->mean) / ptr->std;
+    ret = prepare_sorted(ptr);
+  }
+
+  if (!ret) {
+    t.a       = ptr->a1;
+    t.lo      = 0;
+    t.hi      = ptr->n - count_nan_tail(ptr->a1, ptr->n);
+    t.threads = ptr->threads;
+
+    trim_recalc(&t);
+  }
+
+  /*
+   * remove the farthest sample one by one (the test needs 3 samples).
+   * Grubbs test stops at the first acceptance, and the generalized ESD
+   * test takes the last rejection in the max steps.
+   */
+  if (!ret) {
+    for (i = 0; i < max && (t.hi - t.lo) >= 3; i++) {
+      if (IS_INTERRUPTED()) {
+        ret = INTERRUPTED_ERROR;
+        break;
+      }
+
+      r = trim_peek(&t, &high);
+
+      if (r > cheap_dist_grubbs_critical(t.hi - t.lo, alpha)) {
+        n = i + 1;
+      } else if (!esd) {
+        break;
+      }
+
+      dst[i] = trim_pop(&t, high);
+    }
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *k = n;
   }
 
   return ret;
 }
+
+int
+cheap_stats_grubbs_outliers(cheap_stats_t* ptr,
+                            double alpha, size_t max, double* dst, size_t* k)
+{
+  return calc_outliers(ptr, 0, alpha, max, dst, k);
+}
+
+int
+cheap_stats_esd_outliers(cheap_stats_t* ptr,
+                         double alpha, size_t max, double* dst, size_t* k)
+{
+  return calc_outliers(ptr, !0, alpha, max, dst, k);
+}
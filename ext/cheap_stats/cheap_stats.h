@@ -9,10 +9,39 @@
 
 #include <stdlib.h>
 
+#include "cheap_profile.h"
+
+#define CHEAP_STATS_MOMENT_ORDER    8
+
+/*
+ * error code returned when the computation was interrupted
+ * (see cheap_stats_set_interrupt())
+ */
+#define CHEAP_STATS_INTERRUPTED     (-1)
+
+/*
+ * element types of the sample file (native byte order)
+ */
+#define CHEAP_STATS_FLOAT64         0
+#define CHEAP_STATS_FLOAT32         1
+
+/*
+ * the sorted array and the derived values are computed on first use,
+ * so read them through the accessor functions (cheap_stats_q1() etc.).
+ *
+ * unless keep_order is set, a0 is sorted in place (a1 == a0), or a0 is
+ * replaced by a1 when it is borrowed. so the order of a0 is not kept.
+ */
 typedef struct {
   double* a0;
-  double* a1; // sorted
+  double* a1; // sorted (allocated on demand)
   size_t n;
+  unsigned int cached;
+  int threads;
+  int borrowed; // a0 is owned by the caller
+  int keep_order;
+  void* map;    // mapped sample file (a0 points into it)
+  size_t map_size;
 
   double total;
   double mean;
@@ -23,16 +52,169 @@ typedef struct {
   double median;
   double variance;
   double std;
+  double cm[CHEAP_STATS_MOMENT_ORDER + 1]; // central moments
+
+#ifdef CHEAP_PROFILE
+  cheap_profile_t profile;
+#endif /* defined(CHEAP_PROFILE) */
 } cheap_stats_t;
 
+/*
+ * options for cheap_stats_new_ex()
+ *
+ *   threads    number of threads used for the sort and the reductions
+ *              (0 or 1 means single thread, capped at CHEAP_MAX_THREADS of
+ *              cheap_thread.h). the results do not depend on the number of
+ *              threads.
+ *
+ *   borrow     use the samples buffer as a0 without copying. the caller
+ *              must keep the buffer alive and unchanged until the object
+ *              is destroyed (or until a0 is replaced by a1, borrowed
+ *              field is cleared then).
+ *
+ *   adopt      use the samples buffer (allocated by malloc()) as a0 and
+ *              take the ownership of it when succeeded (the caller frees
+ *              it on error).
+ *
+ *   keep_order keep a0 in the original order beside the sorted a1 (costs
+ *              another copy of the samples). without it, a0 partially
+ *              ordered by the quantile queries is sorted before the variance
+ *              and the central moments are computed, so they are computed
+ *              over the original order (asked before the first quantile) or
+ *              the sorted order, and may differ in the last bits between
+ *              the two. the uncached reductions (raw moments, fractional
+ *              orders) follow the current order of a0.
+ */
+typedef struct {
+  int threads;
+  int borrow;
+  int adopt;
+  int keep_order;
+} cheap_stats_opts_t;
+
 int cheap_stats_new(double* samples, size_t size, cheap_stats_t** obj);
+int cheap_stats_new_ex(double* samples, size_t size,
+                       cheap_stats_opts_t* opts, cheap_stats_t** obj);
+
+/*
+ * new_mmap() maps the file of the raw array (read only). FLOAT64 file is
+ * used as a0 directly, and FLOAT32 file is converted into a0.
+ */
+int cheap_stats_new_mmap(const char* path, int dtype,
+                         cheap_stats_opts_t* opts, cheap_stats_t** obj);
 int cheap_stats_destroy(cheap_stats_t* obj);
+
+/*
+ * merge() creates the object of the samples of both objects. the sorted
+ * arrays are merged in linear time (both are sorted first if not yet), and
+ * the variance and central moments of the sources (computed first if not
+ * yet) are combined without another pass over the merged samples. the
+ * sources are not changed except for sorting and caching.
+ */
+int cheap_stats_merge(cheap_stats_t* a, cheap_stats_t* b, cheap_stats_t** obj);
+
+/*
+ * snapshot of the computed object (versioned and checksummed, native byte
+ * order). it holds the scalar fields and the sorted samples, so the object
+ * is restored without sorting. the samples are sorted and the moments are
+ * computed before writing if not yet.
+ *
+ * dump() follows the convention of cheap_sketch_dump() for the buffer size.
+ * load_mmap() maps the file and borrows the sorted samples from the map
+ * (the payload checksum is checked only when verify is set, load() always
+ * checks it).
+ */
+int cheap_stats_dump(cheap_stats_t* obj, void* buf, size_t size, size_t* len);
+int cheap_stats_save(cheap_stats_t* obj, const char* path);
+int cheap_stats_load(const void* buf, size_t size,
+                     cheap_stats_opts_t* opts, cheap_stats_t** obj);
+int cheap_stats_load_mmap(const char* path, int verify,
+                          cheap_stats_opts_t* opts, cheap_stats_t** obj);
+
+/*
+ * set the interrupt flag for the functions called on the current thread
+ * (NULL to clear). when the other thread sets *flag to non-zero, the long
+ * running computation is given up and CHEAP_STATS_INTERRUPTED is returned.
+ * the object is kept consistent, so the call can be retried.
+ */
+void cheap_stats_set_interrupt(volatile int* flag);
+
+/*
+ * profile() copies the accumulated profile of the object. it fails unless
+ * the library is built with CHEAP_PROFILE.
+ */
+int cheap_stats_profile(cheap_stats_t* obj, cheap_profile_t* dst);
+
+int cheap_stats_min(cheap_stats_t* obj, double* dst);
+int cheap_stats_max(cheap_stats_t* obj, double* dst);
+int cheap_stats_q1(cheap_stats_t* obj, double* dst);
+int cheap_stats_q3(cheap_stats_t* obj, double* dst);
+int cheap_stats_median(cheap_stats_t* obj, double* dst);
+int cheap_stats_variance(cheap_stats_t* obj, double* dst);
+int cheap_stats_std(cheap_stats_t* obj, double* dst);
+/*
+ * cdf() is the fraction of the samples less than v (lower bound on a1),
+ * and cdf_many() puts the same value for each query (sorted queries are
+ * evaluated in one merge pass over a1). the other types (window, sketch,
+ * group and weighted) use the same definition.
+ *
+ * NOTE: cdf() was the position found by an approximate binary search
+ *       before, that was not exact for the values between or equal to
+ *       the samples.
+ */
 int cheap_stats_cdf(cheap_stats_t* obj, double v, double* dst);
+int cheap_stats_cdf_many(cheap_stats_t* obj, double* xs, size_t m, double* dst);
+
+int cheap_stats_quantile(cheap_stats_t* obj, double p, double* dst);
+int cheap_stats_quantiles(cheap_stats_t* obj, double* ps, size_t k, double* dst);
+int cheap_stats_estimated_pdf(cheap_stats_t* obj, double v, double* dst);
+int cheap_stats_estimated_pdf_grid(cheap_stats_t* obj,
+                                   double lo, double hi, size_t m, double* dst);
+
+/*
+ * integer orders are computed by repeated multiplication instead of pow()
+ * (the results differ from pow() based values only by rounding, relative
+ * error is within about k * n * DBL_EPSILON in the worst case).
+ */
 int cheap_stats_moment(cheap_stats_t* obj, double k, double* dst);
 int cheap_stats_central_moment(cheap_stats_t* obj, double k, double* dst);
 int cheap_stats_std_moment(cheap_stats_t* obj, double k, double* dst);
 int cheap_stats_skewness(cheap_stats_t* obj, double* dst);
+int cheap_stats_kurtosis(cheap_stats_t* obj, double* dst);
+int cheap_stats_excess_kurtosis(cheap_stats_t* obj, double* dst);
 int cheap_stats_pearson_skewness(cheap_stats_t* obj, double* dst);
 int cheap_stats_z_score(cheap_stats_t* obj, double v, double* res);
 
+/*
+ * iterative outlier tests (two-sided, significance level alpha). the
+ * farthest sample is always at either end of the sorted samples, so it is
+ * removed from the end and the mean and the variance are updated
+ * incrementally (O(n) to set up and about O(1) for each step, the samples
+ * are sorted first if not yet). the object is not changed.
+ *
+ * grubbs_outliers() repeats the Smirnov-Grubbs test until no outlier is
+ * found, and esd_outliers() is the generalized ESD test (Rosner) for up to
+ * max outliers. the outliers are put into dst (max entries at least) in the
+ * order of the removal, and the number of them into *k.
+ */
+int cheap_stats_grubbs_outliers(cheap_stats_t* obj,
+                                double alpha, size_t max, double* dst,
+                                size_t* k);
+int cheap_stats_esd_outliers(cheap_stats_t* obj,
+                             double alpha, size_t max, double* dst, size_t* k);
+
+/*
+ * values of the normal distribution fitted to the samples (the PDF is
+ * scaled by 1 / total as same as normal_pdf()). the *_many() versions
+ * evaluate the values by the SIMD kernels (see cheap_simd.h), and xs may
+ * be same as dst.
+ */
+int cheap_stats_normal_pdf(cheap_stats_t* obj, double v, double* dst);
+int cheap_stats_normal_cdf(cheap_stats_t* obj, double v, double* dst);
+int cheap_stats_z_scores(cheap_stats_t* obj, double* xs, size_t m, double* dst);
+int cheap_stats_normal_pdf_many(cheap_stats_t* obj,
+                                double* xs, size_t m, double* dst);
+int cheap_stats_normal_cdf_many(cheap_stats_t* obj,
+                                double* xs, size_t m, double* dst);
+
 #endif /* !defined(__SMALL_STATS_H__) */
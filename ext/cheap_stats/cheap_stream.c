@@ -0,0 +1,524 @@
+﻿/*
+ * Small statics library (streaming accumulator)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cheap_common.h"
+#include "cheap_stream.h"
+
+#define CHUNK_SIZE            512
+
+static void
+reset(cheap_stream_t* ptr)
+{
+  ptr->n     = 0;
+  ptr->total = 0.0;
+  ptr->mean  = 0.0;
+  ptr->min   = INFINITY;
+  ptr->max   = -INFINITY;
+  ptr->m2    = 0.0;
+  ptr->m3    = 0.0;
+  ptr->m4    = 0.0;
+}
+
+static void
+update(cheap_stream_t* ptr, double v)
+{
+  double n0;
+  double n1;
+  double d;
+  double dn;
+  double dn2;
+  double t;
+
+  /*
+   * single pass update of the central moments
+   * (Welford, extended to the 3rd and 4th order by Terriberry)
+   */
+  n0  = (double)ptr->n;
+  n1  = n0 + 1.0;
+  d   = v - ptr->mean;
+  dn  = d / n1;
+  dn2 = dn * dn;
+  t   = d * dn * n0;
+
+  ptr->m4   += (t * dn2 * ((n1 * n1) - (3.0 * n1) + 3.0)) +
+               (6.0 * dn2 * ptr->m2) - (4.0 * dn * ptr->m3);
+  ptr->m3   += (t * dn * (n1 - 2.0)) - (3.0 * dn * ptr->m2);
+  ptr->m2   += t;
+  ptr->mean += dn;
+
+  ptr->n++;
+  ptr->total += v;
+
+  if (v < ptr->min) ptr->min = v;
+  if (v > ptr->max) ptr->max = v;
+}
+
+static void
+combine(cheap_stream_t* dst, cheap_stream_t* src)
+{
+  double na;
+  double nb;
+  double n;
+  double d;
+  double dn;
+  double dn2;
+  double m2;
+  double m3;
+  double m4;
+
+  if (src->n == 0) return;
+
+  if (dst->n == 0) {
+    *dst = *src;
+    return;
+  }
+
+  /*
+   * pairwise combination of the central moments (Chan, Pebay)
+   */
+  na  = (double)dst->n;
+  nb  = (double)src->n;
+  n   = na + nb;
+  d   = src->mean - dst->mean;
+  dn  = d / n;
+  dn2 = dn * dn;
+
+  m2  = dst->m2 + src->m2 + (d * dn * na * nb);
+
+  m3  = dst->m3 + src->m3 +
+        (d * dn2 * na * nb * (na - nb)) +
+        (3.0 * dn * ((na * src->m2) - (nb * dst->m2)));
+
+  m4  = dst->m4 + src->m4 +
+        (d * dn2 * dn * na * nb * ((na * na) - (na * nb) + (nb * nb))) +
+        (6.0 * dn2 * ((na * na * src->m2) + (nb * nb * dst->m2))) +
+        (4.0 * dn * ((na * src->m3) - (nb * dst->m3)));
+
+  dst->mean  += nb * dn;
+  dst->m2     = m2;
+  dst->m3     = m3;
+  dst->m4     = m4;
+  dst->n     += src->n;
+  dst->total += src->total;
+
+  if (src->min < dst->min) dst->min = src->min;
+  if (src->max > dst->max) dst->max = src->max;
+}
+
+static void
+summarize(double* a, size_t n, cheap_stream_t* dst)
+{
+  size_t i;
+  double s;
+  double mean;
+  double d;
+  double d2;
+  double m2;
+  double m3;
+  double m4;
+  double min;
+  double max;
+
+  /*
+   * two pass over a chunk that fits in L1 cache
+   */
+  s   = 0.0;
+  min = a[0];
+  max = a[0];
+
+  for (i = 0; i < n; i++) {
+    s += a[i];
+    if (a[i] < min) min = a[i];
+    if (a[i] > max) max = a[i];
+  }
+
+  mean = s / n;
+  m2   = 0.0;
+  m3   = 0.0;
+  m4   = 0.0;
+
+  for (i = 0; i < n; i++) {
+    d   = a[i] - mean;
+    d2  = d * d;
+    m2 += d2;
+    m3 += d2 * d;
+    m4 += d2 * d2;
+  }
+
+  dst->n     = n;
+  dst->total = s;
+  dst->mean  = mean;
+  dst->min   = min;
+  dst->max   = max;
+  dst->m2    = m2;
+  dst->m3    = m3;
+  dst->m4    = m4;
+}
+
+int
+cheap_stream_new(cheap_stream_t** dst)
+{
+  int ret;
+  cheap_stream_t* ptr;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ptr = NULL;
+
+  /*
+   * argument check
+   */
+  if (dst == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * alloc memory
+   */
+  if (!ret) {
+    ptr = ALLOC(cheap_stream_t);
+    if (ptr == NULL) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    reset(ptr);
+    *dst = ptr;
+  }
+
+  return ret;
+}
+
+int
+cheap_stream_destroy(cheap_stream_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_stream_clear(cheap_stream_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * reset accumulator
+   */
+  if (!ret) {
+    reset(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_stream_push(cheap_stream_t* ptr, double v)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * update accumulator
+   */
+  if (!ret) {
+    update(ptr, v);
+  }
+
+  return ret;
+}
+
+int
+cheap_stream_push_many(cheap_stream_t* ptr, double* a, size_t n)
+{
+  int ret;
+  cheap_stream_t chunk;
+  size_t i;
+  size_t m;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (a == NULL && n > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * summarize each chunk, then combine it into the accumulator
+   */
+  if (!ret) {
+    for (i = 0; i < n; i += m) {
+      m = ((n - i) < CHUNK_SIZE)? (n - i): CHUNK_SIZE;
+
+      summarize(a + i, m, &chunk);
+      combine(ptr, &chunk);
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_stream_merge(cheap_stream_t* ptr, cheap_stream_t* src)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (src == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * combine accumulators
+   */
+  if (!ret) {
+    combine(ptr, src);
+  }
+
+  return ret;
+}
+
+int
+cheap_stream_variance(cheap_stream_t* ptr, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc variance
+   */
+  if (!ret) {
+    *dst = ptr->m2 / ptr->n;
+  }
+
+  return ret;
+}
+
+int
+cheap_stream_std(cheap_stream_t* ptr, double* dst)
+{
+  int ret;
+  double v;
+
+  /*
+   * calc standard deviation
+   */
+  ret = cheap_stream_variance(ptr, &v);
+
+  if (!ret) {
+    *dst = sqrt(v);
+  }
+
+  return ret;
+}
+
+int
+cheap_stream_central_moment(cheap_stream_t* ptr, int k, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (k < 1 || k > 4) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc central moment
+   */
+  if (!ret) {
+    switch (k) {
+    case 1:
+      *dst = 0.0;
+      break;
+
+    case 2:
+      *dst = ptr->m2 / ptr->n;
+      break;
+
+    case 3:
+      *dst = ptr->m3 / ptr->n;
+      break;
+
+    case 4:
+      *dst = ptr->m4 / ptr->n;
+      break;
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_stream_skewness(cheap_stream_t* ptr, double* dst)
+{
+  int ret;
+  double m2;
+  double m3;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc skewness (same definition as cheap_stats_skewness())
+   */
+  if (!ret) {
+    m2   = ptr->m2 / ptr->n;
+    m3   = ptr->m3 / ptr->n;
+    *dst = m3 / pow(sqrt(m2), 3.0);
+  }
+
+  return ret;
+}
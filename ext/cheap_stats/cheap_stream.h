@@ -0,0 +1,39 @@
+﻿/*
+ * Small statics library (streaming accumulator)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_STREAM_H__
+#define __CHEAP_STREAM_H__
+
+#include <stdlib.h>
+
+/*
+ * accumulate samples one by one without keeping them. central moments are
+ * kept as sums of powered deviations (m2 = sum((x - mean)^2), ...).
+ */
+typedef struct {
+  size_t n;
+
+  double total;
+  double mean;
+  double min;
+  double max;
+  double m2;
+  double m3;
+  double m4;
+} cheap_stream_t;
+
+int cheap_stream_new(cheap_stream_t** obj);
+int cheap_stream_destroy(cheap_stream_t* obj);
+int cheap_stream_clear(cheap_stream_t* obj);
+int cheap_stream_push(cheap_stream_t* obj, double v);
+int cheap_stream_push_many(cheap_stream_t* obj, double* a, size_t n);
+int cheap_stream_merge(cheap_stream_t* obj, cheap_stream_t* src);
+int cheap_stream_variance(cheap_stream_t* obj, double* dst);
+int cheap_stream_std(cheap_stream_t* obj, double* dst);
+int cheap_stream_central_moment(cheap_stream_t* obj, int k, double* dst);
+int cheap_stream_skewness(cheap_stream_t* obj, double* dst);
+
+#endif /* !defined(__CHEAP_STREAM_H__) */
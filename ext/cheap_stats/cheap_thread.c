@@ -0,0 +1,71 @@
+﻿/*
+ * Small statics library (thread helper)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "cheap_common.h"
+#include "cheap_thread.h"
+
+__thread volatile int* cheap_interrupt_flag = NULL;
+
+typedef struct {
+  cheap_task_t fn;
+  void* arg;
+  volatile int* interrupt;
+  int index;
+  int started;
+  pthread_t thread;
+} worker_t;
+
+static void*
+worker_main(void* _ptr)
+{
+  worker_t* ptr;
+
+  ptr = (worker_t*)_ptr;
+
+  cheap_interrupt_flag = ptr->interrupt;
+  ptr->fn(ptr->arg, ptr->index);
+
+  return NULL;
+}
+
+void
+cheap_parallel(int threads, cheap_task_t fn, void* arg)
+{
+  worker_t w[CHEAP_MAX_THREADS];
+  int i;
+
+  if (threads < 1) threads = 1;
+  if (threads > CHEAP_MAX_THREADS) threads = CHEAP_MAX_THREADS;
+
+  /*
+   * fork
+   */
+  for (i = 1; i < threads; i++) {
+    w[i].fn        = fn;
+    w[i].arg       = arg;
+    w[i].interrupt = cheap_interrupt_flag;
+    w[i].index     = i;
+    w[i].started   = !pthread_create(&w[i].thread, NULL, worker_main, w + i);
+  }
+
+  fn(arg, 0);
+
+  /*
+   * join (and run the parts that could not be started)
+   */
+  for (i = 1; i < threads; i++) {
+    if (w[i].started) {
+      pthread_join(w[i].thread, NULL);
+    } else {
+      fn(arg, i);
+    }
+  }
+}
@@ -0,0 +1,23 @@
+﻿/*
+ * Small statics library (thread helper)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_THREAD_H__
+#define __CHEAP_THREAD_H__
+
+#include <stdlib.h>
+
+#define CHEAP_MAX_THREADS     256
+
+/*
+ * run fn(arg, i) for i = 0 .. threads - 1 in parallel, and wait for all of
+ * them (i = 0 runs on the calling thread). when a thread can not be
+ * created, its part is run on the calling thread after the others.
+ */
+typedef void (*cheap_task_t)(void* arg, int index);
+
+void cheap_parallel(int threads, cheap_task_t fn, void* arg);
+
+#endif /* !defined(__CHEAP_THREAD_H__) */
@@ -0,0 +1,521 @@
+﻿/*
+ * Small statics library (weighted samples)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cheap_common.h"
+#include "cheap_sort.h"
+#include "cheap_kde.h"
+#include "cheap_weighted.h"
+
+typedef struct {
+  double v;
+  double w;
+} pair_t;
+
+static int
+compare_pair(const void* _a, const void* _b)
+{
+  double a;
+  double b;
+
+  a = ((const pair_t*)_a)->v;
+  b = ((const pair_t*)_b)->v;
+
+  return (a > b) - (a < b);
+}
+
+/*
+ * index of the value of the rank r (first i with cw[i] > r). for integer
+ * weights, it is the index of a[(size_t)r] on the expanded samples.
+ */
+static size_t
+find_rank(cheap_weighted_t* ptr, double r)
+{
+  size_t lo;
+  size_t hi;
+  size_t mid;
+
+  lo = 0;
+  hi = ptr->m - 1;
+
+  while (lo < hi) {
+    mid = lo + ((hi - lo) / 2);
+
+    if (ptr->cw[mid] > r) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  return lo;
+}
+
+static double
+rank_value(cheap_weighted_t* ptr, double r)
+{
+  return ptr->v[find_rank(ptr, r)];
+}
+
+static int
+build_table(cheap_weighted_t* ptr, double* values, double* weights, size_t n)
+{
+  int ret;
+  pair_t* pairs;
+  double v;
+  double w;
+  size_t i;
+  size_t m;
+  int sorted;
+
+  /*
+   * initialize
+   */
+  ret    = 0;
+  pairs  = NULL;
+  sorted = !0;
+
+  for (i = 1; i < n; i++) {
+    if (!(values[i - 1] <= values[i])) {
+      sorted = 0;
+      break;
+    }
+  }
+
+  /*
+   * sort the pairs by the value (skipped for the sorted input)
+   */
+  if (!sorted) do {
+    pairs = NALLOC(pair_t, n);
+    if (pairs == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      pairs[i].v = values[i];
+      pairs[i].w = weights[i];
+    }
+
+    qsort(pairs, n, sizeof(pair_t), compare_pair);
+
+    if (IS_INTERRUPTED()) ret = INTERRUPTED_ERROR;
+  } while (0);
+
+  /*
+   * run length encode (the weights of the same value are summed, and the
+   * zero weights are dropped)
+   */
+  if (!ret) {
+    for (i = 0, m = 0; i < n; i++) {
+      v = (pairs)? pairs[i].v: values[i];
+      w = (pairs)? pairs[i].w: weights[i];
+
+      if (w == 0.0) continue;
+
+      if (m > 0 && ptr->v[m - 1] == v) {
+        ptr->w[m - 1] += w;
+      } else {
+        ptr->v[m] = v;
+        ptr->w[m] = w;
+        m++;
+      }
+    }
+
+    ptr->m = m;
+
+    if (m == 0) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * post process
+   */
+  if (pairs) free(pairs);
+
+  return ret;
+}
+
+static void
+summarize(cheap_weighted_t* ptr)
+{
+  double s[CHEAP_STATS_MOMENT_ORDER + 1];
+  double d;
+  double p;
+  size_t i;
+  int k;
+
+  /*
+   * cumulative weights and total
+   */
+  ptr->weight = 0.0;
+  ptr->total  = 0.0;
+
+  for (i = 0; i < ptr->m; i++) {
+    ptr->weight += ptr->w[i];
+    ptr->total  += ptr->w[i] * ptr->v[i];
+    ptr->cw[i]   = ptr->weight;
+  }
+
+  ptr->mean = ptr->total / ptr->weight;
+
+  /*
+   * order statistics (same ranks as cheap_stats_t, n / 4 etc.)
+   */
+  ptr->min    = ptr->v[0];
+  ptr->max    = ptr->v[ptr->m - 1];
+  ptr->q1     = rank_value(ptr, ptr->weight / 4.0);
+  ptr->q3     = rank_value(ptr, (3.0 * ptr->weight) / 4.0);
+  ptr->median = rank_value(ptr, ptr->weight / 2.0);
+
+  /*
+   * power sums of the deviations for all of the orders in one pass
+   */
+  memset(s, 0, sizeof(s));
+
+  for (i = 0; i < ptr->m; i++) {
+    d = ptr->v[i] - ptr->mean;
+    p = ptr->w[i];
+
+    for (k = 1; k <= CHEAP_STATS_MOMENT_ORDER; k++) {
+      p    *= d;
+      s[k] += p;
+    }
+  }
+
+  ptr->cm[0] = 1.0;
+
+  for (k = 1; k <= CHEAP_STATS_MOMENT_ORDER; k++) {
+    ptr->cm[k] = s[k] / ptr->weight;
+  }
+
+  ptr->variance = ptr->cm[2];
+  ptr->std      = sqrt(ptr->variance);
+}
+
+int
+cheap_weighted_new(double* values, double* weights, size_t n,
+                   cheap_weighted_t** dst)
+{
+  int ret;
+  cheap_weighted_t* ptr;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ptr = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (values == NULL || weights == NULL || n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    for (i = 0; i < n; i++) {
+      if (isnan(values[i]) || !(weights[i] >= 0.0 && isfinite(weights[i]))) {
+        ret = DEFAULT_ERROR;
+        break;
+      }
+    }
+  } while (0);
+
+  /*
+   * alloc memory
+   */
+  if (!ret) do {
+    ptr = ALLOC(cheap_weighted_t);
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    memset(ptr, 0, sizeof(*ptr));
+
+    ptr->v  = NALLOC(double, n);
+    ptr->w  = NALLOC(double, n);
+    ptr->cw = NALLOC(double, n);
+
+    if (ptr->v == NULL || ptr->w == NULL || ptr->cw == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * build run length table and summarize
+   */
+  if (!ret) {
+    ret = build_table(ptr, values, weights, n);
+  }
+
+  if (!ret) {
+    summarize(ptr);
+  }
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (ret && ptr) {
+    cheap_weighted_destroy(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_weighted_destroy(cheap_weighted_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    if (ptr->v) free(ptr->v);
+    if (ptr->w) free(ptr->w);
+    if (ptr->cw) free(ptr->cw);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_weighted_quantile(cheap_weighted_t* ptr, double p, double* dst)
+{
+  int ret;
+  double h;
+  double l;
+  double f;
+  double a;
+  double b;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (!(p >= 0.0 && p <= 1.0)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * type 7 definition on the ranks of the expanded samples
+   */
+  if (!ret) {
+    h = (ptr->weight > 1.0)? (ptr->weight - 1.0) * p: 0.0;
+    l = floor(h);
+    f = h - l;
+    a = rank_value(ptr, l);
+
+    if (f > 0.0 && (l + 1.0) < ptr->weight) {
+      b    = rank_value(ptr, l + 1.0);
+      *dst = a + (f * (b - a));
+    } else {
+      *dst = a;
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_weighted_cdf(cheap_weighted_t* ptr, double v, double* dst)
+{
+  int ret;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * weight of the values less than v
+   */
+  if (!ret) {
+    if (isnan(v)) {
+      *dst = NAN;
+    } else {
+      i    = cheap_lower_bound(ptr->v, ptr->m, v);
+      *dst = (i > 0)? ptr->cw[i - 1] / ptr->weight: 0.0;
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_weighted_estimated_pdf(cheap_weighted_t* ptr, double v, double* dst)
+{
+  int ret;
+  double sig;
+  double h;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc bandwidth (when IQR is zero, use standard deviation)
+   */
+  if (!ret) {
+    sig = ptr->q3 - ptr->q1;
+    if (sig > ptr->std || sig <= 0.0) sig = ptr->std;
+
+    if (!(sig > 0.0)) ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * calc KDE
+   */
+  if (!ret) {
+    h    = cheap_kde_bandwidth(ptr->weight, sig);
+    *dst = cheap_kde_point_weighted(ptr->v, ptr->w, ptr->m, ptr->weight, h, v);
+  }
+
+  return ret;
+}
+
+int
+cheap_weighted_central_moment(cheap_weighted_t* ptr, double k, double* dst)
+{
+  int ret;
+  double s;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * the integer orders are read from the cache
+   */
+  if (!ret) {
+    if (k >= 0.0 && k <= CHEAP_STATS_MOMENT_ORDER && k == floor(k)) {
+      *dst = ptr->cm[(int)k];
+
+    } else {
+      for (i = 0, s = 0.0; i < ptr->m; i++) {
+        s += ptr->w[i] * pow(ptr->v[i] - ptr->mean, k);
+      }
+
+      *dst = s / ptr->weight;
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_weighted_std_moment(cheap_weighted_t* ptr, double k, double* dst)
+{
+  int ret;
+  double m;
+
+  ret = cheap_weighted_central_moment(ptr, k, &m);
+
+  if (!ret) {
+    *dst = m / pow(ptr->std, k);
+  }
+
+  return ret;
+}
@@ -0,0 +1,63 @@
+﻿/*
+ * Small statics library (weighted samples)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_WEIGHTED_H__
+#define __CHEAP_WEIGHTED_H__
+
+#include <stdlib.h>
+
+#include "cheap_stats.h"
+
+/*
+ * pre-aggregated samples (value and count pairs) kept as the sorted run
+ * length table, so the samples are not expanded. the weights are frequency
+ * weights (may be fractional), and every value is same as the one of
+ * cheap_stats_t on the expanded samples when the weights are integers.
+ *
+ * all values except the queries are computed at construction in O(m log m)
+ * for the sort (O(m) for the sorted input), and the queries are O(log m) or
+ * O(m) for m distinct values.
+ */
+typedef struct {
+  size_t m;             // number of distinct values
+  double* v;            // distinct values (ascending)
+  double* w;            // weight of each value
+  double* cw;           // cumulative weight (w[0] + ... + w[i])
+
+  double weight;        // total weight (number of samples)
+  double total;
+  double mean;
+  double min;
+  double max;
+  double q1;
+  double q3;
+  double median;
+  double variance;
+  double std;
+  double cm[CHEAP_STATS_MOMENT_ORDER + 1]; // central moments
+} cheap_weighted_t;
+
+/*
+ * values may repeat and need not be sorted (the weights of the same value
+ * are summed). NaN value, and negative or non finite weight are rejected,
+ * and the pairs of zero weight are dropped (at least one weight must be
+ * positive). CHEAP_STATS_INTERRUPTED is returned when it was interrupted.
+ */
+int cheap_weighted_new(double* values, double* weights, size_t n,
+                       cheap_weighted_t** obj);
+int cheap_weighted_destroy(cheap_weighted_t* obj);
+
+/*
+ * same definitions as cheap_stats_quantile(), cheap_stats_cdf(),
+ * cheap_stats_estimated_pdf() and cheap_stats_central_moment() etc.
+ */
+int cheap_weighted_quantile(cheap_weighted_t* obj, double p, double* dst);
+int cheap_weighted_cdf(cheap_weighted_t* obj, double v, double* dst);
+int cheap_weighted_estimated_pdf(cheap_weighted_t* obj, double v, double* dst);
+int cheap_weighted_central_moment(cheap_weighted_t* obj, double k, double* dst);
+int cheap_weighted_std_moment(cheap_weighted_t* obj, double k, double* dst);
+
+#endif /* !defined(__CHEAP_WEIGHTED_H__) */
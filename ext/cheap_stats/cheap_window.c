@@ -0,0 +1,804 @@
+﻿/*
+ * Small statics library (sliding window)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "cheap_common.h"
+#include "cheap_window.h"
+
+#define NIL                   (-1)
+#define SIZE(p,t)             (((t) == NIL)? 0: (p)->size[t])
+
+#define ORDER_MIN             1
+#define ORDER_MAX             2
+#define ORDER_Q1              3
+#define ORDER_Q3              4
+#define ORDER_MEDIAN          5
+
+static uint32_t
+next_prio(cheap_window_t* ptr)
+{
+  uint32_t x;
+
+  /*
+   * xorshift32 (the priorities only have to be independent of the keys)
+   */
+  x          = ptr->seed;
+  x         ^= x << 13;
+  x         ^= x >> 17;
+  x         ^= x << 5;
+  ptr->seed  = x;
+
+  return x;
+}
+
+static int
+less(cheap_window_t* ptr, int a, int b)
+{
+  double x;
+  double y;
+
+  /*
+   * total order of the nodes: by value (NaN is the largest), and by slot
+   * number for the same values
+   */
+  x = ptr->val[a];
+  y = ptr->val[b];
+
+  if (isnan(x) || isnan(y)) {
+    return (isnan(x) && isnan(y))? (a < b): !isnan(x);
+  }
+
+  return (x < y) || (x == y && a < b);
+}
+
+static void
+fix(cheap_window_t* ptr, int t)
+{
+  ptr->size[t] = SIZE(ptr, ptr->left[t]) + SIZE(ptr, ptr->right[t]) + 1;
+}
+
+static int
+merge(cheap_window_t* ptr, int a, int b)
+{
+  if (a == NIL) return b;
+  if (b == NIL) return a;
+
+  if (ptr->prio[a] > ptr->prio[b]) {
+    ptr->right[a] = merge(ptr, ptr->right[a], b);
+    fix(ptr, a);
+    return a;
+
+  } else {
+    ptr->left[b] = merge(ptr, a, ptr->left[b]);
+    fix(ptr, b);
+    return b;
+  }
+}
+
+static void
+split(cheap_window_t* ptr, int t, int x, int* l, int* r)
+{
+  /*
+   * l: nodes less than x, r: the others
+   */
+  if (t == NIL) {
+    *l = NIL;
+    *r = NIL;
+
+  } else if (less(ptr, t, x)) {
+    split(ptr, ptr->right[t], x, &ptr->right[t], r);
+    fix(ptr, t);
+    *l = t;
+
+  } else {
+    split(ptr, ptr->left[t], x, l, &ptr->left[t]);
+    fix(ptr, t);
+    *r = t;
+  }
+}
+
+static int
+erase(cheap_window_t* ptr, int t, int x)
+{
+  if (t == x) {
+    return merge(ptr, ptr->left[t], ptr->right[t]);
+  }
+
+  if (less(ptr, x, t)) {
+    ptr->left[t] = erase(ptr, ptr->left[t], x);
+  } else {
+    ptr->right[t] = erase(ptr, ptr->right[t], x);
+  }
+
+  fix(ptr, t);
+
+  return t;
+}
+
+static void
+insert(cheap_window_t* ptr, int x)
+{
+  int l;
+  int r;
+
+  ptr->left[x]  = NIL;
+  ptr->right[x] = NIL;
+  ptr->size[x]  = 1;
+  ptr->prio[x]  = next_prio(ptr);
+
+  split(ptr, ptr->root, x, &l, &r);
+  ptr->root = merge(ptr, merge(ptr, l, x), r);
+}
+
+static double
+kth(cheap_window_t* ptr, size_t k)
+{
+  int t;
+  size_t l;
+
+  t = ptr->root;
+
+  while (1) {
+    l = SIZE(ptr, ptr->left[t]);
+
+    if (k < l) {
+      t = ptr->left[t];
+
+    } else if (k == l) {
+      break;
+
+    } else {
+      k -= l + 1;
+      t  = ptr->right[t];
+    }
+  }
+
+  return ptr->val[t];
+}
+
+static size_t
+count_less(cheap_window_t* ptr, double v)
+{
+  size_t ret;
+  int t;
+
+  ret = 0;
+  t   = ptr->root;
+
+  while (t != NIL) {
+    if (ptr->val[t] < v) {
+      ret += SIZE(ptr, ptr->left[t]) + 1;
+      t    = ptr->right[t];
+    } else {
+      t    = ptr->left[t];
+    }
+  }
+
+  return ret;
+}
+
+static void
+recompute(cheap_window_t* ptr)
+{
+  size_t i;
+  size_t m;
+  double s;
+  double d;
+
+  /*
+   * two pass over the finite samples
+   */
+  s = 0.0;
+  m = 0;
+
+  for (i = 0; i < ptr->n; i++) {
+    if (isfinite(ptr->val[i])) {
+      s += ptr->val[i];
+      m++;
+    }
+  }
+
+  ptr->mean = (m > 0)? s / m: 0.0;
+  ptr->m2   = 0.0;
+
+  for (i = 0; i < ptr->n; i++) {
+    if (isfinite(ptr->val[i])) {
+      d        = ptr->val[i] - ptr->mean;
+      ptr->m2 += d * d;
+    }
+  }
+
+  ptr->pushed = 0;
+}
+
+static void
+add_moment(cheap_window_t* ptr, double v)
+{
+  double d;
+  size_t m;
+
+  if (!isfinite(v)) {
+    ptr->nonfinite++;
+
+  } else {
+    m          = ptr->n - ptr->nonfinite;   // count including v
+    d          = v - ptr->mean;
+    ptr->mean += d / m;
+    ptr->m2   += d * (v - ptr->mean);
+  }
+}
+
+static void
+remove_moment(cheap_window_t* ptr, double v)
+{
+  double d;
+  size_t m;
+
+  if (!isfinite(v)) {
+    ptr->nonfinite--;
+
+  } else {
+    m = ptr->n - ptr->nonfinite;            // count excluding v
+
+    if (m == 0) {
+      ptr->mean = 0.0;
+      ptr->m2   = 0.0;
+
+    } else {
+      d          = v - ptr->mean;
+      ptr->mean -= d / m;
+      ptr->m2   -= d * (v - ptr->mean);
+      if (ptr->m2 < 0.0) ptr->m2 = 0.0;
+    }
+  }
+}
+
+static void
+push(cheap_window_t* ptr, double v)
+{
+  int x;
+
+  x = (int)ptr->head;
+
+  /*
+   * evict the oldest sample (on the same slot)
+   */
+  if (ptr->n == ptr->capacity) {
+    ptr->root = erase(ptr, ptr->root, x);
+    ptr->n--;
+    remove_moment(ptr, ptr->val[x]);
+  }
+
+  ptr->val[x] = v;
+  insert(ptr, x);
+  ptr->n++;
+  add_moment(ptr, v);
+
+  ptr->head = (ptr->head + 1) % ptr->capacity;
+
+  if (++ptr->pushed >= ptr->capacity) recompute(ptr);
+}
+
+static void
+calc_moments(cheap_window_t* ptr, double* mean, double* var)
+{
+  size_t i;
+  double s;
+  double d;
+
+  if (ptr->nonfinite == 0) {
+    *mean = ptr->mean;
+    *var  = ptr->m2 / ptr->n;
+
+  } else {
+    /*
+     * infinities and NaNs are included (rare case, computed directly)
+     */
+    s = 0.0;
+    for (i = 0; i < ptr->n; i++) s += ptr->val[i];
+
+    *mean = s / ptr->n;
+
+    s = 0.0;
+    for (i = 0; i < ptr->n; i++) {
+      d  = ptr->val[i] - *mean;
+      s += d * d;
+    }
+
+    *var = s / ptr->n;
+  }
+}
+
+static void
+reset(cheap_window_t* ptr)
+{
+  ptr->n         = 0;
+  ptr->head      = 0;
+  ptr->root      = NIL;
+  ptr->seed      = 2463534242U;
+  ptr->nonfinite = 0;
+  ptr->pushed    = 0;
+  ptr->mean      = 0.0;
+  ptr->m2        = 0.0;
+}
+
+int
+cheap_window_new(size_t capacity, cheap_window_t** dst)
+{
+  int ret;
+  cheap_window_t* ptr;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+  ptr = NULL;
+
+  /*
+   * argument check
+   */
+  do {
+    if (capacity == 0 || capacity > INT_MAX) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * alloc memory
+   */
+  if (!ret) do {
+    ptr = ALLOC(cheap_window_t);
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    memset(ptr, 0, sizeof(*ptr));
+
+    ptr->val   = NALLOC(double, capacity);
+    ptr->left  = NALLOC(int, capacity);
+    ptr->right = NALLOC(int, capacity);
+    ptr->size  = NALLOC(int, capacity);
+    ptr->prio  = NALLOC(uint32_t, capacity);
+
+    if (ptr->val == NULL || ptr->left == NULL || ptr->right == NULL ||
+        ptr->size == NULL || ptr->prio == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * put return parameter
+   */
+  if (!ret) {
+    ptr->capacity = capacity;
+    reset(ptr);
+
+    *dst = ptr;
+  }
+
+  /*
+   * post process
+   */
+  if (ret && ptr != NULL) {
+    cheap_window_destroy(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_window_destroy(cheap_window_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * release memory
+   */
+  if (!ret) {
+    if (ptr->val) free(ptr->val);
+    if (ptr->left) free(ptr->left);
+    if (ptr->right) free(ptr->right);
+    if (ptr->size) free(ptr->size);
+    if (ptr->prio) free(ptr->prio);
+    free(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_window_clear(cheap_window_t* ptr)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  if (ptr == NULL) {
+    ret = DEFAULT_ERROR;
+  }
+
+  /*
+   * reset window
+   */
+  if (!ret) {
+    reset(ptr);
+  }
+
+  return ret;
+}
+
+int
+cheap_window_push(cheap_window_t* ptr, double v)
+{
+  return cheap_window_push_many(ptr, &v, 1);
+}
+
+int
+cheap_window_push_many(cheap_window_t* ptr, double* a, size_t n)
+{
+  int ret;
+  size_t i;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (a == NULL && n > 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * push samples (only the last capacity samples remain)
+   */
+  if (!ret) {
+    if (n > ptr->capacity) {
+      a += n - ptr->capacity;
+      n  = ptr->capacity;
+    }
+
+    for (i = 0; i < n; i++) {
+      push(ptr, a[i]);
+    }
+  }
+
+  return ret;
+}
+
+static int
+get_order(cheap_window_t* ptr, int which, double* dst)
+{
+  int ret;
+  size_t n;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get order statistic (same indices as cheap_stats_t)
+   */
+  if (!ret) {
+    n = ptr->n;
+
+    switch (which) {
+    case ORDER_MIN:
+      *dst = kth(ptr, 0);
+      break;
+
+    case ORDER_MAX:
+      *dst = kth(ptr, n - 1);
+      break;
+
+    case ORDER_Q1:
+      *dst = kth(ptr, n / 4);
+      break;
+
+    case ORDER_Q3:
+      *dst = kth(ptr, (3 * n) / 4);
+      break;
+
+    case ORDER_MEDIAN:
+      *dst = kth(ptr, n / 2);
+      break;
+
+    default:
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  }
+
+  return ret;
+}
+
+int
+cheap_window_min(cheap_window_t* ptr, double* dst)
+{
+  return get_order(ptr, ORDER_MIN, dst);
+}
+
+int
+cheap_window_max(cheap_window_t* ptr, double* dst)
+{
+  return get_order(ptr, ORDER_MAX, dst);
+}
+
+int
+cheap_window_q1(cheap_window_t* ptr, double* dst)
+{
+  return get_order(ptr, ORDER_Q1, dst);
+}
+
+int
+cheap_window_q3(cheap_window_t* ptr, double* dst)
+{
+  return get_order(ptr, ORDER_Q3, dst);
+}
+
+int
+cheap_window_median(cheap_window_t* ptr, double* dst)
+{
+  return get_order(ptr, ORDER_MEDIAN, dst);
+}
+
+int
+cheap_window_mean(cheap_window_t* ptr, double* dst)
+{
+  int ret;
+  double var;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get mean
+   */
+  if (!ret) {
+    calc_moments(ptr, dst, &var);
+  }
+
+  return ret;
+}
+
+int
+cheap_window_variance(cheap_window_t* ptr, double* dst)
+{
+  int ret;
+  double mean;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * get variance
+   */
+  if (!ret) {
+    calc_moments(ptr, &mean, dst);
+  }
+
+  return ret;
+}
+
+int
+cheap_window_std(cheap_window_t* ptr, double* dst)
+{
+  int ret;
+  double v;
+
+  ret = cheap_window_variance(ptr, &v);
+
+  if (!ret) {
+    *dst = sqrt(v);
+  }
+
+  return ret;
+}
+
+int
+cheap_window_cdf(cheap_window_t* ptr, double v, double* dst)
+{
+  int ret;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * calc CDF (fraction of the samples less than v)
+   */
+  if (!ret) {
+    *dst = isnan(v)? NAN: (double)count_less(ptr, v) / ptr->n;
+  }
+
+  return ret;
+}
+
+int
+cheap_window_quantile(cheap_window_t* ptr, double p, double* dst)
+{
+  int ret;
+  double h;
+  double f;
+  double x;
+  size_t l;
+
+  /*
+   * initialize
+   */
+  ret = 0;
+
+  /*
+   * argument check
+   */
+  do {
+    if (ptr == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (ptr->n == 0) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (!(p >= 0.0 && p <= 1.0)) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+
+    if (dst == NULL) {
+      ret = DEFAULT_ERROR;
+      break;
+    }
+  } while (0);
+
+  /*
+   * linear interpolation between the closest ranks
+   * (same as cheap_stats_quantile())
+   */
+  if (!ret) {
+    h = (ptr->n - 1) * p;
+    l = (size_t)h;
+    f = h - l;
+    x = kth(ptr, l);
+
+    if (f > 0.0 && (l + 1) < ptr->n) {
+      x += f * (kth(ptr, l + 1) - x);
+    }
+
+    *dst = x;
+  }
+
+  return ret;
+}
@@ -0,0 +1,66 @@
+﻿/*
+ * Small statics library (sliding window)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __CHEAP_WINDOW_H__
+#define __CHEAP_WINDOW_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * keep the latest samples up to the capacity. the samples are stored in a
+ * ring buffer, and each slot is also a node of the order statistic tree
+ * (treap augmented with the subtree size), so push (with eviction of the
+ * oldest sample) and the order statistics cost O(log w).
+ *
+ * the order statistics follow the definitions of cheap_stats_t (q1 is the
+ * n/4-th sample of the sorted window etc.), and cdf() is the fraction of
+ * the samples less than the value (same as cheap_stats_cdf()).
+ */
+typedef struct {
+  size_t capacity;
+  size_t n;
+  size_t head;          // slot for the next sample
+
+  double* val;
+  int* left;
+  int* right;
+  int* size;
+  uint32_t* prio;
+  int root;
+  uint32_t seed;
+
+  /*
+   * running moments of the finite samples (recomputed once per round of
+   * the ring to cancel the drift of the removals)
+   */
+  size_t nonfinite;
+  size_t pushed;
+  double mean;
+  double m2;
+} cheap_window_t;
+
+int cheap_window_new(size_t capacity, cheap_window_t** obj);
+int cheap_window_destroy(cheap_window_t* obj);
+int cheap_window_clear(cheap_window_t* obj);
+int cheap_window_push(cheap_window_t* obj, double v);
+int cheap_window_push_many(cheap_window_t* obj, double* a, size_t n);
+
+/*
+ * query functions fail when the window is empty
+ */
+int cheap_window_min(cheap_window_t* obj, double* dst);
+int cheap_window_max(cheap_window_t* obj, double* dst);
+int cheap_window_q1(cheap_window_t* obj, double* dst);
+int cheap_window_q3(cheap_window_t* obj, double* dst);
+int cheap_window_median(cheap_window_t* obj, double* dst);
+int cheap_window_mean(cheap_window_t* obj, double* dst);
+int cheap_window_variance(cheap_window_t* obj, double* dst);
+int cheap_window_std(cheap_window_t* obj, double* dst);
+int cheap_window_cdf(cheap_window_t* obj, double v, double* dst);
+int cheap_window_quantile(cheap_window_t* obj, double p, double* dst);
+
+#endif /* !defined(__CHEAP_WINDOW_H__) */
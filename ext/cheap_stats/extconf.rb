@@ -1,4 +1,10 @@
 require 'mkmf'
 
 have_library( "m")
+have_library( "pthread")
+have_header( "ruby/memory_view.h")
+
+# per-phase timings and counters (CheapStats#profile)
+$defs << "-DCHEAP_PROFILE" if enable_config("profile", false)
+
 create_makefile( "cheap_stats/cheap_stats")
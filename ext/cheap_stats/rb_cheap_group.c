@@ -0,0 +1,511 @@
+﻿/*
+ * cheap statistics library for ruby (grouped statistics)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ruby.h"
+
+#include "cheap_stats.h"
+#include "cheap_group.h"
+#include "rb_cheap_stats.h"
+
+/*
+ * owner of the arena (hidden object shared by the summaries)
+ */
+typedef struct {
+  cheap_group_t* group;
+} rb_cheap_group_t;
+
+/*
+ * summary of a group
+ */
+typedef struct {
+  VALUE owner;
+  cheap_group_t* group;
+  size_t index;
+} rb_cheap_summary_t;
+
+/*
+ * arguments of the library call that runs without the GVL
+ */
+typedef struct {
+  int64_t* keys;
+  double* values;
+  size_t n;
+  int threads;
+  cheap_group_t** obj;
+
+} group_call_t;
+
+static VALUE summary_klass;
+
+static size_t
+rb_cheap_group_size(const void* _ptr)
+{
+  rb_cheap_group_t* ptr;
+  size_t ret;
+
+  ptr = (rb_cheap_group_t*)_ptr;
+  ret = sizeof(rb_cheap_group_t);
+
+  if (ptr->group != NULL) {
+    ret += sizeof(cheap_group_t);
+    ret += (sizeof(int64_t) + sizeof(double)) * ptr->group->n;
+    ret += (sizeof(size_t) + sizeof(cheap_group_summary_t)) *
+           ptr->group->groups;
+  }
+
+  return ret;
+}
+
+static void
+rb_cheap_group_free(void* _ptr)
+{
+  rb_cheap_group_t* ptr;
+
+  ptr = (rb_cheap_group_t*)_ptr;
+
+  if (ptr->group != NULL) {
+    cheap_group_destroy(ptr->group);
+    ptr->group = NULL;
+  }
+
+  xfree(ptr);
+}
+
+static const rb_data_type_t rb_cheap_group_data_type = {
+  "A Cheap satatics library (group)",
+  {
+    NULL,
+    rb_cheap_group_free,
+    rb_cheap_group_size,
+  },
+  NULL,
+  NULL,
+};
+
+static void
+rb_cheap_summary_mark(void* _ptr)
+{
+  rb_gc_mark(((rb_cheap_summary_t*)_ptr)->owner);
+}
+
+static size_t
+rb_cheap_summary_size(const void* _ptr)
+{
+  return sizeof(rb_cheap_summary_t);
+}
+
+static const rb_data_type_t rb_cheap_summary_data_type = {
+  "A Cheap satatics library (summary)",
+  {
+    rb_cheap_summary_mark,
+    RUBY_TYPED_DEFAULT_FREE,
+    rb_cheap_summary_size,
+  },
+  NULL,
+  NULL,
+};
+
+static cheap_group_summary_t*
+get_summary(VALUE self, rb_cheap_summary_t** dst)
+{
+  rb_cheap_summary_t* ptr;
+
+  TypedData_Get_Struct(self, rb_cheap_summary_t,
+                       &rb_cheap_summary_data_type, ptr);
+
+  if (ptr->group == NULL) {
+    rb_raise(rb_eRuntimeError, "summary is not initialized");
+  }
+
+  if (dst != NULL) *dst = ptr;
+
+  return ptr->group->sum + ptr->index;
+}
+
+static int
+group_invoke(void* _c)
+{
+  group_call_t* c;
+
+  c = (group_call_t*)_c;
+
+  return cheap_group_new(c->keys, c->values, c->n, c->threads, c->obj);
+}
+
+/*
+ * get keys from Array (any objects, numbered by the Hash) or String
+ * (packed native int64). *list is the Array of the distinct keys for the
+ * former case.
+ */
+static int64_t*
+get_keys(VALUE src, size_t* n, volatile VALUE* tmp, VALUE* list)
+{
+  int64_t* ret;
+  VALUE map;
+  VALUE id;
+  VALUE v;
+  long len;
+  long i;
+
+  switch (TYPE(src)) {
+  case T_ARRAY:
+    len   = RARRAY_LEN(src);
+    ret   = rb_alloc_tmp_buffer(tmp, sizeof(int64_t) * (len + 1));
+    map   = rb_hash_new();
+    *list = rb_ary_new();
+
+    for (i = 0; i < len; i++) {
+      v  = RARRAY_AREF(src, i);
+      id = rb_hash_lookup2(map, v, Qundef);
+
+      if (id == Qundef) {
+        id = LONG2FIX(RARRAY_LEN(*list));
+        rb_hash_aset(map, v, id);
+        rb_ary_push(*list, v);
+      }
+
+      ret[i] = FIX2LONG(id);
+    }
+    break;
+
+  case T_STRING:
+    if (RSTRING_LEN(src) % sizeof(int64_t) != 0) {
+      ARGUMENT_ERROR("length of packed string is not multiple of %d",
+                     (int)sizeof(int64_t));
+    }
+
+    len   = RSTRING_LEN(src) / sizeof(int64_t);
+    ret   = rb_alloc_tmp_buffer(tmp, sizeof(int64_t) * (len + 1));
+    *list = Qnil;
+    memcpy(ret, RSTRING_PTR(src), sizeof(int64_t) * len);
+    break;
+
+  default:
+    TYPE_ERROR("Array or String is expected (%s)", rb_obj_classname(src));
+  }
+
+  *n = len;
+
+  return ret;
+}
+
+/**
+ * compute the summaries for each key at once. the samples are bucketed by
+ * the key into one arena and each group is sorted there, so no Array is
+ * made for the groups.
+ *
+ * @params [Array, String] keys       key of each sample (Array of any
+ *                                    objects, or packed native int64 such
+ *                                    as Array#pack("q*")).
+ * @params [Array<Numeric>, String] values
+ *                                    sample values (Array or packed native
+ *                                    doubles).
+ * @params [Integer] threads          number of threads used for the sort
+ *                                    and the summaries (default: 1).
+ *
+ * @return [Hash{Object => CheapStats::Summary}] summary of each key
+ */
+static VALUE
+rb_cheap_stats_s_group(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_group_t* ptr;
+  rb_cheap_summary_t* sum;
+  VALUE keys;
+  VALUE values;
+  VALUE opts;
+  VALUE list;
+  VALUE owner;
+  VALUE ret;
+  VALUE obj;
+  VALUE key;
+  volatile VALUE tmp1;
+  volatile VALUE tmp2;
+  group_call_t c;
+  size_t nk;
+  size_t nv;
+  size_t g;
+  static ID ids[1];
+  VALUE vals[N(ids)];
+  int err;
+
+  /*
+   * check argument
+   */
+  rb_scan_args(argc, argv, "2:", &keys, &values, &opts);
+
+  if (!ids[0]) {
+    ids[0] = rb_intern_const("threads");
+  }
+
+  memset(&c, 0, sizeof(c));
+
+  if (!NIL_P(opts)) {
+    rb_get_kwargs(opts, ids, 0, N(ids), vals);
+
+    if (vals[0] != Qundef && !NIL_P(vals[0])) {
+      c.threads = NUM2INT(vals[0]);
+
+      if (c.threads < 1) {
+        ARGUMENT_ERROR("threads must be positive (%d)", c.threads);
+      }
+    }
+  }
+
+  tmp1 = 0;
+  tmp2 = 0;
+
+  c.keys   = get_keys(keys, &nk, &tmp1, &list);
+  c.values = rb_cheap_get_values(&values, &nv, &tmp2);
+  c.n      = nv;
+
+  if (nk != nv) {
+    ARGUMENT_ERROR("number of keys and values are not same (%zu, %zu)",
+                   nk, nv);
+  }
+
+  ret = rb_hash_new();
+
+  if (nv == 0) return ret;
+
+  /*
+   * bucket and summarize
+   */
+  owner = TypedData_Make_Struct(0, rb_cheap_group_t,
+                                &rb_cheap_group_data_type, ptr);
+
+  c.obj = &ptr->group;
+  err   = rb_cheap_call(c.n, group_invoke, &c);
+
+  if (err) {
+    RUNTIME_ERROR("cheap_group_new() failed [err=%d]", err);
+  }
+
+  /*
+   * create summaries
+   */
+  for (g = 0; g < ptr->group->groups; g++) {
+    if (NIL_P(list)) {
+      key = LL2NUM(ptr->group->keys[g]);
+    } else {
+      key = RARRAY_AREF(list, ptr->group->keys[g]);
+    }
+
+    obj = TypedData_Make_Struct(summary_klass, rb_cheap_summary_t,
+                                &rb_cheap_summary_data_type, sum);
+
+    sum->owner = owner;
+    sum->group = ptr->group;
+    sum->index = g;
+
+    rb_hash_aset(ret, key, obj);
+  }
+
+  /*
+   * post process
+   */
+  rb_free_tmp_buffer(&tmp1);
+  rb_free_tmp_buffer(&tmp2);
+
+  RB_GC_GUARD(owner);
+  RB_GC_GUARD(list);
+  RB_GC_GUARD(values);
+
+  return ret;
+}
+
+/**
+ * get number of samples
+ *
+ * @return [Integer] number of samples
+ */
+static VALUE
+rb_cheap_summary_count(VALUE self)
+{
+  return SIZET2NUM(get_summary(self, NULL)->n);
+}
+
+/**
+ * get total value of samples
+ *
+ * @return [Float] total value
+ */
+static VALUE
+rb_cheap_summary_total(VALUE self)
+{
+  return DBL2NUM(get_summary(self, NULL)->total);
+}
+
+/**
+ * get mean of samples
+ *
+ * @return [Float] mean
+ */
+static VALUE
+rb_cheap_summary_mean(VALUE self)
+{
+  return DBL2NUM(get_summary(self, NULL)->mean);
+}
+
+/**
+ * get min value of samples
+ *
+ * @return [Float] min value
+ */
+static VALUE
+rb_cheap_summary_min(VALUE self)
+{
+  return DBL2NUM(get_summary(self, NULL)->min);
+}
+
+/**
+ * get max value of samples
+ *
+ * @return [Float] max value
+ */
+static VALUE
+rb_cheap_summary_max(VALUE self)
+{
+  return DBL2NUM(get_summary(self, NULL)->max);
+}
+
+/**
+ * get 1/4 quartile value of samples
+ *
+ * @return [Float] 1/4 quartile value
+ */
+static VALUE
+rb_cheap_summary_q1(VALUE self)
+{
+  return DBL2NUM(get_summary(self, NULL)->q1);
+}
+
+/**
+ * get 3/4 quartile value of samples
+ *
+ * @return [Float] 3/4 quartile value
+ */
+static VALUE
+rb_cheap_summary_q3(VALUE self)
+{
+  return DBL2NUM(get_summary(self, NULL)->q3);
+}
+
+/**
+ * get median of samples
+ *
+ * @return [Float] median
+ */
+static VALUE
+rb_cheap_summary_median(VALUE self)
+{
+  return DBL2NUM(get_summary(self, NULL)->median);
+}
+
+/**
+ * get variance of samples
+ *
+ * @return [Float] variance
+ */
+static VALUE
+rb_cheap_summary_variance(VALUE self)
+{
+  return DBL2NUM(get_summary(self, NULL)->variance);
+}
+
+/**
+ * get standard division of samples
+ *
+ * @return [Float] standard division
+ */
+static VALUE
+rb_cheap_summary_std(VALUE self)
+{
+  return DBL2NUM(get_summary(self, NULL)->std);
+}
+
+/**
+ * calc quantile (interpolated linearly between the closest ranks)
+ *
+ * @param [Numeric] p   probability (0.0 .. 1.0)
+ *
+ * @return [Float] quantile value
+ */
+static VALUE
+rb_cheap_summary_quantile(VALUE self, VALUE p)
+{
+  rb_cheap_summary_t* ptr;
+  int err;
+  double ret;
+  double v;
+
+  get_summary(self, &ptr);
+  v = NUM2DBL(p);
+
+  if (!(v >= 0.0 && v <= 1.0)) {
+    ARGUMENT_ERROR("probability is out of range (%f)", v);
+  }
+
+  err = cheap_group_quantile(ptr->group, ptr->index, v, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_group_quantile() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc CDF
+ *
+ * @param [Numeric] x   taregt value
+ *
+ * @return [Float] fraction of the samples less than the value
+ */
+static VALUE
+rb_cheap_summary_cdf(VALUE self, VALUE x)
+{
+  rb_cheap_summary_t* ptr;
+  int err;
+  double ret;
+
+  get_summary(self, &ptr);
+
+  err = cheap_group_cdf(ptr->group, ptr->index, NUM2DBL(x), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_group_cdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+void
+rb_cheap_group_setup(VALUE outer)
+{
+  summary_klass = rb_define_class_under(outer, "Summary", rb_cObject);
+
+  rb_undef_alloc_func(summary_klass);
+
+  rb_define_singleton_method(outer, "group", rb_cheap_stats_s_group, -1);
+
+  rb_define_method(summary_klass, "count", rb_cheap_summary_count, 0);
+  rb_define_method(summary_klass, "total", rb_cheap_summary_total, 0);
+  rb_define_method(summary_klass, "mean", rb_cheap_summary_mean, 0);
+  rb_define_method(summary_klass, "min", rb_cheap_summary_min, 0);
+  rb_define_method(summary_klass, "max", rb_cheap_summary_max, 0);
+  rb_define_method(summary_klass, "q1", rb_cheap_summary_q1, 0);
+  rb_define_method(summary_klass, "q3", rb_cheap_summary_q3, 0);
+  rb_define_method(summary_klass, "median", rb_cheap_summary_median, 0);
+  rb_define_method(summary_klass, "variance", rb_cheap_summary_variance, 0);
+  rb_define_method(summary_klass, "std", rb_cheap_summary_std, 0);
+  rb_define_method(summary_klass, "quantile", rb_cheap_summary_quantile, 1);
+  rb_define_method(summary_klass, "cdf", rb_cheap_summary_cdf, 1);
+
+  rb_alias(summary_klass, rb_intern("average"), rb_intern("mean"));
+  rb_alias(summary_klass, rb_intern("sigma"), rb_intern("std"));
+}
@@ -0,0 +1,561 @@
+﻿/*
+ * cheap statistics library for ruby (log-bucketed histogram)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ruby.h"
+
+#include "cheap_hdr.h"
+#include "rb_cheap_stats.h"
+
+typedef struct {
+  cheap_hdr_t* hdr;
+} rb_cheap_hdr_t;
+
+static VALUE hdr_klass;
+
+static size_t
+rb_cheap_hdr_size(const void* _ptr)
+{
+  rb_cheap_hdr_t* ptr;
+  size_t ret;
+
+  ptr = (rb_cheap_hdr_t*)_ptr;
+  ret = sizeof(rb_cheap_hdr_t);
+
+  if (ptr->hdr != NULL) {
+    ret += sizeof(cheap_hdr_t);
+    ret += sizeof(uint64_t) * ptr->hdr->size;
+  }
+
+  return ret;
+}
+
+static void
+rb_cheap_hdr_free(void* _ptr)
+{
+  rb_cheap_hdr_t* ptr;
+
+  ptr = (rb_cheap_hdr_t*)_ptr;
+
+  if (ptr->hdr != NULL) {
+    cheap_hdr_destroy(ptr->hdr);
+    ptr->hdr = NULL;
+  }
+
+  xfree(ptr);
+}
+
+static const rb_data_type_t rb_cheap_hdr_data_type = {
+  "A Cheap satatics library (histogram)",
+  {
+    NULL,
+    rb_cheap_hdr_free,
+    rb_cheap_hdr_size,
+  },
+  NULL,
+  NULL,
+};
+
+static VALUE
+rb_cheap_hdr_alloc(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+
+  ptr = ALLOC(rb_cheap_hdr_t);
+  memset(ptr, 0, sizeof(*ptr));
+
+  return TypedData_Wrap_Struct(self, &rb_cheap_hdr_data_type, ptr);
+}
+
+static rb_cheap_hdr_t*
+get_context(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+
+  TypedData_Get_Struct(self, rb_cheap_hdr_t, &rb_cheap_hdr_data_type, ptr);
+
+  if (ptr->hdr == NULL) {
+    rb_raise(rb_eRuntimeError, "histogram is not initialized");
+  }
+
+  return ptr;
+}
+
+/**
+ * initialize object
+ *
+ * @param [Numeric] lowest    lowest discernible value (default: 1.0e-3).
+ *                            the values less than it are counted as one
+ *                            bucket.
+ * @param [Numeric] highest   highest trackable value (default: 1.0e+6).
+ *                            the values greater than it are counted in the
+ *                            last bucket.
+ * @param [Integer] digits    significant digits (1 .. 5, default: 3)
+ */
+static VALUE
+rb_cheap_hdr_initialize(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+  VALUE opts;
+  static ID ids[3];
+  VALUE vals[N(ids)];
+  double lowest;
+  double highest;
+  int digits;
+  int err;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_hdr_t, &rb_cheap_hdr_data_type, ptr);
+
+  /*
+   * check argument
+   */
+  rb_scan_args(argc, argv, ":", &opts);
+
+  if (!ids[0]) {
+    ids[0] = rb_intern_const("lowest");
+    ids[1] = rb_intern_const("highest");
+    ids[2] = rb_intern_const("digits");
+  }
+
+  lowest  = CHEAP_HDR_DEFAULT_LOWEST;
+  highest = CHEAP_HDR_DEFAULT_HIGHEST;
+  digits  = CHEAP_HDR_DEFAULT_DIGITS;
+
+  if (!NIL_P(opts)) {
+    rb_get_kwargs(opts, ids, 0, N(ids), vals);
+
+    if (vals[0] != Qundef) lowest  = NUM2DBL(vals[0]);
+    if (vals[1] != Qundef) highest = NUM2DBL(vals[1]);
+    if (vals[2] != Qundef) digits  = NUM2INT(vals[2]);
+  }
+
+  /*
+   * create histogram
+   */
+  if (ptr->hdr == NULL) {
+    err = cheap_hdr_new(lowest, highest, digits, &ptr->hdr);
+    if (err) {
+      ARGUMENT_ERROR("cheap_hdr_new() failed "
+                     "[lowest=%g, highest=%g, digits=%d, err=%d]",
+                     lowest, highest, digits, err);
+    }
+  }
+
+  return self;
+}
+
+/**
+ * record a sample value
+ *
+ * @param [Numeric] v   sample value (non-negative)
+ *
+ * @return [CheapStats::Histogram] self
+ */
+static VALUE
+rb_cheap_hdr_append(VALUE self, VALUE v)
+{
+  rb_cheap_hdr_t* ptr;
+  double x;
+
+  ptr = get_context(self);
+  x   = NUM2DBL(v);
+
+  if (cheap_hdr_record(ptr->hdr, x)) {
+    ARGUMENT_ERROR("invalid sample value (%f)", x);
+  }
+
+  return self;
+}
+
+/**
+ * record sample values
+ *
+ * @param [Array<Numeric>] values   sample values (non-negative)
+ *
+ * @return [CheapStats::Histogram] self
+ */
+static VALUE
+rb_cheap_hdr_push(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+  double* a;
+  VALUE tmp;
+  int t;
+  int i;
+
+  /*
+   * strip context data
+   */
+  ptr = get_context(self);
+
+  /*
+   * check argument (all values are checked before recording)
+   */
+  for (i = 0; i < argc; i++) {
+    t = TYPE(argv[i]);
+
+    if (!IS_NUMERIC(t)) {
+      TYPE_ERROR("the value that not numeric was included (index=%d)", i);
+    }
+  }
+
+  /*
+   * copy source value, and record at once
+   */
+  if (argc > 0) {
+    a = ALLOCV_N(double, tmp, argc);
+
+    for (i = 0; i < argc; i++) {
+      a[i] = NUM2DBL(argv[i]);
+
+      if (!(a[i] >= 0.0)) {
+        ALLOCV_END(tmp);
+        ARGUMENT_ERROR("invalid sample value was included (index=%d)", i);
+      }
+    }
+
+    cheap_hdr_record_many(ptr->hdr, a, argc);
+
+    ALLOCV_END(tmp);
+  }
+
+  return self;
+}
+
+/**
+ * merge the other histogram into this histogram (merging itself doubles
+ * the counts)
+ *
+ * @param [CheapStats::Histogram] other   histogram made with the same
+ *                                        configuration
+ *
+ * @return [CheapStats::Histogram] self
+ */
+static VALUE
+rb_cheap_hdr_merge(VALUE self, VALUE other)
+{
+  rb_cheap_hdr_t* ptr;
+  rb_cheap_hdr_t* src;
+  cheap_hdr_t* copy;
+  VALUE tmp;
+  void* buf;
+  size_t len;
+  int err;
+
+  ptr = get_context(self);
+  src = get_context(other);
+
+  if (ptr->hdr->digits != src->hdr->digits ||
+      ptr->hdr->lowest != src->hdr->lowest ||
+      ptr->hdr->highest != src->hdr->highest) {
+    ARGUMENT_ERROR("configuration is not same (digits=%d, %d)",
+                   ptr->hdr->digits, src->hdr->digits);
+  }
+
+  if (ptr != src) {
+    err = cheap_hdr_merge(ptr->hdr, src->hdr);
+
+  } else {
+    /* the library does not merge into itself, so merge the copy */
+    tmp = 0;
+    err = cheap_hdr_dump(ptr->hdr, NULL, 0, &len);
+
+    if (!err) {
+      buf = ALLOCV(tmp, len);
+      err = cheap_hdr_dump(ptr->hdr, buf, len, &len);
+    }
+
+    if (!err) {
+      err = cheap_hdr_load(buf, len, &copy);
+    }
+
+    if (!err) {
+      err = cheap_hdr_merge(ptr->hdr, copy);
+      cheap_hdr_destroy(copy);
+    }
+
+    ALLOCV_END(tmp);
+  }
+
+  if (err) {
+    RUNTIME_ERROR("cheap_hdr_merge() failed [err=%d]", err);
+  }
+
+  return self;
+}
+
+/**
+ * discard all samples
+ *
+ * @return [CheapStats::Histogram] self
+ */
+static VALUE
+rb_cheap_hdr_clear(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+
+  ptr = get_context(self);
+
+  cheap_hdr_clear(ptr->hdr);
+
+  return self;
+}
+
+/**
+ * get number of samples
+ *
+ * @return [Integer] number of samples
+ */
+static VALUE
+rb_cheap_hdr_count(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+
+  ptr = get_context(self);
+
+  return ULL2NUM(ptr->hdr->n);
+}
+
+/**
+ * get significant digits
+ *
+ * @return [Integer] digits
+ */
+static VALUE
+rb_cheap_hdr_digits(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+
+  ptr = get_context(self);
+
+  return INT2NUM(ptr->hdr->digits);
+}
+
+/**
+ * get total value of samples (exact)
+ *
+ * @return [Float] total value
+ */
+static VALUE
+rb_cheap_hdr_total(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+
+  ptr = get_context(self);
+
+  return DBL2NUM(ptr->hdr->total);
+}
+
+/**
+ * get mean of samples (exact)
+ *
+ * @return [Float] mean (nil if no samples)
+ */
+static VALUE
+rb_cheap_hdr_mean(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+  int err;
+  double ret;
+
+  ptr = get_context(self);
+
+  if (ptr->hdr->n == 0) return Qnil;
+
+  err = cheap_hdr_mean(ptr->hdr, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_hdr_mean() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * get min value of samples (exact)
+ *
+ * @return [Float] min value (nil if no samples)
+ */
+static VALUE
+rb_cheap_hdr_min(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+
+  ptr = get_context(self);
+
+  return (ptr->hdr->n > 0)? DBL2NUM(ptr->hdr->min): Qnil;
+}
+
+/**
+ * get max value of samples (exact)
+ *
+ * @return [Float] max value (nil if no samples)
+ */
+static VALUE
+rb_cheap_hdr_max(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+
+  ptr = get_context(self);
+
+  return (ptr->hdr->n > 0)? DBL2NUM(ptr->hdr->max): Qnil;
+}
+
+/**
+ * calc percentile
+ *
+ * @param [Numeric] pct   percentage (0.0 .. 100.0)
+ *
+ * @return [Float] percentile value (nil if no samples)
+ */
+static VALUE
+rb_cheap_hdr_percentile(VALUE self, VALUE pct)
+{
+  rb_cheap_hdr_t* ptr;
+  int err;
+  double ret;
+  double v;
+
+  ptr = get_context(self);
+  v   = NUM2DBL(pct);
+
+  if (!(v >= 0.0 && v <= 100.0)) {
+    ARGUMENT_ERROR("percentage is out of range (%f)", v);
+  }
+
+  if (ptr->hdr->n == 0) return Qnil;
+
+  err = cheap_hdr_percentile(ptr->hdr, v, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_hdr_percentile() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc approximated CDF
+ *
+ * @param [Numeric] x   taregt value
+ *
+ * @return [Float] fraction of the samples less than the value
+ *                 (nil if no samples)
+ */
+static VALUE
+rb_cheap_hdr_cdf(VALUE self, VALUE x)
+{
+  rb_cheap_hdr_t* ptr;
+  int err;
+  double ret;
+
+  ptr = get_context(self);
+
+  if (ptr->hdr->n == 0) return Qnil;
+
+  err = cheap_hdr_cdf(ptr->hdr, NUM2DBL(x), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_hdr_cdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * serialize the histogram
+ *
+ * @return [String] serialized histogram (binary)
+ */
+static VALUE
+rb_cheap_hdr_dump(VALUE self)
+{
+  rb_cheap_hdr_t* ptr;
+  VALUE ret;
+  size_t len;
+  int err;
+
+  ptr = get_context(self);
+
+  err = cheap_hdr_dump(ptr->hdr, NULL, 0, &len);
+  if (!err) {
+    ret = rb_str_new(NULL, len);
+    err = cheap_hdr_dump(ptr->hdr, RSTRING_PTR(ret), len, &len);
+  }
+
+  if (err) {
+    RUNTIME_ERROR("cheap_hdr_dump() failed [err=%d]", err);
+  }
+
+  return ret;
+}
+
+/**
+ * restore the histogram from the serialized form
+ *
+ * @param [String] str   serialized histogram (by #dump)
+ *
+ * @return [CheapStats::Histogram] restored histogram
+ */
+static VALUE
+rb_cheap_hdr_s_load(VALUE self, VALUE str)
+{
+  rb_cheap_hdr_t* ptr;
+  VALUE ret;
+  int err;
+
+  Check_Type(str, T_STRING);
+
+  ret = rb_obj_alloc(self);
+  TypedData_Get_Struct(ret, rb_cheap_hdr_t, &rb_cheap_hdr_data_type, ptr);
+
+  err = cheap_hdr_load(RSTRING_PTR(str), RSTRING_LEN(str), &ptr->hdr);
+  if (err) {
+    ARGUMENT_ERROR("invalid histogram data [err=%d]", err);
+  }
+
+  RB_GC_GUARD(str);
+
+  return ret;
+}
+
+static VALUE
+rb_cheap_hdr_marshal_dump(VALUE self, VALUE level)
+{
+  return rb_cheap_hdr_dump(self);
+}
+
+void
+rb_cheap_hdr_setup(VALUE outer)
+{
+  hdr_klass = rb_define_class_under(outer, "Histogram", rb_cObject);
+
+  rb_define_alloc_func(hdr_klass, rb_cheap_hdr_alloc);
+
+  rb_define_singleton_method(hdr_klass, "load", rb_cheap_hdr_s_load, 1);
+  rb_define_singleton_method(hdr_klass, "_load", rb_cheap_hdr_s_load, 1);
+
+  rb_define_method(hdr_klass, "initialize", rb_cheap_hdr_initialize, -1);
+  rb_define_method(hdr_klass, "<<", rb_cheap_hdr_append, 1);
+  rb_define_method(hdr_klass, "push", rb_cheap_hdr_push, -1);
+  rb_define_method(hdr_klass, "merge", rb_cheap_hdr_merge, 1);
+  rb_define_method(hdr_klass, "clear", rb_cheap_hdr_clear, 0);
+  rb_define_method(hdr_klass, "count", rb_cheap_hdr_count, 0);
+  rb_define_method(hdr_klass, "digits", rb_cheap_hdr_digits, 0);
+  rb_define_method(hdr_klass, "total", rb_cheap_hdr_total, 0);
+  rb_define_method(hdr_klass, "mean", rb_cheap_hdr_mean, 0);
+  rb_define_method(hdr_klass, "min", rb_cheap_hdr_min, 0);
+  rb_define_method(hdr_klass, "max", rb_cheap_hdr_max, 0);
+  rb_define_method(hdr_klass, "percentile", rb_cheap_hdr_percentile, 1);
+  rb_define_method(hdr_klass, "cdf", rb_cheap_hdr_cdf, 1);
+  rb_define_method(hdr_klass, "dump", rb_cheap_hdr_dump, 0);
+  rb_define_method(hdr_klass, "_dump", rb_cheap_hdr_marshal_dump, 1);
+
+  rb_alias(hdr_klass, rb_intern("average"), rb_intern("mean"));
+}
@@ -0,0 +1,560 @@
+﻿/*
+ * cheap statistics library for ruby (quantile sketch)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ruby.h"
+
+#include "cheap_sketch.h"
+#include "rb_cheap_stats.h"
+
+typedef struct {
+  cheap_sketch_t* sketch;
+} rb_cheap_sketch_t;
+
+typedef int (*getter_t)(cheap_sketch_t*, double*);
+
+static VALUE sketch_klass;
+
+static size_t
+rb_cheap_sketch_size(const void* _ptr)
+{
+  rb_cheap_sketch_t* ptr;
+  size_t ret;
+  int h;
+
+  ptr = (rb_cheap_sketch_t*)_ptr;
+  ret = sizeof(rb_cheap_sketch_t);
+
+  if (ptr->sketch != NULL) {
+    ret += sizeof(cheap_sketch_t);
+
+    for (h = 0; h < CHEAP_SKETCH_MAX_LEVELS; h++) {
+      ret += sizeof(double) * ptr->sketch->cap[h];
+    }
+
+    if (ptr->sketch->vval) {
+      ret += (sizeof(double) + sizeof(uint64_t)) * ptr->sketch->size;
+    }
+  }
+
+  return ret;
+}
+
+static void
+rb_cheap_sketch_free(void* _ptr)
+{
+  rb_cheap_sketch_t* ptr;
+
+  ptr = (rb_cheap_sketch_t*)_ptr;
+
+  if (ptr->sketch != NULL) {
+    cheap_sketch_destroy(ptr->sketch);
+    ptr->sketch = NULL;
+  }
+
+  xfree(ptr);
+}
+
+static const rb_data_type_t rb_cheap_sketch_data_type = {
+  "A Cheap satatics library (sketch)",
+  {
+    NULL,
+    rb_cheap_sketch_free,
+    rb_cheap_sketch_size,
+  },
+  NULL,
+  NULL,
+};
+
+static VALUE
+rb_cheap_sketch_alloc(VALUE self)
+{
+  rb_cheap_sketch_t* ptr;
+
+  ptr = ALLOC(rb_cheap_sketch_t);
+  memset(ptr, 0, sizeof(*ptr));
+
+  return TypedData_Wrap_Struct(self, &rb_cheap_sketch_data_type, ptr);
+}
+
+static rb_cheap_sketch_t*
+get_context(VALUE self)
+{
+  rb_cheap_sketch_t* ptr;
+
+  TypedData_Get_Struct(self, rb_cheap_sketch_t,
+                       &rb_cheap_sketch_data_type, ptr);
+
+  if (ptr->sketch == NULL) {
+    rb_raise(rb_eRuntimeError, "sketch is not initialized");
+  }
+
+  return ptr;
+}
+
+/*
+ * call the query function (nil if the sketch is empty)
+ */
+static VALUE
+get_value(VALUE self, getter_t fn, const char* name)
+{
+  rb_cheap_sketch_t* ptr;
+  int err;
+  double ret;
+
+  ptr = get_context(self);
+
+  if (ptr->sketch->n == 0) return Qnil;
+
+  err = fn(ptr->sketch, &ret);
+  if (err) {
+    RUNTIME_ERROR("%s() failed [err=%d]", name, err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * initialize object
+ *
+ * @param [Integer] k   accuracy parameter (default: 200). the rank error is
+ *                      about 1.7 / k, and the size is about 3k items.
+ */
+static VALUE
+rb_cheap_sketch_initialize(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_sketch_t* ptr;
+  VALUE opts;
+  static ID ids[1];
+  VALUE vals[N(ids)];
+  int k;
+  int err;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_sketch_t,
+                       &rb_cheap_sketch_data_type, ptr);
+
+  /*
+   * check argument
+   */
+  rb_scan_args(argc, argv, ":", &opts);
+
+  if (!ids[0]) {
+    ids[0] = rb_intern_const("k");
+  }
+
+  k = CHEAP_SKETCH_DEFAULT_K;
+
+  if (!NIL_P(opts)) {
+    rb_get_kwargs(opts, ids, 0, N(ids), vals);
+    if (vals[0] != Qundef) k = NUM2INT(vals[0]);
+  }
+
+  /*
+   * create sketch
+   */
+  if (ptr->sketch == NULL) {
+    err = cheap_sketch_new(k, &ptr->sketch);
+    if (err) {
+      ARGUMENT_ERROR("cheap_sketch_new() failed [k=%d, err=%d]", k, err);
+    }
+  }
+
+  return self;
+}
+
+/**
+ * append a sample value
+ *
+ * @param [Numeric] v   sample value
+ *
+ * @return [CheapStats::Sketch] self
+ */
+static VALUE
+rb_cheap_sketch_append(VALUE self, VALUE v)
+{
+  rb_cheap_sketch_t* ptr;
+  int err;
+
+  ptr = get_context(self);
+
+  err = cheap_sketch_push(ptr->sketch, NUM2DBL(v));
+  if (err) {
+    RUNTIME_ERROR("cheap_sketch_push() failed [err=%d]", err);
+  }
+
+  return self;
+}
+
+/**
+ * append sample values
+ *
+ * @param [Array<Numeric>] values   sample values
+ *
+ * @return [CheapStats::Sketch] self
+ */
+static VALUE
+rb_cheap_sketch_push(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_sketch_t* ptr;
+  double* a;
+  VALUE tmp;
+  int err;
+  int t;
+  int i;
+
+  /*
+   * strip context data
+   */
+  ptr = get_context(self);
+
+  /*
+   * check argument
+   */
+  for (i = 0; i < argc; i++) {
+    t = TYPE(argv[i]);
+
+    if (!IS_NUMERIC(t)) {
+      TYPE_ERROR("the value that not numeric was included (index=%d)", i);
+    }
+  }
+
+  /*
+   * copy source value, and push at once
+   */
+  if (argc > 0) {
+    a = ALLOCV_N(double, tmp, argc);
+
+    for (i = 0; i < argc; i++) {
+      a[i] = NUM2DBL(argv[i]);
+    }
+
+    err = cheap_sketch_push_many(ptr->sketch, a, argc);
+
+    ALLOCV_END(tmp);
+
+    if (err) {
+      RUNTIME_ERROR("cheap_sketch_push_many() failed [err=%d]", err);
+    }
+  }
+
+  return self;
+}
+
+/**
+ * merge the other sketch into this sketch (merging itself doubles the
+ * counts)
+ *
+ * @param [CheapStats::Sketch] other   sketch made with the same k
+ *
+ * @return [CheapStats::Sketch] self
+ */
+static VALUE
+rb_cheap_sketch_merge(VALUE self, VALUE other)
+{
+  rb_cheap_sketch_t* ptr;
+  rb_cheap_sketch_t* src;
+  cheap_sketch_t* copy;
+  VALUE tmp;
+  void* buf;
+  size_t len;
+  int err;
+
+  ptr = get_context(self);
+  src = get_context(other);
+
+  if (ptr->sketch->k != src->sketch->k) {
+    ARGUMENT_ERROR("k is not same (%d, %d)", ptr->sketch->k, src->sketch->k);
+  }
+
+  if (ptr != src) {
+    err = cheap_sketch_merge(ptr->sketch, src->sketch);
+
+  } else {
+    /* the library does not merge into itself, so merge the copy */
+    tmp = 0;
+    err = cheap_sketch_dump(ptr->sketch, NULL, 0, &len);
+
+    if (!err) {
+      buf = ALLOCV(tmp, len);
+      err = cheap_sketch_dump(ptr->sketch, buf, len, &len);
+    }
+
+    if (!err) {
+      err = cheap_sketch_load(buf, len, &copy);
+    }
+
+    if (!err) {
+      err = cheap_sketch_merge(ptr->sketch, copy);
+      cheap_sketch_destroy(copy);
+    }
+
+    ALLOCV_END(tmp);
+  }
+
+  if (err) {
+    RUNTIME_ERROR("cheap_sketch_merge() failed [err=%d]", err);
+  }
+
+  return self;
+}
+
+/**
+ * discard all samples
+ *
+ * @return [CheapStats::Sketch] self
+ */
+static VALUE
+rb_cheap_sketch_clear(VALUE self)
+{
+  rb_cheap_sketch_t* ptr;
+
+  ptr = get_context(self);
+
+  cheap_sketch_clear(ptr->sketch);
+
+  return self;
+}
+
+/**
+ * get number of samples
+ *
+ * @return [Integer] number of samples
+ */
+static VALUE
+rb_cheap_sketch_count(VALUE self)
+{
+  rb_cheap_sketch_t* ptr;
+
+  ptr = get_context(self);
+
+  return ULL2NUM(ptr->sketch->n);
+}
+
+/**
+ * get accuracy parameter
+ *
+ * @return [Integer] k
+ */
+static VALUE
+rb_cheap_sketch_k(VALUE self)
+{
+  rb_cheap_sketch_t* ptr;
+
+  ptr = get_context(self);
+
+  return INT2NUM(ptr->sketch->k);
+}
+
+/**
+ * get min value of samples (exact)
+ *
+ * @return [Float] min value (nil if no samples)
+ */
+static VALUE
+rb_cheap_sketch_min(VALUE self)
+{
+  return get_value(self, cheap_sketch_min, "cheap_sketch_min");
+}
+
+/**
+ * get max value of samples (exact)
+ *
+ * @return [Float] max value (nil if no samples)
+ */
+static VALUE
+rb_cheap_sketch_max(VALUE self)
+{
+  return get_value(self, cheap_sketch_max, "cheap_sketch_max");
+}
+
+/**
+ * get approximated 1/4 quartile value of samples
+ *
+ * @return [Float] 1/4 quartile value (nil if no samples)
+ */
+static VALUE
+rb_cheap_sketch_q1(VALUE self)
+{
+  return get_value(self, cheap_sketch_q1, "cheap_sketch_q1");
+}
+
+/**
+ * get approximated 3/4 quartile value of samples
+ *
+ * @return [Float] 3/4 quartile value (nil if no samples)
+ */
+static VALUE
+rb_cheap_sketch_q3(VALUE self)
+{
+  return get_value(self, cheap_sketch_q3, "cheap_sketch_q3");
+}
+
+/**
+ * get approximated median of samples
+ *
+ * @return [Float] median (nil if no samples)
+ */
+static VALUE
+rb_cheap_sketch_median(VALUE self)
+{
+  return get_value(self, cheap_sketch_median, "cheap_sketch_median");
+}
+
+/**
+ * calc approximated quantile
+ *
+ * @param [Numeric] p   probability (0.0 .. 1.0)
+ *
+ * @return [Float] quantile value (nil if no samples)
+ */
+static VALUE
+rb_cheap_sketch_quantile(VALUE self, VALUE p)
+{
+  rb_cheap_sketch_t* ptr;
+  int err;
+  double ret;
+  double v;
+
+  ptr = get_context(self);
+  v   = NUM2DBL(p);
+
+  if (!(v >= 0.0 && v <= 1.0)) {
+    ARGUMENT_ERROR("probability is out of range (%f)", v);
+  }
+
+  if (ptr->sketch->n == 0) return Qnil;
+
+  err = cheap_sketch_quantile(ptr->sketch, v, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_sketch_quantile() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc approximated CDF
+ *
+ * @param [Numeric] x   taregt value
+ *
+ * @return [Float] fraction of the samples less than the value
+ *                 (nil if no samples)
+ */
+static VALUE
+rb_cheap_sketch_cdf(VALUE self, VALUE x)
+{
+  rb_cheap_sketch_t* ptr;
+  int err;
+  double ret;
+
+  ptr = get_context(self);
+
+  if (ptr->sketch->n == 0) return Qnil;
+
+  err = cheap_sketch_cdf(ptr->sketch, NUM2DBL(x), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_sketch_cdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * serialize the sketch
+ *
+ * @return [String] serialized sketch (binary)
+ */
+static VALUE
+rb_cheap_sketch_dump(VALUE self)
+{
+  rb_cheap_sketch_t* ptr;
+  VALUE ret;
+  size_t len;
+  int err;
+
+  ptr = get_context(self);
+
+  err = cheap_sketch_dump(ptr->sketch, NULL, 0, &len);
+  if (!err) {
+    ret = rb_str_new(NULL, len);
+    err = cheap_sketch_dump(ptr->sketch, RSTRING_PTR(ret), len, &len);
+  }
+
+  if (err) {
+    RUNTIME_ERROR("cheap_sketch_dump() failed [err=%d]", err);
+  }
+
+  return ret;
+}
+
+/**
+ * restore the sketch from the serialized form
+ *
+ * @param [String] str   serialized sketch (by #dump)
+ *
+ * @return [CheapStats::Sketch] restored sketch
+ */
+static VALUE
+rb_cheap_sketch_s_load(VALUE self, VALUE str)
+{
+  rb_cheap_sketch_t* ptr;
+  VALUE ret;
+  int err;
+
+  Check_Type(str, T_STRING);
+
+  ret = rb_obj_alloc(self);
+  TypedData_Get_Struct(ret, rb_cheap_sketch_t, &rb_cheap_sketch_data_type, ptr);
+
+  err = cheap_sketch_load(RSTRING_PTR(str), RSTRING_LEN(str), &ptr->sketch);
+  if (err) {
+    ARGUMENT_ERROR("invalid sketch data [err=%d]", err);
+  }
+
+  RB_GC_GUARD(str);
+
+  return ret;
+}
+
+static VALUE
+rb_cheap_sketch_marshal_dump(VALUE self, VALUE level)
+{
+  return rb_cheap_sketch_dump(self);
+}
+
+void
+rb_cheap_sketch_setup(VALUE outer)
+{
+  sketch_klass = rb_define_class_under(outer, "Sketch", rb_cObject);
+
+  rb_define_alloc_func(sketch_klass, rb_cheap_sketch_alloc);
+
+  rb_define_singleton_method(sketch_klass, "load", rb_cheap_sketch_s_load, 1);
+  rb_define_singleton_method(sketch_klass, "_load", rb_cheap_sketch_s_load, 1);
+
+  rb_define_method(sketch_klass, "initialize", rb_cheap_sketch_initialize, -1);
+  rb_define_method(sketch_klass, "<<", rb_cheap_sketch_append, 1);
+  rb_define_method(sketch_klass, "push", rb_cheap_sketch_push, -1);
+  rb_define_method(sketch_klass, "merge", rb_cheap_sketch_merge, 1);
+  rb_define_method(sketch_klass, "clear", rb_cheap_sketch_clear, 0);
+  rb_define_method(sketch_klass, "count", rb_cheap_sketch_count, 0);
+  rb_define_method(sketch_klass, "k", rb_cheap_sketch_k, 0);
+  rb_define_method(sketch_klass, "min", rb_cheap_sketch_min, 0);
+  rb_define_method(sketch_klass, "max", rb_cheap_sketch_max, 0);
+  rb_define_method(sketch_klass, "q1", rb_cheap_sketch_q1, 0);
+  rb_define_method(sketch_klass, "q3", rb_cheap_sketch_q3, 0);
+  rb_define_method(sketch_klass, "median", rb_cheap_sketch_median, 0);
+  rb_define_method(sketch_klass, "quantile", rb_cheap_sketch_quantile, 1);
+  rb_define_method(sketch_klass, "cdf", rb_cheap_sketch_cdf, 1);
+  rb_define_method(sketch_klass, "dump", rb_cheap_sketch_dump, 0);
+  rb_define_method(sketch_klass, "_dump", rb_cheap_sketch_marshal_dump, 1);
+}
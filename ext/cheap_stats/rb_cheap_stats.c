@@ -9,168 +9,1187 @@
 #include <stdint.h>
 #include <string.h>
 #include "ruby.h"
+#include "ruby/thread.h"
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+#include "ruby/memory_view.h"
+#endif
 
 #include "cheap_stats.h"
-
-#define N(x)                      (sizeof(x)/sizeof(*x))
-
-#define RUNTIME_ERROR(msg, ...)   rb_raise(rb_eRuntimeError, (msg), __VA_ARGS__)
-#define ARGUMENT_ERROR(msg, ...)  rb_raise(rb_eArgError, (msg), __VA_ARGS__)
-#define TYPE_ERROR(msg, ...)      rb_raise(rb_eTypeError, (msg), __VA_ARGS__)
-#define NOMEMORY_ERROR(msg, ...)  rb_raise(rb_eNoMemError, (msg), __VA_ARGS__)
+#include "cheap_thread.h"
+#include "rb_cheap_stats.h"
 
 #define API_SIMPLIFIED            1
 #define API_CLASSIC               2
 
 #define EQ_STR(val,str)           (rb_to_id(val) == rb_intern(str))
 #define EQ_INT(val,n)             (FIX2INT(val) == n)
-#define IS_NUMERIC(t) \
-      ((t) == T_FLOAT || (t) ==  T_FIXNUM || (t) == T_BIGNUM)
+
+#define CALL_NEW                  1
+#define CALL_GETTER               2
+#define CALL_UNARY                3
+#define CALL_VECTOR               4
+#define CALL_GRID                 5
+#define CALL_FILE                 6
+#define CALL_MERGE                7
+#define CALL_DUMP                 8
+#define CALL_SAVE                 9
+#define CALL_LOAD                 10
+#define CALL_SNAPSHOT             11
+#define CALL_OUTLIER              12
+
+#define DEFAULT_ALPHA             0.05
 
 typedef struct {
   cheap_stats_t* stats;
+  VALUE lock;
+
+  /*
+   * owner of the samples buffer that is borrowed as a0 (a frozen String
+   * or the exporter of the memory view)
+   */
+  VALUE source;
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+  rb_memory_view_t view;
+  int viewing;
+#endif
 } rb_cheap_stats_t;
 
+typedef int (*getter_t)(cheap_stats_t*, double*);
+typedef int (*unary_t)(cheap_stats_t*, double, double*);
+typedef int (*vector_t)(cheap_stats_t*, double*, size_t, double*);
+typedef int (*outlier_t)(cheap_stats_t*, double, size_t, double*, size_t*);
+
+/*
+ * arguments of the library call that runs without the GVL
+ */
+typedef struct {
+  int kind;
+  cheap_stats_t* stats;
+  cheap_stats_t* other;
+
+  union {
+    getter_t getter;
+    unary_t unary;
+    vector_t vector;
+    outlier_t outlier;
+  } fn;
+
+  double v[2];
+  double* xs;
+  size_t m;
+  double* dst;
+
+  cheap_stats_opts_t* opts;
+  cheap_stats_t** obj;
+  const char* path;
+  int dtype;
+  void* buf;
+  int verify;
+
+  int ret;
+} call_t;
+
+/*
+ * arguments of rb_cheap_call() (passed to the thread without the GVL)
+ */
+typedef struct {
+  rb_cheap_fn_t fn;
+  void* arg;
+
+  volatile int interrupted;
+  int ret;
+} nogvl_call_t;
+
 VALUE klass;
 
+#ifdef CHEAP_PROFILE
+static cheap_profile_t last_profile;
+static int has_last_profile = 0;
+#endif /* defined(CHEAP_PROFILE) */
+
 static size_t
 rb_cheap_stats_size(const void* _ptr)
 {
   rb_cheap_stats_t* ptr;
+  size_t ret;
+
+  ptr = (rb_cheap_stats_t*)_ptr;
+
+  ret = sizeof(*ptr);
+
+  if (ptr->stats != NULL) {
+    ret += sizeof(cheap_stats_t);
+    if (ptr->stats->a0 && !ptr->stats->borrowed) {
+      ret += sizeof(double) * ptr->stats->n;
+    }
+    if (ptr->stats->a1 && ptr->stats->a1 != ptr->stats->a0) {
+      ret += sizeof(double) * ptr->stats->n;
+    }
+  }
+
+  return ret;
+}
+
+static void
+rb_cheap_stats_mark(void* _ptr)
+{
+  rb_cheap_stats_t* ptr;
+
+  ptr = (rb_cheap_stats_t*)_ptr;
+
+  rb_gc_mark(ptr->lock);
+
+  /* not movable, a0 may point into the embedded string */
+  rb_gc_mark(ptr->source);
+}
+
+static void
+release_source(rb_cheap_stats_t* ptr)
+{
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+  if (ptr->viewing) {
+    rb_memory_view_release(&ptr->view);
+    ptr->viewing = 0;
+  }
+#endif
+
+  ptr->source = Qnil;
+}
+
+static void
+rb_cheap_stats_free(void* _ptr)
+{
+  rb_cheap_stats_t* ptr;
+
+  ptr = (rb_cheap_stats_t*)_ptr;
+
+  if (ptr->stats != NULL) {
+    cheap_stats_destroy(ptr->stats);
+    ptr->stats = NULL;
+  }
+
+  release_source(ptr);
+
+  xfree(ptr);
+}
+
+static const struct rb_data_type_struct rb_cheap_stats_data_type = {
+  "A Cheap satatics library",
+  {
+    rb_cheap_stats_mark,
+    rb_cheap_stats_free,
+    rb_cheap_stats_size,
+    {NULL, NULL}
+  },
+  NULL,
+  NULL,
+};
+
+/*
+ * get values from Array<Numeric> or String (packed native doubles)
+ * (the returned buffer is kept by *tmp when it is not the string itself).
+ *
+ * the string is replaced by the frozen one, since the buffer is read
+ * without the GVL (the caller keeps *src by RB_GC_GUARD()).
+ */
+double*
+rb_cheap_get_values(VALUE* _src, size_t* n, volatile VALUE* tmp)
+{
+  double* ret;
+  VALUE src;
+  long len;
+  long i;
+  VALUE v;
+  int t;
+
+  src = *_src;
+
+  switch (TYPE(src)) {
+  case T_ARRAY:
+    len = RARRAY_LEN(src);
+    ret = rb_alloc_tmp_buffer(tmp, sizeof(double) * len);
+
+    for (i = 0; i < len; i++) {
+      v = RARRAY_AREF(src, i);
+      t = TYPE(v);
+
+      if (!IS_NUMERIC(t)) {
+        TYPE_ERROR("the value that not numeric was included (index=%ld)", i);
+      }
+
+      ret[i] = NUM2DBL(v);
+    }
+    break;
+
+  case T_STRING:
+    if (RSTRING_LEN(src) % sizeof(double) != 0) {
+      ARGUMENT_ERROR("length of packed string is not multiple of %d",
+                     (int)sizeof(double));
+    }
+
+    src   = rb_str_new_frozen(src);
+    *_src = src;
+
+    len = RSTRING_LEN(src) / sizeof(double);
+    ret = (double*)RSTRING_PTR(src);
+
+    if (((uintptr_t)ret % sizeof(double)) != 0) {
+      ret = rb_alloc_tmp_buffer(tmp, sizeof(double) * len);
+      memcpy(ret, RSTRING_PTR(src), sizeof(double) * len);
+    }
+    break;
+
+  default:
+    TYPE_ERROR("Array or String is expected (%s)", rb_obj_classname(src));
+  }
+
+  *n = len;
+
+  return ret;
+}
+
+/*
+ * put values into the same type of the source (Array or packed String)
+ */
+static VALUE
+put_values(VALUE src, double* a, size_t n)
+{
+  VALUE ret;
+  size_t i;
+
+  if (TYPE(src) == T_STRING) {
+    ret = rb_str_new((char*)a, sizeof(double) * n);
+
+  } else {
+    ret = rb_ary_new_capa(n);
+    for (i = 0; i < n; i++) rb_ary_push(ret, DBL2NUM(a[i]));
+  }
+
+  return ret;
+}
+
+static VALUE
+rb_cheap_stats_alloc(VALUE self)
+{
+  rb_cheap_stats_t* ptr;
+  VALUE ret;
+
+  ptr = ALLOC(rb_cheap_stats_t);
+  memset(ptr, 0, sizeof(*ptr));
+
+  ptr->lock   = Qnil;
+  ptr->source = Qnil;
+  ret         = TypedData_Wrap_Struct(klass, &rb_cheap_stats_data_type, ptr);
+  ptr->lock   = rb_mutex_new();
+
+  return ret;
+}
+
+static int
+call_invoke(void* _c)
+{
+  call_t* c;
+  int ret;
+
+  c = (call_t*)_c;
+
+  switch (c->kind) {
+  case CALL_NEW:
+    ret = cheap_stats_new_ex(c->xs, c->m, c->opts, c->obj);
+    break;
+
+  case CALL_FILE:
+    ret = cheap_stats_new_mmap(c->path, c->dtype, c->opts, c->obj);
+    break;
+
+  case CALL_MERGE:
+    ret = cheap_stats_merge(c->stats, c->other, c->obj);
+    break;
+
+  case CALL_DUMP:
+    ret = cheap_stats_dump(c->stats, c->buf, c->m, &c->m);
+    break;
+
+  case CALL_SAVE:
+    ret = cheap_stats_save(c->stats, c->path);
+    break;
+
+  case CALL_LOAD:
+    ret = cheap_stats_load(c->buf, c->m, c->opts, c->obj);
+    break;
+
+  case CALL_SNAPSHOT:
+    ret = cheap_stats_load_mmap(c->path, c->verify, c->opts, c->obj);
+    break;
+
+  case CALL_GETTER:
+    ret = c->fn.getter(c->stats, c->dst);
+    break;
+
+  case CALL_UNARY:
+    ret = c->fn.unary(c->stats, c->v[0], c->dst);
+    break;
+
+  case CALL_VECTOR:
+    ret = c->fn.vector(c->stats, c->xs, c->m, c->dst);
+    break;
+
+  case CALL_OUTLIER:
+    ret = c->fn.outlier(c->stats, c->v[0], c->m, c->dst, &c->m);
+    break;
+
+  case CALL_GRID:
+    ret = cheap_stats_estimated_pdf_grid(c->stats,
+                                         c->v[0], c->v[1], c->m, c->dst);
+    break;
+
+  default:
+    ret = __LINE__;
+    break;
+  }
+
+  return ret;
+}
+
+static void*
+call_nogvl(void* _c)
+{
+  nogvl_call_t* c;
+
+  c = (nogvl_call_t*)_c;
+
+  cheap_stats_set_interrupt(&c->interrupted);
+  c->ret = c->fn(c->arg);
+  cheap_stats_set_interrupt(NULL);
+
+  return NULL;
+}
+
+static void
+call_ubf(void* _c)
+{
+  ((nogvl_call_t*)_c)->interrupted = !0;
+}
+
+/*
+ * the interrupted computation leaves the object consistent. process the
+ * pending interrupts (raise, kill, signal handlers etc.) and try again.
+ */
+int
+rb_cheap_call(size_t n, rb_cheap_fn_t fn, void* arg)
+{
+  nogvl_call_t c;
+
+  c.fn  = fn;
+  c.arg = arg;
+
+  while (1) {
+    c.interrupted = 0;
+    c.ret         = CHEAP_STATS_INTERRUPTED;
+
+    if (n < NOGVL_THRESHOLD) {
+      c.ret = fn(arg);
+    } else {
+      rb_thread_call_without_gvl(call_nogvl, &c, call_ubf, &c);
+    }
+
+    if (c.ret != CHEAP_STATS_INTERRUPTED) break;
+
+    rb_thread_check_ints();
+  }
+
+  return c.ret;
+}
+
+static VALUE
+call_body(VALUE _c)
+{
+  call_t* c;
+  size_t n;
+
+  c = (call_t*)_c;
+
+  switch (c->kind) {
+  case CALL_NEW:
+    n = c->m;
+    break;
+
+  case CALL_FILE:
+  case CALL_SNAPSHOT:
+  case CALL_SAVE:
+    /* may block on the file I/O */
+    n = NOGVL_THRESHOLD;
+    break;
+
+  case CALL_LOAD:
+    n = c->m / sizeof(double);
+    break;
+
+  case CALL_MERGE:
+    n = c->stats->n + c->other->n;
+    break;
+
+  case CALL_VECTOR:
+    n = (c->m > c->stats->n)? c->m: c->stats->n;
+    break;
+
+  default:
+    n = c->stats->n;
+    break;
+  }
+
+  c->ret = rb_cheap_call(n, call_invoke, c);
+
+  return Qnil;
+}
+
+/*
+ * call the library function (the lazy computations on the object are
+ * serialized by the lock, since they run without the GVL)
+ */
+static void
+update_source(rb_cheap_stats_t* ptr)
+{
+  /* borrowed a0 was replaced by the sorted copy (lean mode) */
+  if (!NIL_P(ptr->source) && ptr->stats != NULL && !ptr->stats->borrowed) {
+    release_source(ptr);
+  }
+}
+
+#ifdef CHEAP_PROFILE
+/*
+ * keep the profile of the object that was used last (for last_profile)
+ */
+static void
+update_profile(rb_cheap_stats_t* ptr)
+{
+  if (ptr->stats != NULL) {
+    memcpy(&last_profile, &ptr->stats->profile, sizeof(last_profile));
+    has_last_profile = !0;
+  }
+}
+#endif /* defined(CHEAP_PROFILE) */
+
+static int
+call(rb_cheap_stats_t* ptr, call_t* c)
+{
+  rb_mutex_synchronize(ptr->lock, call_body, (VALUE)c);
+  update_source(ptr);
+
+#ifdef CHEAP_PROFILE
+  update_profile(ptr);
+#endif /* defined(CHEAP_PROFILE) */
+
+  return c->ret;
+}
+
+static int
+call_getter(rb_cheap_stats_t* ptr, getter_t fn, double* dst)
+{
+  call_t c;
+
+  memset(&c, 0, sizeof(c));
+
+  c.kind      = CALL_GETTER;
+  c.stats     = ptr->stats;
+  c.fn.getter = fn;
+  c.dst       = dst;
+
+  return call(ptr, &c);
+}
+
+static int
+call_unary(rb_cheap_stats_t* ptr, unary_t fn, double v, double* dst)
+{
+  call_t c;
+
+  memset(&c, 0, sizeof(c));
+
+  c.kind     = CALL_UNARY;
+  c.stats    = ptr->stats;
+  c.fn.unary = fn;
+  c.v[0]     = v;
+  c.dst      = dst;
+
+  return call(ptr, &c);
+}
+
+static int
+call_vector(rb_cheap_stats_t* ptr,
+            vector_t fn, double* xs, size_t m, double* dst)
+{
+  call_t c;
+
+  memset(&c, 0, sizeof(c));
+
+  c.kind      = CALL_VECTOR;
+  c.stats     = ptr->stats;
+  c.fn.vector = fn;
+  c.xs        = xs;
+  c.m         = m;
+  c.dst       = dst;
+
+  return call(ptr, &c);
+}
+
+/*
+ * read keyword options for the constructor
+ */
+static void
+parse_options(VALUE opts, cheap_stats_opts_t* dst)
+{
+  static ID ids[2];
+  VALUE vals[N(ids)];
+  int threads;
+
+  if (!ids[0]) {
+    ids[0] = rb_intern_const("threads");
+    ids[1] = rb_intern_const("keep_order");
+  }
+
+  if (!NIL_P(opts)) {
+    rb_get_kwargs(opts, ids, 0, N(ids), vals);
+
+    if (vals[0] != Qundef && !NIL_P(vals[0])) {
+      threads = NUM2INT(vals[0]);
+
+      if (threads < 1) {
+        ARGUMENT_ERROR("threads must be positive (%d)", threads);
+      }
+
+      dst->threads = (threads < CHEAP_MAX_THREADS)? threads: CHEAP_MAX_THREADS;
+    }
+
+    if (vals[1] != Qundef) {
+      dst->keep_order = RTEST(vals[1]);
+    }
+  }
+}
+
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+/*
+ * check the item format of the memory view (native double only)
+ */
+static int
+is_double_format(const char* fmt)
+{
+  if (fmt == NULL) return 0;
+
+#ifdef WORDS_BIGENDIAN
+  return (!strcmp(fmt, "d") || !strcmp(fmt, "G") || !strcmp(fmt, "d>"));
+#else
+  return (!strcmp(fmt, "d") || !strcmp(fmt, "E") || !strcmp(fmt, "d<"));
+#endif
+}
+#endif
+
+/*
+ * attach the samples buffer to the object. Array is converted into the
+ * buffer that is adopted as a0, String (packed native doubles) is shared
+ * as a frozen string, and the other objects are read through the memory
+ * view. the buffer is kept alive by ptr->source while it is borrowed as a0.
+ */
+static double*
+attach_source(rb_cheap_stats_t* ptr,
+              VALUE src, size_t* n, cheap_stats_opts_t* opts)
+{
+  double* ret;
+  VALUE str;
+  long len;
+  long i;
+  VALUE v;
+  int t;
+
+  switch (TYPE(src)) {
+  case T_ARRAY:
+    len = RARRAY_LEN(src);
+    ret = malloc(sizeof(double) * (len + 1)); // +1 for the empty array
+
+    if (ret == NULL) {
+      NOMEMORY_ERROR("memory allocation failed (%ld samples)", len);
+    }
+
+    for (i = 0; i < len; i++) {
+      v = RARRAY_AREF(src, i);
+      t = TYPE(v);
+
+      if (!IS_NUMERIC(t)) {
+        free(ret);
+        TYPE_ERROR("the value that not numeric was included (index=%ld)", i);
+      }
+
+      ret[i] = NUM2DBL(v);
+    }
+
+    opts->adopt = !0;
+    break;
+
+  case T_STRING:
+    if (RSTRING_LEN(src) % sizeof(double) != 0) {
+      ARGUMENT_ERROR("length of packed string is not multiple of %d",
+                     (int)sizeof(double));
+    }
+
+    str          = rb_str_new_frozen(src);
+    len          = RSTRING_LEN(str) / sizeof(double);
+    ret          = (double*)RSTRING_PTR(str);
+    ptr->source  = str;
+    opts->borrow = ((uintptr_t)ret % sizeof(double)) == 0;
+    break;
+
+  default:
+#ifdef HAVE_RUBY_MEMORY_VIEW_H
+    if (!rb_memory_view_get(src,
+                            &ptr->view, RUBY_MEMORY_VIEW_ANY_CONTIGUOUS)) {
+      TYPE_ERROR("Array, String or MemoryView is expected (%s)",
+                 rb_obj_classname(src));
+    }
+
+    ptr->viewing = !0;
+    ptr->source  = src;
+
+    if (ptr->view.item_size != sizeof(double) ||
+        !is_double_format(ptr->view.format)) {
+      release_source(ptr);
+      TYPE_ERROR("memory view is not an array of double (%s)",
+                 rb_obj_classname(src));
+    }
+
+    len          = ptr->view.byte_size / sizeof(double);
+    ret          = (double*)ptr->view.data;
+    opts->borrow = ((uintptr_t)ret % sizeof(double)) == 0;
+#else /* defined(HAVE_RUBY_MEMORY_VIEW_H) */
+    TYPE_ERROR("Array or String is expected (%s)", rb_obj_classname(src));
+#endif /* defined(HAVE_RUBY_MEMORY_VIEW_H) */
+    break;
+  }
+
+  *n = len;
+
+  return ret;
+}
+
+typedef struct {
+  rb_cheap_stats_t* ptr;
+  call_t* c;
+} locked_call_t;
+
+static VALUE
+locked_call_body(VALUE _l)
+{
+  locked_call_t* l;
+
+  l = (locked_call_t*)_l;
+  call(l->ptr, l->c);
+
+  return Qnil;
+}
+
+/*
+ * the interrupt check in call_body() may raise before the context is
+ * created, so the attached source (and the converted buffer that is not
+ * adopted yet) is released in the ensure clause.
+ */
+static VALUE
+new_ensure(VALUE _l)
+{
+  locked_call_t* l;
+
+  l = (locked_call_t*)_l;
+
+  if (l->ptr->stats == NULL) {
+    release_source(l->ptr);
+    if (l->c->opts->adopt) free(l->c->xs);
+  }
+
+  return Qnil;
+}
+
+/**
+ * initialize object
+ *
+ * @params [Array<Numeric>, String, Object] samples
+ *                                    sample vaules (Array, packed native
+ *                                    doubles or MemoryView of doubles).
+ *                                    String and MemoryView are referred
+ *                                    without copying.
+ * @params [Integer] threads          number of threads used for the sort
+ *                                    and the reductions (default: 1).
+ * @params [Boolean] keep_order       keep the samples in the original order
+ *                                    beside the sorted copy (default: false,
+ *                                    the samples are sorted in place).
+ */
+static VALUE
+rb_cheap_stats_initialize(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_stats_t* ptr;
+  VALUE samples;
+  VALUE opts;
+  cheap_stats_opts_t copts;
+  double *a;
+  size_t n;
+  call_t c;
+  locked_call_t l;
+  int err;
+#ifdef CHEAP_PROFILE
+  double t0;
+#endif /* defined(CHEAP_PROFILE) */
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  if (ptr->stats != NULL) {
+    RUNTIME_ERROR("already initialized (%s)", rb_obj_classname(self));
+  }
+
+  /*
+   * check argument
+   */
+  rb_scan_args(argc, argv, "1:", &samples, &opts);
+
+  memset(&copts, 0, sizeof(copts));
+  parse_options(opts, &copts);
+
+  /*
+   * attach source buffer (borrowed as a0 unless it is misaligned)
+   */
+#ifdef CHEAP_PROFILE
+  t0 = cheap_profile_now();
+#endif /* defined(CHEAP_PROFILE) */
+
+  a = attach_source(ptr, samples, &n, &copts);
+
+#ifdef CHEAP_PROFILE
+  t0 = cheap_profile_now() - t0;
+#endif /* defined(CHEAP_PROFILE) */
+
+  /*
+   * create statistic context
+   */
+  memset(&c, 0, sizeof(c));
+
+  c.kind = CALL_NEW;
+  c.xs   = a;
+  c.m    = n;
+  c.opts = &copts;
+  c.obj  = &ptr->stats;
+
+  l.ptr  = ptr;
+  l.c    = &c;
+
+  rb_ensure(locked_call_body, (VALUE)&l, new_ensure, (VALUE)&l);
+  err = c.ret;
+
+  /*
+   * post porcess 
+   */
+  if (!err && !copts.borrow) {
+    release_source(ptr);
+  }
+
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_new_ex() failed [err=%d]", err); 
+  }
+
+#ifdef CHEAP_PROFILE
+  ptr->stats->profile.time[CHEAP_PROFILE_CONVERT] += t0;
+  ptr->stats->profile.calls[CHEAP_PROFILE_CONVERT]++;
+
+  if (copts.adopt) {
+    /* Array was converted into the adopted buffer */
+    ptr->stats->profile.allocs++;
+    ptr->stats->profile.bytes_copied += sizeof(double) * n;
+  }
+
+  update_profile(ptr);
+#endif /* defined(CHEAP_PROFILE) */
+
+  return self;
+}
+
+/**
+ * create object from the packed native doubles without copying
+ * (the string is shared as frozen, so later changes on it do not affect)
+ *
+ * @params [String] str               packed samples (e.g. Array#pack("d*"))
+ * @params [Integer] threads          number of threads used for the sort
+ *                                    and the reductions (default: 1).
+ *
+ * @return [CheapStats] created object
+ */
+static VALUE
+rb_cheap_stats_s_from_packed(int argc, VALUE* argv, VALUE self)
+{
+  VALUE str;
+  VALUE opts;
+
+  rb_scan_args(argc, argv, "1:", &str, &opts);
+  Check_Type(str, T_STRING);
+
+  return rb_class_new_instance_kw(argc, argv, self, RB_PASS_CALLED_KEYWORDS);
+}
+
+/**
+ * create object from the file of the raw array (native byte order). the
+ * file is mapped read only and the values are not loaded into the Ruby
+ * heap.
+ *
+ * @params [String] path              path of the sample file.
+ * @params [Symbol] dtype             element type (:float64 or :float32,
+ *                                    default: :float64).
+ * @params [Integer] threads          number of threads used for the sort
+ *                                    and the reductions (default: 1).
+ *
+ * @return [CheapStats] created object
+ */
+static VALUE
+rb_cheap_stats_s_from_file(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_stats_t* ptr;
+  VALUE ret;
+  VALUE path;
+  VALUE opts;
+  VALUE dtype;
+  cheap_stats_opts_t copts;
+  call_t c;
+  int err;
+
+  /*
+   * check argument
+   */
+  rb_scan_args(argc, argv, "1:", &path, &opts);
+  FilePathValue(path);
+
+  dtype = Qnil;
+
+  if (!NIL_P(opts)) {
+    opts  = rb_hash_dup(opts);
+    dtype = rb_hash_delete(opts, ID2SYM(rb_intern("dtype")));
+  }
+
+  memset(&c, 0, sizeof(c));
+  memset(&copts, 0, sizeof(copts));
+  parse_options(opts, &copts);
+
+  if (NIL_P(dtype) || EQ_STR(dtype, "float64")) {
+    c.dtype = CHEAP_STATS_FLOAT64;
+
+  } else if (EQ_STR(dtype, "float32")) {
+    c.dtype = CHEAP_STATS_FLOAT32;
+
+  } else {
+    ARGUMENT_ERROR("unknown dtype (%"PRIsVALUE")", dtype);
+  }
+
+  /*
+   * create object
+   */
+  ret = rb_obj_alloc(self);
+  TypedData_Get_Struct(ret, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  c.kind = CALL_FILE;
+  c.path = StringValueCStr(path);
+  c.opts = &copts;
+  c.obj  = &ptr->stats;
+
+  err = call(ptr, &c);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_new_mmap() failed [err=%d]", err);
+  }
+
+  RB_GC_GUARD(path);
+
+  return ret;
+}
+
+/*
+ * merge two objects into the new object (both sources are locked in the
+ * order of the address, so the crossed merges do not deadlock)
+ */
+static VALUE
+merge2(VALUE a, VALUE b)
+{
+  rb_cheap_stats_t* pa;
+  rb_cheap_stats_t* pb;
+  rb_cheap_stats_t* ptr;
+  locked_call_t l;
+  VALUE ret;
+  call_t c;
+
+  TypedData_Get_Struct(a, rb_cheap_stats_t, &rb_cheap_stats_data_type, pa);
+  TypedData_Get_Struct(b, rb_cheap_stats_t, &rb_cheap_stats_data_type, pb);
+
+  ret = rb_obj_alloc(klass);
+  TypedData_Get_Struct(ret, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  memset(&c, 0, sizeof(c));
+
+  c.kind  = CALL_MERGE;
+  c.stats = pa->stats;
+  c.other = pb->stats;
+  c.obj   = &ptr->stats;
+
+  if (pa == pb) {
+    call(pa, &c);
+
+  } else {
+    l.ptr = (pa < pb)? pb: pa;
+    l.c   = &c;
+
+    rb_mutex_synchronize(((pa < pb)? pa: pb)->lock,
+                         locked_call_body, (VALUE)&l);
+    update_source(pa);
+    update_source(pb);
+  }
+
+  if (c.ret) {
+    RUNTIME_ERROR("cheap_stats_merge() failed [err=%d]", c.ret);
+  }
+
+  return ret;
+}
+
+/**
+ * merge the samples of the other objects (e.g. computed on the shards).
+ * the sorted samples are merged in linear time, and the variance and the
+ * central moments of the sources (computed on them if not yet) are combined
+ * without another pass.
+ *
+ * @param [Array<CheapStats>] others   objects to merge
+ *
+ * @return [CheapStats] new object of all samples
+ */
+static VALUE
+rb_cheap_stats_merge(int argc, VALUE* argv, VALUE self)
+{
+  VALUE list;
+  VALUE next;
+  long i;
+
+  /*
+   * check argument
+   */
+  rb_check_arity(argc, 1, UNLIMITED_ARGUMENTS);
+
+  for (i = 0; i < argc; i++) {
+    if (!rb_typeddata_is_kind_of(argv[i], &rb_cheap_stats_data_type)) {
+      TYPE_ERROR("CheapStats is expected (%s)", rb_obj_classname(argv[i]));
+    }
+  }
+
+  /*
+   * merge pairwise like a tournament (each sample is copied log2(argc + 1)
+   * times instead of argc times)
+   */
+  list = rb_ary_new_capa(argc + 1);
+  rb_ary_push(list, self);
+  for (i = 0; i < argc; i++) rb_ary_push(list, argv[i]);
+
+  while (RARRAY_LEN(list) > 1) {
+    next = rb_ary_new_capa((RARRAY_LEN(list) + 1) / 2);
+
+    for (i = 0; i + 1 < RARRAY_LEN(list); i += 2) {
+      rb_ary_push(next, merge2(RARRAY_AREF(list, i), RARRAY_AREF(list, i + 1)));
+    }
+
+    if (i < RARRAY_LEN(list)) {
+      rb_ary_push(next, RARRAY_AREF(list, i));
+    }
+
+    list = next;
+  }
+
+  return RARRAY_AREF(list, 0);
+}
+
+/**
+ * write the snapshot of the object into the file. the snapshot holds the
+ * sorted samples and the computed values (the samples are sorted and the
+ * moments are computed first if not yet), and it is restored by
+ * CheapStats.load without sorting.
+ *
+ * @params [String] path              path of the snapshot file.
+ *
+ * @return [CheapStats] self
+ */
+static VALUE
+rb_cheap_stats_save(VALUE self, VALUE path)
+{
+  rb_cheap_stats_t* ptr;
+  call_t c;
+  int err;
+
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+  FilePathValue(path);
+
+  memset(&c, 0, sizeof(c));
+
+  c.kind  = CALL_SAVE;
+  c.stats = ptr->stats;
+  c.path  = StringValueCStr(path);
+
+  err = call(ptr, &c);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_save() failed [err=%d]", err);
+  }
+
+  RB_GC_GUARD(path);
+
+  return self;
+}
+
+/**
+ * get the snapshot of the object as a string (same format as #save)
+ *
+ * @return [String] snapshot (binary)
+ */
+static VALUE
+rb_cheap_stats_dump(VALUE self)
+{
+  rb_cheap_stats_t* ptr;
+  VALUE ret;
+  size_t len;
+  call_t c;
+  int err;
 
-  ptr = (rb_cheap_stats_t*)_ptr;
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-  return sizeof(*ptr) + ((sizeof(double) * ptr->stats->n) * 2);
-}
+  err = cheap_stats_dump(ptr->stats, NULL, 0, &len);
 
-static void
-rb_cheap_stats_free(void* _ptr)
-{
-  rb_cheap_stats_t* ptr;
+  if (!err) {
+    ret = rb_str_new(NULL, len);
 
-  ptr = (rb_cheap_stats_t*)_ptr;
+    memset(&c, 0, sizeof(c));
 
-  if (ptr->stats != NULL) {
-    cheap_stats_destroy(ptr->stats);
-    ptr->stats = NULL;
+    c.kind  = CALL_DUMP;
+    c.stats = ptr->stats;
+    c.buf   = RSTRING_PTR(ret);
+    c.m     = len;
+
+    err = call(ptr, &c);
   }
 
-  xfree(ptr);
-}
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_dump() failed [err=%d]", err);
+  }
 
-static const struct rb_data_type_struct rb_cheap_stats_data_type = {
-  "A Cheap satatics library",
-  {
-    NULL,
-    rb_cheap_stats_free,
-    rb_cheap_stats_size,
-    {NULL, NULL}
-  },
-  NULL,
-  NULL,
-};
+  return ret;
+}
 
 static VALUE
-rb_cheap_stats_alloc(VALUE self)
+rb_cheap_stats_marshal_dump(VALUE self, VALUE level)
 {
-  rb_cheap_stats_t* ptr;
-
-  ptr = ALLOC(rb_cheap_stats_t);
-  memset(ptr, 0, sizeof(*ptr));
-
-  return TypedData_Wrap_Struct(klass, &rb_cheap_stats_data_type, ptr);
+  return rb_cheap_stats_dump(self);
 }
 
 /**
- * initialize object
+ * restore the object from the snapshot file. the file is mapped read
+ * only and the sorted samples are used in place, so the loading cost does
+ * not depend on the number of samples.
  *
- * @params [Array<Numeric>] samples   sample vaules.
+ * @params [String] path              path of the snapshot file (by #save).
+ * @params [Boolean] verify           verify the checksum of the samples
+ *                                    (reads whole of the file, default:
+ *                                    false. the header is always verified).
+ * @params [Integer] threads          number of threads used for the
+ *                                    reductions (default: 1).
+ *
+ * @return [CheapStats] restored object
  */
 static VALUE
-rb_cheap_stats_initialize(VALUE self, VALUE samples)
+rb_cheap_stats_s_load(int argc, VALUE* argv, VALUE self)
 {
   rb_cheap_stats_t* ptr;
-  VALUE exp;
-  const char* msg;
+  VALUE ret;
+  VALUE path;
+  VALUE opts;
+  VALUE verify;
+  cheap_stats_opts_t copts;
+  call_t c;
   int err;
-  double *a;
-  int i;
-  int n;
-  VALUE v;
-  int t;
-  char str[64];
 
   /*
-   * strip context data
+   * check argument
    */
-  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+  rb_scan_args(argc, argv, "1:", &path, &opts);
+  FilePathValue(path);
+
+  verify = Qfalse;
+
+  if (!NIL_P(opts)) {
+    opts   = rb_hash_dup(opts);
+    verify = rb_hash_delete(opts, ID2SYM(rb_intern("verify")));
+  }
+
+  memset(&c, 0, sizeof(c));
+  memset(&copts, 0, sizeof(copts));
+  parse_options(opts, &copts);
 
   /*
-   * check argument
+   * create object
    */
-  Check_Type(samples, T_ARRAY);
-
-  do {
-    exp = Qnil;
-    a   = NULL;
+  ret = rb_obj_alloc(self);
+  TypedData_Get_Struct(ret, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-    /*
-     * allocate work buffer
-     */
-    n   = RARRAY_LEN(samples);
-    a   = malloc(sizeof(double) * n);
+  c.kind   = CALL_SNAPSHOT;
+  c.path   = StringValueCStr(path);
+  c.verify = RTEST(verify);
+  c.opts   = &copts;
+  c.obj    = &ptr->stats;
 
-    if (a == NULL) {
-      exp = rb_eNoMemError;
-      msg = "Memory allocation failed";
-      break;
-    }
+  err = call(ptr, &c);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_load_mmap() failed [err=%d]", err);
+  }
 
-    /*
-     * copy source value
-     */
-    for (i = 0; i < n; i++) {
-      v = RARRAY_AREF(samples, i);
-      t = TYPE(v);
+  RB_GC_GUARD(path);
 
-      if (!IS_NUMERIC(t)) break;
+  return ret;
+}
 
-      a[i] = NUM2DBL(v);
-    }
+/**
+ * restore the object from the snapshot string (the samples are copied)
+ *
+ * @params [String] str               snapshot (by #dump).
+ *
+ * @return [CheapStats] restored object
+ */
+static VALUE
+rb_cheap_stats_s_from_dump(VALUE self, VALUE str)
+{
+  rb_cheap_stats_t* ptr;
+  VALUE ret;
+  cheap_stats_opts_t copts;
+  call_t c;
+  int err;
 
-    if (i != n) {
-      exp = rb_eTypeError;
-      msg = "the value that not numeric was included";
-    }
+  Check_Type(str, T_STRING);
 
-    /*
-     * create statistic context
-     */
-    err = cheap_stats_new(a, n, &ptr->stats);
-    if (err) {
-      sprintf(str, "cheap_stats_new() failed [err=%d]", err); 
+  /* not changed by the other threads while the GVL is released */
+  str = rb_str_new_frozen(str);
 
-      exp = rb_eRuntimeError;
-      msg = str;
-      break;
-    }
-  } while (0);
+  ret = rb_obj_alloc(self);
+  TypedData_Get_Struct(ret, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-  /*
-   * post porcess 
-   */
-  if (a != NULL) free(a);
+  memset(&c, 0, sizeof(c));
+  memset(&copts, 0, sizeof(copts));
 
-  if (exp != Qnil) {
-    if (ptr->stats != NULL) {
-      cheap_stats_destroy(ptr->stats);
-      ptr->stats = NULL;
-    }
+  c.kind = CALL_LOAD;
+  c.buf  = RSTRING_PTR(str);
+  c.m    = RSTRING_LEN(str);
+  c.opts = &copts;
+  c.obj  = &ptr->stats;
 
-    rb_raise(exp, msg);
+  err = call(ptr, &c);
+  if (err) {
+    ARGUMENT_ERROR("invalid snapshot data [err=%d]", err);
   }
 
-  return self;
+  RB_GC_GUARD(str);
+
+  return ret;
 }
 
 /**
@@ -212,10 +1231,17 @@ static VALUE
 rb_cheap_stats_min(VALUE self)
 {
   rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
 
   TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-  return DBL2NUM(ptr->stats->min);
+  err = call_getter(ptr, cheap_stats_min, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_min() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
 }
 
 /**
@@ -227,10 +1253,17 @@ static VALUE
 rb_cheap_stats_max(VALUE self)
 {
   rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
 
   TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-  return DBL2NUM(ptr->stats->max);
+  err = call_getter(ptr, cheap_stats_max, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_max() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
 }
 
 /**
@@ -242,10 +1275,17 @@ static VALUE
 rb_cheap_stats_q1(VALUE self)
 {
   rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
 
   TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-  return DBL2NUM(ptr->stats->q1);
+  err = call_getter(ptr, cheap_stats_q1, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_q1() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
 }
 
 /**
@@ -257,10 +1297,17 @@ static VALUE
 rb_cheap_stats_q3(VALUE self)
 {
   rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
 
   TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-  return DBL2NUM(ptr->stats->q3);
+  err = call_getter(ptr, cheap_stats_q3, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_q3() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
 }
 
 /**
@@ -272,10 +1319,17 @@ static VALUE
 rb_cheap_stats_median(VALUE self)
 {
   rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
 
   TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-  return DBL2NUM(ptr->stats->median);
+  err = call_getter(ptr, cheap_stats_median, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_median() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
 }
 
 /**
@@ -287,40 +1341,279 @@ static VALUE
 rb_cheap_stats_std(VALUE self)
 {
   rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
+
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  err = call_getter(ptr, cheap_stats_std, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_std() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * get variance of samples
+ *
+ * @return [Float] variance
+ */
+static VALUE
+rb_cheap_stats_variance(VALUE self)
+{
+  rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
+
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  err = call_getter(ptr, cheap_stats_variance, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_variance() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc CDF
+ *
+ * @param [Numeric] x   taregt value
+ *
+ * @return [Float] fraction of the samples less than the value (same as
+ *                 #cdf_many).
+ */
+static VALUE
+rb_cheap_stats_cdf(VALUE self, VALUE x)
+{
+  rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  /*
+   * check argument
+   */
+  err = call_unary(ptr, cheap_stats_cdf, rb_num2dbl(x), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_cdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc CDF for multiple values
+ *
+ * @param [Array<Numeric>, String] xs   target values (Array or packed
+ *                                      native doubles)
+ *
+ * @return [Array<Float>, String] CDF values (same type as the argument)
+ *
+ * @note the result is the fraction of the samples less than each value.
+ */
+static VALUE
+rb_cheap_stats_cdf_many(VALUE self, VALUE xs)
+{
+  rb_cheap_stats_t* ptr;
+  volatile VALUE tmp1;
+  VALUE tmp2;
+  VALUE ret;
+  double* a;
+  double* b;
+  size_t n;
+  int err;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  /*
+   * check argument
+   */
+  tmp1 = 0;
+  a    = rb_cheap_get_values(&xs, &n, &tmp1);
+  b    = ALLOCV_N(double, tmp2, n);
+
+  /*
+   * call CDF function
+   */
+  err = call_vector(ptr, cheap_stats_cdf_many, a, n, b);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_cdf_many() failed [err=%d]", err);
+  }
+
+  ret = put_values(xs, b, n);
+
+  ALLOCV_END(tmp2);
+  if (tmp1) rb_free_tmp_buffer(&tmp1);
+  RB_GC_GUARD(xs);
+
+  return ret;
+}
+
+/**
+ * calc quantile (interpolated linearly between the closest ranks)
+ *
+ * @param [Numeric] p   probability (0.0 .. 1.0)
+ *
+ * @return [Float] quantile value
+ */
+static VALUE
+rb_cheap_stats_quantile(VALUE self, VALUE p)
+{
+  rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
+  double v;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  /*
+   * check argument
+   */
+  v = NUM2DBL(p);
+
+  if (!(v >= 0.0 && v <= 1.0)) {
+    ARGUMENT_ERROR("probability is out of range (%f)", v);
+  }
+
+  /*
+   * call quantile function
+   */
+  err = call_unary(ptr, cheap_stats_quantile, v, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_quantile() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc multiple quantiles at once
+ *
+ * @param [Array<Numeric>] ps   probabilities (0.0 .. 1.0)
+ *
+ * @return [Array<Float>] quantile values
+ */
+static VALUE
+rb_cheap_stats_quantiles(VALUE self, VALUE ps)
+{
+  rb_cheap_stats_t* ptr;
+  VALUE ret;
+  VALUE tmp;
+  double* p;
+  double* q;
+  int err;
+  long n;
+  long i;
 
+  /*
+   * strip context data
+   */
   TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-  return DBL2NUM(ptr->stats->std);
+  /*
+   * check argument
+   */
+  Check_Type(ps, T_ARRAY);
+
+  n   = RARRAY_LEN(ps);
+  ret = rb_ary_new_capa(n);
+
+  if (n > 0) {
+    p = ALLOCV_N(double, tmp, n * 2);
+    q = p + n;
+
+    for (i = 0; i < n; i++) {
+      p[i] = NUM2DBL(RARRAY_AREF(ps, i));
+
+      if (!(p[i] >= 0.0 && p[i] <= 1.0)) {
+        ALLOCV_END(tmp);
+        ARGUMENT_ERROR("probability is out of range (%f)", p[i]);
+      }
+    }
+
+    /*
+     * call quantile function
+     */
+    err = call_vector(ptr, cheap_stats_quantiles, p, n, q);
+    if (err) {
+      ALLOCV_END(tmp);
+      RUNTIME_ERROR("cheap_stats_quantiles() failed [err=%d]", err);
+    }
+
+    for (i = 0; i < n; i++) {
+      rb_ary_push(ret, DBL2NUM(q[i]));
+    }
+
+    ALLOCV_END(tmp);
+  }
+
+  return ret;
 }
 
 /**
- * get variance of samples
+ * calc estimated PDF (by gaussian KDE)
  *
- * @return [Float] variance
+ * @param [Numeric] v   target value
+ *
+ * @return [Float] estimated density
  */
 static VALUE
-rb_cheap_stats_variance(VALUE self)
+rb_cheap_stats_estimated_pdf(VALUE self, VALUE v)
 {
   rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
 
+  /*
+   * strip context data
+   */
   TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
 
-  return DBL2NUM(ptr->stats->variance);
+  /*
+   * call KDE function
+   */
+  err = call_unary(ptr, cheap_stats_estimated_pdf, NUM2DBL(v), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_estimated_pdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
 }
 
 /**
- * calc CDF
+ * calc estimated PDF on the grid (by gaussian KDE)
  *
- * @param [Numeric] x   taregt value
+ * @param [Numeric] lo    start of the grid
+ * @param [Numeric] hi    end of the grid (inclusive)
+ * @param [Integer] m     number of the grid points
  *
- * @return [Float] CDF value that coresspoinding to target.
+ * @return [Array<Float>] estimated densities
  */
 static VALUE
-rb_cheap_stats_cdf(VALUE self, VALUE x)
+rb_cheap_stats_estimated_pdf_grid(VALUE self, VALUE lo, VALUE hi, VALUE m)
 {
   rb_cheap_stats_t* ptr;
+  VALUE ret;
+  VALUE tmp;
+  call_t c;
+  double* a;
+  double l;
+  double h;
+  long n;
+  long i;
   int err;
-  double ret;
 
   /*
    * strip context data
@@ -330,12 +1623,44 @@ rb_cheap_stats_cdf(VALUE self, VALUE x)
   /*
    * check argument
    */
-  err = cheap_stats_cdf(ptr->stats, rb_num2dbl(x), &ret);
+  l = NUM2DBL(lo);
+  h = NUM2DBL(hi);
+  n = NUM2LONG(m);
+
+  if (n <= 0) {
+    ARGUMENT_ERROR("number of grid points is invalid (%ld)", n);
+  }
+
+  if (!(l <= h)) {
+    ARGUMENT_ERROR("range is invalid (%f..%f)", l, h);
+  }
+
+  /*
+   * call KDE function
+   */
+  a   = ALLOCV_N(double, tmp, n);
+
+  memset(&c, 0, sizeof(c));
+
+  c.kind  = CALL_GRID;
+  c.stats = ptr->stats;
+  c.v[0]  = l;
+  c.v[1]  = h;
+  c.m     = n;
+  c.dst   = a;
+
+  err = call(ptr, &c);
   if (err) {
-    RUNTIME_ERROR("cheap_stats_cdf() failed [err=%d]", err);
+    ALLOCV_END(tmp);
+    RUNTIME_ERROR("cheap_stats_estimated_pdf_grid() failed [err=%d]", err);
   }
 
-  return DBL2NUM(ret);
+  ret = rb_ary_new_capa(n);
+  for (i = 0; i < n; i++) rb_ary_push(ret, DBL2NUM(a[i]));
+
+  ALLOCV_END(tmp);
+
+  return ret;
 }
 
 /**
@@ -360,7 +1685,7 @@ rb_cheap_stats_moment(VALUE self, VALUE k)
   /*
    * check argument
    */
-  err = cheap_stats_moment(ptr->stats, rb_num2dbl(k), &ret);
+  err = call_unary(ptr, cheap_stats_moment, rb_num2dbl(k), &ret);
   if (err) {
     RUNTIME_ERROR("cheap_stats_moment() failed [err=%d]", err);
   }
@@ -390,7 +1715,7 @@ rb_cheap_stats_central_moment(VALUE self, VALUE k)
   /*
    * check argument
    */
-  err = cheap_stats_central_moment(ptr->stats, rb_num2dbl(k), &ret);
+  err = call_unary(ptr, cheap_stats_central_moment, rb_num2dbl(k), &ret);
   if (err) {
     RUNTIME_ERROR("cheap_stats_central_moment() failed [err=%d]", err);
   }
@@ -420,7 +1745,7 @@ rb_cheap_stats_std_moment(VALUE self, VALUE k)
   /*
    * check argument
    */
-  err = cheap_stats_std_moment(ptr->stats, rb_num2dbl(k), &ret);
+  err = call_unary(ptr, cheap_stats_std_moment, rb_num2dbl(k), &ret);
   if (err) {
     RUNTIME_ERROR("cheap_stats_std_moment() failed [err=%d]", err);
   }
@@ -448,7 +1773,7 @@ rb_cheap_stats_skewness(VALUE self)
   /*
    * check argument
    */
-  err = cheap_stats_skewness(ptr->stats,  &ret);
+  err = call_getter(ptr, cheap_stats_skewness, &ret);
   if (err) {
     RUNTIME_ERROR("cheap_stats_skewness() failed [err=%d]", err);
   }
@@ -456,6 +1781,62 @@ rb_cheap_stats_skewness(VALUE self)
   return DBL2NUM(ret);
 }
 
+/**
+ * calc kurtosis value
+ *
+ * @return [Float] kurtosis value
+ */
+static VALUE
+rb_cheap_stats_kurtosis(VALUE self)
+{
+  rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  /*
+   * call kurtosis function
+   */
+  err = call_getter(ptr, cheap_stats_kurtosis, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_kurtosis() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc excess kurtosis value
+ *
+ * @return [Float] excess kurtosis value
+ */
+static VALUE
+rb_cheap_stats_excess_kurtosis(VALUE self)
+{
+  rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  /*
+   * call kurtosis function
+   */
+  err = call_getter(ptr, cheap_stats_excess_kurtosis, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_excess_kurtosis() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
 /**
  * calc pearson median skewness value
  *
@@ -476,7 +1857,7 @@ rb_cheap_stats_pearson_skewness(VALUE self)
   /*
    * check argument
    */
-  err = cheap_stats_pearson_skewness(ptr->stats,  &ret);
+  err = call_getter(ptr, cheap_stats_pearson_skewness, &ret);
   if (err) {
     RUNTIME_ERROR("cheap_stats_pearson_skewness() failed [err=%d]", err);
   }
@@ -506,14 +1887,366 @@ rb_cheap_stats_z_score(VALUE self, VALUE v)
   /*
    * check argument
    */
-  err = cheap_stats_z_score(ptr->stats, rb_num2dbl(v), &ret);
+  err = call_unary(ptr, cheap_stats_z_score, rb_num2dbl(v), &ret);
   if (err) {
     RUNTIME_ERROR("cheap_stats_z_score() failed [err=%d]", err);
   }
 
   return DBL2NUM(ret);
 }
+/**
+ * calc PDF of the normal distribution fitted to the samples
+ * (scaled by 1 / total)
+ *
+ * @param [Numeric] v   target value
+ *
+ * @return [Float] PDF value
+ */
+static VALUE
+rb_cheap_stats_normal_pdf(VALUE self, VALUE v)
+{
+  rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
+
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  err = call_unary(ptr, cheap_stats_normal_pdf, rb_num2dbl(v), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_normal_pdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc CDF of the normal distribution fitted to the samples
+ *
+ * @param [Numeric] v   target value
+ *
+ * @return [Float] CDF value
+ */
+static VALUE
+rb_cheap_stats_normal_cdf(VALUE self, VALUE v)
+{
+  rb_cheap_stats_t* ptr;
+  int err;
+  double ret;
+
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  err = call_unary(ptr, cheap_stats_normal_cdf, rb_num2dbl(v), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_normal_cdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/*
+ * evaluate the vector function on the values, and return the results as
+ * packed native doubles (written into the string directly)
+ */
+static VALUE
+call_packed(VALUE self, vector_t fn, const char* name, VALUE xs)
+{
+  rb_cheap_stats_t* ptr;
+  volatile VALUE tmp1;
+  VALUE tmp2;
+  VALUE ret;
+  double* a;
+  double* b;
+  size_t n;
+  int err;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  /*
+   * check argument
+   */
+  tmp1 = 0;
+  tmp2 = 0;
+  a    = rb_cheap_get_values(&xs, &n, &tmp1);
+  ret  = rb_str_new(NULL, sizeof(double) * n);
+  b    = (double*)RSTRING_PTR(ret);
+
+  if (((uintptr_t)b % sizeof(double)) != 0) {
+    b = ALLOCV_N(double, tmp2, n);
+  }
+
+  /*
+   * call vector function
+   */
+  err = call_vector(ptr, fn, a, n, b);
+  if (err) {
+    RUNTIME_ERROR("%s() failed [err=%d]", name, err);
+  }
+
+  if (b != (double*)RSTRING_PTR(ret)) {
+    memcpy(RSTRING_PTR(ret), b, sizeof(double) * n);
+  }
+
+  /*
+   * post process
+   */
+  if (tmp2) ALLOCV_END(tmp2);
+  if (tmp1) rb_free_tmp_buffer(&tmp1);
+  RB_GC_GUARD(xs);
+
+  return ret;
+}
+
+/**
+ * calc Z-scores of the values at once
+ *
+ * @param [Array<Numeric>, String] xs  target values (Array or packed
+ *                                     native doubles)
+ *
+ * @return [String] Z-scores (packed native doubles)
+ */
+static VALUE
+rb_cheap_stats_z_scores(VALUE self, VALUE xs)
+{
+  return call_packed(self, cheap_stats_z_scores, "cheap_stats_z_scores", xs);
+}
+
+/**
+ * calc PDF of the fitted normal distribution on the values at once
+ * (same as normal_pdf for each value)
+ *
+ * @param [Array<Numeric>, String] xs  target values (Array or packed
+ *                                     native doubles)
+ *
+ * @return [String] PDF values (packed native doubles)
+ */
+static VALUE
+rb_cheap_stats_normal_pdf_many(VALUE self, VALUE xs)
+{
+  return call_packed(self, cheap_stats_normal_pdf_many,
+                     "cheap_stats_normal_pdf_many", xs);
+}
+
+/**
+ * calc CDF of the fitted normal distribution on the values at once
+ *
+ * @param [Array<Numeric>, String] xs  target values (Array or packed
+ *                                     native doubles)
+ *
+ * @return [String] CDF values (packed native doubles)
+ */
+static VALUE
+rb_cheap_stats_normal_cdf_many(VALUE self, VALUE xs)
+{
+  return call_packed(self, cheap_stats_normal_cdf_many,
+                     "cheap_stats_normal_cdf_many", xs);
+}
+/*
+ * run the outlier test, and return the outliers as Array<Float>
+ */
+static VALUE
+call_outlier(VALUE self, outlier_t fn, const char* name, VALUE max, VALUE opts)
+{
+  static ID ids[2];
+  VALUE vals[N(ids)];
+  rb_cheap_stats_t* ptr;
+  VALUE ret;
+  VALUE tmp;
+  call_t c;
+  double* a;
+  double alpha;
+  long m;
+  size_t i;
+  int err;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  /*
+   * check argument
+   */
+  if (!ids[0]) {
+    ids[0] = rb_intern_const("alpha");
+    ids[1] = rb_intern_const("max");
+  }
+
+  rb_get_kwargs(opts, ids, 0, N(ids), vals);
+
+  alpha = (vals[0] != Qundef)? NUM2DBL(vals[0]): DEFAULT_ALPHA;
+
+  if (!(alpha > 0.0 && alpha < 1.0)) {
+    ARGUMENT_ERROR("significance level is invalid (%f)", alpha);
+  }
+
+  if (vals[1] != Qundef && !NIL_P(vals[1])) max = vals[1];
+
+  m = NIL_P(max)? (long)ptr->stats->n: NUM2LONG(max);
+
+  if (m < 0) {
+    ARGUMENT_ERROR("maximum number of outliers is invalid (%ld)", m);
+  }
+
+  /* no more outliers than the samples */
+  if ((size_t)m > ptr->stats->n) m = (long)ptr->stats->n;
+
+  /*
+   * call test function
+   */
+  a = ALLOCV_N(double, tmp, (m > 0)? m: 1);
+
+  memset(&c, 0, sizeof(c));
+
+  c.kind       = CALL_OUTLIER;
+  c.stats      = ptr->stats;
+  c.fn.outlier = fn;
+  c.v[0]       = alpha;
+  c.m          = m;
+  c.dst        = a;
+
+  err = call(ptr, &c);
+  if (err) {
+    ALLOCV_END(tmp);
+    RUNTIME_ERROR("%s() failed [err=%d]", name, err);
+  }
+
+  ret = rb_ary_new_capa(c.m);
+  for (i = 0; i < c.m; i++) rb_ary_push(ret, DBL2NUM(a[i]));
+
+  ALLOCV_END(tmp);
+
+  return ret;
+}
+
+/**
+ * detect the outliers by the Smirnov-Grubbs test (repeated until no
+ * outlier is found)
+ *
+ * @overload grubbs_outliers(alpha: 0.05, max: nil)
+ *   @param [Float] alpha       significance level
+ *   @param [Integer] max       maximum number of the outliers (nil means
+ *                              no limit)
+ *
+ * @return [Array<Float>] outliers in the order of the removal
+ */
+static VALUE
+rb_cheap_stats_grubbs_outliers(int argc, VALUE* argv, VALUE self)
+{
+  VALUE opts;
+
+  rb_scan_args(argc, argv, "0:", &opts);
+
+  return call_outlier(self, cheap_stats_grubbs_outliers,
+                      "cheap_stats_grubbs_outliers", Qnil, opts);
+}
+
+/**
+ * detect the outliers by the generalized ESD test
+ *
+ * @overload esd_outliers(max, alpha: 0.05)
+ *   @param [Integer] max       upper bound of the number of the outliers
+ *   @param [Float] alpha       significance level
+ *
+ * @return [Array<Float>] outliers in the order of the removal
+ */
+static VALUE
+rb_cheap_stats_esd_outliers(int argc, VALUE* argv, VALUE self)
+{
+  VALUE max;
+  VALUE opts;
+
+  rb_scan_args(argc, argv, "1:", &max, &opts);
+  Check_Type(max, T_FIXNUM);
+
+  return call_outlier(self, cheap_stats_esd_outliers,
+                      "cheap_stats_esd_outliers", max, opts);
+}
+
+#ifdef CHEAP_PROFILE
+static VALUE
+profile_to_hash(cheap_profile_t* prof)
+{
+  static const char* names[] = {
+    "convert", "copy", "sum", "sort", "select", "search", "variance",
+    "moments", "kde",
+  };
+
+  VALUE ret;
+  VALUE time;
+  VALUE calls;
+  VALUE key;
+  int i;
+
+  ret   = rb_hash_new();
+  time  = rb_hash_new();
+  calls = rb_hash_new();
+
+  for (i = 0; i < CHEAP_PROFILE_PHASES; i++) {
+    key = ID2SYM(rb_intern(names[i]));
+
+    rb_hash_aset(time, key, DBL2NUM(prof->time[i]));
+    rb_hash_aset(calls, key, SIZET2NUM(prof->calls[i]));
+  }
+
+  rb_hash_aset(ret, ID2SYM(rb_intern("time")), time);
+  rb_hash_aset(ret, ID2SYM(rb_intern("calls")), calls);
+  rb_hash_aset(ret, ID2SYM(rb_intern("bytes_copied")),
+               SIZET2NUM(prof->bytes_copied));
+  rb_hash_aset(ret, ID2SYM(rb_intern("allocs")), SIZET2NUM(prof->allocs));
+  rb_hash_aset(ret, ID2SYM(rb_intern("compares")), SIZET2NUM(prof->compares));
+  rb_hash_aset(ret, ID2SYM(rb_intern("swaps")), SIZET2NUM(prof->swaps));
+
+  return ret;
+}
+#endif /* defined(CHEAP_PROFILE) */
+
+/**
+ * get the profile of the object (accumulated since the creation)
+ *
+ * @return [Hash, nil] elapsed seconds and calls of each phase (:time and
+ *                     :calls), and the counters (:bytes_copied, :allocs,
+ *                     :compares and :swaps). nil unless the extension is
+ *                     built with the profiling (--enable-profile).
+ */
+static VALUE
+rb_cheap_stats_profile(VALUE self)
+{
+#ifdef CHEAP_PROFILE
+  rb_cheap_stats_t* ptr;
+  cheap_profile_t prof;
+  int err;
+
+  TypedData_Get_Struct(self, rb_cheap_stats_t, &rb_cheap_stats_data_type, ptr);
+
+  err = cheap_stats_profile(ptr->stats, &prof);
+  if (err) {
+    RUNTIME_ERROR("cheap_stats_profile() failed [err=%d]", err);
+  }
+
+  return profile_to_hash(&prof);
+#else /* defined(CHEAP_PROFILE) */
+  return Qnil;
+#endif /* defined(CHEAP_PROFILE) */
+}
 
+/**
+ * get the profile of the object that was used last
+ *
+ * @return [Hash, nil] same as CheapStats#profile (nil when no object was
+ *                     used yet, or the profiling is not built).
+ */
+static VALUE
+rb_cheap_stats_s_last_profile(VALUE self)
+{
+#ifdef CHEAP_PROFILE
+  return (has_last_profile)? profile_to_hash(&last_profile): Qnil;
+#else /* defined(CHEAP_PROFILE) */
+  return Qnil;
+#endif /* defined(CHEAP_PROFILE) */
+}
 
 void
 Init_cheap_stats()
@@ -522,7 +2255,22 @@ Init_cheap_stats()
 
   rb_define_alloc_func(klass, rb_cheap_stats_alloc);
 
-  rb_define_method(klass, "initialize", rb_cheap_stats_initialize, 1);
+  rb_define_singleton_method(klass, "from_packed",
+                             rb_cheap_stats_s_from_packed, -1);
+  rb_define_singleton_method(klass, "from_file",
+                             rb_cheap_stats_s_from_file, -1);
+  rb_define_singleton_method(klass, "load", rb_cheap_stats_s_load, -1);
+  rb_define_singleton_method(klass, "from_dump",
+                             rb_cheap_stats_s_from_dump, 1);
+  rb_define_singleton_method(klass, "_load", rb_cheap_stats_s_from_dump, 1);
+  rb_define_singleton_method(klass, "last_profile",
+                             rb_cheap_stats_s_last_profile, 0);
+
+  rb_define_method(klass, "initialize", rb_cheap_stats_initialize, -1);
+  rb_define_method(klass, "merge", rb_cheap_stats_merge, -1);
+  rb_define_method(klass, "save", rb_cheap_stats_save, 1);
+  rb_define_method(klass, "dump", rb_cheap_stats_dump, 0);
+  rb_define_method(klass, "_dump", rb_cheap_stats_marshal_dump, 1);
   rb_define_method(klass, "total", rb_cheap_stats_total, 0);
   rb_define_method(klass, "min", rb_cheap_stats_min, 0);
   rb_define_method(klass, "max", rb_cheap_stats_max, 0);
@@ -533,13 +2281,40 @@ Init_cheap_stats()
   rb_define_method(klass, "variance", rb_cheap_stats_variance, 0);
   rb_define_method(klass, "std", rb_cheap_stats_std, 0);
   rb_define_method(klass, "cdf", rb_cheap_stats_cdf, 1);
+  rb_define_method(klass, "cdf_many", rb_cheap_stats_cdf_many, 1);
+  rb_define_method(klass, "quantile", rb_cheap_stats_quantile, 1);
+  rb_define_method(klass, "quantiles", rb_cheap_stats_quantiles, 1);
+  rb_define_method(klass, "estimated_pdf", rb_cheap_stats_estimated_pdf, 1);
+  rb_define_method(klass, "estimated_pdf_grid",
+                   rb_cheap_stats_estimated_pdf_grid, 3);
   rb_define_method(klass, "moment", rb_cheap_stats_moment, 1);
   rb_define_method(klass, "central_moment", rb_cheap_stats_central_moment, 1);
   rb_define_method(klass, "std_moment", rb_cheap_stats_std_moment, 1);
   rb_define_method(klass, "skewness", rb_cheap_stats_skewness, 0);
+  rb_define_method(klass, "kurtosis", rb_cheap_stats_kurtosis, 0);
+  rb_define_method(klass, "excess_kurtosis",
+                   rb_cheap_stats_excess_kurtosis, 0);
   rb_define_method(klass, "pearson_skewness",rb_cheap_stats_pearson_skewness,0);
   rb_define_method(klass, "z_score",rb_cheap_stats_z_score, 1);
+  rb_define_method(klass, "z_scores", rb_cheap_stats_z_scores, 1);
+  rb_define_method(klass, "grubbs_outliers",
+                   rb_cheap_stats_grubbs_outliers, -1);
+  rb_define_method(klass, "esd_outliers", rb_cheap_stats_esd_outliers, -1);
+  rb_define_method(klass, "normal_pdf", rb_cheap_stats_normal_pdf, 1);
+  rb_define_method(klass, "normal_cdf", rb_cheap_stats_normal_cdf, 1);
+  rb_define_method(klass, "normal_pdf_many",
+                   rb_cheap_stats_normal_pdf_many, 1);
+  rb_define_method(klass, "normal_cdf_many",
+                   rb_cheap_stats_normal_cdf_many, 1);
+  rb_define_method(klass, "profile", rb_cheap_stats_profile, 0);
 
   rb_alias(klass, rb_intern("average"), rb_intern("mean"));
   rb_alias(klass, rb_intern("sigma"), rb_intern("std"));
+
+  rb_cheap_stream_setup(klass);
+  rb_cheap_window_setup(klass);
+  rb_cheap_sketch_setup(klass);
+  rb_cheap_hdr_setup(klass);
+  rb_cheap_group_setup(klass);
+  rb_cheap_weighted_setup(klass);
 }
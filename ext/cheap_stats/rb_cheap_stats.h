@@ -0,0 +1,44 @@
+﻿/*
+ * cheap statistics library for ruby (common definitions)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#ifndef __RB_CHEAP_STATS_H__
+#define __RB_CHEAP_STATS_H__
+
+#include "ruby.h"
+
+#define N(x)                      (sizeof(x)/sizeof(*x))
+
+#define RUNTIME_ERROR(msg, ...)   rb_raise(rb_eRuntimeError, (msg), __VA_ARGS__)
+#define ARGUMENT_ERROR(msg, ...)  rb_raise(rb_eArgError, (msg), __VA_ARGS__)
+#define TYPE_ERROR(msg, ...)      rb_raise(rb_eTypeError, (msg), __VA_ARGS__)
+#define NOMEMORY_ERROR(msg, ...)  rb_raise(rb_eNoMemError, (msg), __VA_ARGS__)
+
+#define IS_NUMERIC(t) \
+      ((t) == T_FLOAT || (t) ==  T_FIXNUM || (t) == T_BIGNUM)
+
+/*
+ * the GVL is released while the library computes on the samples larger
+ * than this (smaller ones finish sooner than the GVL hand-off)
+ */
+#define NOGVL_THRESHOLD           65536
+
+/*
+ * library call that is retried after processing the pending interrupts
+ * (run without the GVL when n reaches NOGVL_THRESHOLD)
+ */
+typedef int (*rb_cheap_fn_t)(void* arg);
+
+int rb_cheap_call(size_t n, rb_cheap_fn_t fn, void* arg);
+double* rb_cheap_get_values(VALUE* src, size_t* n, volatile VALUE* tmp);
+
+void rb_cheap_stream_setup(VALUE outer);
+void rb_cheap_window_setup(VALUE outer);
+void rb_cheap_sketch_setup(VALUE outer);
+void rb_cheap_hdr_setup(VALUE outer);
+void rb_cheap_group_setup(VALUE outer);
+void rb_cheap_weighted_setup(VALUE outer);
+
+#endif /* !defined(__RB_CHEAP_STATS_H__) */
@@ -0,0 +1,397 @@
+﻿/*
+ * cheap statistics library for ruby (streaming accumulator)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ruby.h"
+
+#include "cheap_stream.h"
+#include "rb_cheap_stats.h"
+
+typedef struct {
+  cheap_stream_t* stream;
+} rb_cheap_stream_t;
+
+static VALUE stream_klass;
+
+static size_t
+rb_cheap_stream_size(const void* _ptr)
+{
+  return sizeof(rb_cheap_stream_t) + sizeof(cheap_stream_t);
+}
+
+static void
+rb_cheap_stream_free(void* _ptr)
+{
+  rb_cheap_stream_t* ptr;
+
+  ptr = (rb_cheap_stream_t*)_ptr;
+
+  if (ptr->stream != NULL) {
+    cheap_stream_destroy(ptr->stream);
+    ptr->stream = NULL;
+  }
+
+  xfree(ptr);
+}
+
+static const rb_data_type_t rb_cheap_stream_data_type = {
+  "A Cheap satatics library (stream)",
+  {
+    NULL,
+    rb_cheap_stream_free,
+    rb_cheap_stream_size,
+  },
+  NULL,
+  NULL,
+};
+
+static VALUE
+rb_cheap_stream_alloc(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+
+  ptr = ALLOC(rb_cheap_stream_t);
+  memset(ptr, 0, sizeof(*ptr));
+
+  return TypedData_Wrap_Struct(stream_klass, &rb_cheap_stream_data_type, ptr);
+}
+
+static rb_cheap_stream_t*
+get_context(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+
+  TypedData_Get_Struct(self, rb_cheap_stream_t,
+                       &rb_cheap_stream_data_type, ptr);
+
+  if (ptr->stream == NULL) {
+    rb_raise(rb_eRuntimeError, "stream is not initialized");
+  }
+
+  return ptr;
+}
+
+/**
+ * initialize object
+ */
+static VALUE
+rb_cheap_stream_initialize(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+  int err;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_stream_t,
+                       &rb_cheap_stream_data_type, ptr);
+
+  /*
+   * create accumulator
+   */
+  if (ptr->stream == NULL) {
+    err = cheap_stream_new(&ptr->stream);
+    if (err) {
+      RUNTIME_ERROR("cheap_stream_new() failed [err=%d]", err);
+    }
+  }
+
+  return self;
+}
+
+/**
+ * append a sample value
+ *
+ * @param [Numeric] v   sample value
+ *
+ * @return [CheapStats::Stream] self
+ */
+static VALUE
+rb_cheap_stream_append(VALUE self, VALUE v)
+{
+  rb_cheap_stream_t* ptr;
+
+  ptr = get_context(self);
+
+  cheap_stream_push(ptr->stream, NUM2DBL(v));
+
+  return self;
+}
+
+/**
+ * append sample values
+ *
+ * @param [Array<Numeric>] values   sample values
+ *
+ * @return [CheapStats::Stream] self
+ */
+static VALUE
+rb_cheap_stream_push(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+  double* a;
+  VALUE tmp;
+  int t;
+  int i;
+
+  /*
+   * strip context data
+   */
+  ptr = get_context(self);
+
+  /*
+   * check argument
+   */
+  for (i = 0; i < argc; i++) {
+    t = TYPE(argv[i]);
+
+    if (!IS_NUMERIC(t)) {
+      TYPE_ERROR("the value that not numeric was included (index=%d)", i);
+    }
+  }
+
+  /*
+   * copy source value, and push at once
+   */
+  if (argc > 0) {
+    a = ALLOCV_N(double, tmp, argc);
+
+    for (i = 0; i < argc; i++) {
+      a[i] = NUM2DBL(argv[i]);
+    }
+
+    cheap_stream_push_many(ptr->stream, a, argc);
+
+    ALLOCV_END(tmp);
+  }
+
+  return self;
+}
+
+/**
+ * discard all accumulated values
+ *
+ * @return [CheapStats::Stream] self
+ */
+static VALUE
+rb_cheap_stream_clear(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+
+  ptr = get_context(self);
+
+  cheap_stream_clear(ptr->stream);
+
+  return self;
+}
+
+/**
+ * get number of accumulated samples
+ *
+ * @return [Integer] number of samples
+ */
+static VALUE
+rb_cheap_stream_count(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+
+  ptr = get_context(self);
+
+  return SIZET2NUM(ptr->stream->n);
+}
+
+/**
+ * get total value of samples
+ *
+ * @return [Float] total value
+ */
+static VALUE
+rb_cheap_stream_total(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+
+  ptr = get_context(self);
+
+  return DBL2NUM(ptr->stream->total);
+}
+
+/**
+ * get mean of samples
+ *
+ * @return [Float] mean (nil if no samples)
+ */
+static VALUE
+rb_cheap_stream_mean(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+
+  ptr = get_context(self);
+
+  return (ptr->stream->n > 0)? DBL2NUM(ptr->stream->mean): Qnil;
+}
+
+/**
+ * get min value of samples
+ *
+ * @return [Float] min value (nil if no samples)
+ */
+static VALUE
+rb_cheap_stream_min(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+
+  ptr = get_context(self);
+
+  return (ptr->stream->n > 0)? DBL2NUM(ptr->stream->min): Qnil;
+}
+
+/**
+ * get max value of samples
+ *
+ * @return [Float] max value (nil if no samples)
+ */
+static VALUE
+rb_cheap_stream_max(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+
+  ptr = get_context(self);
+
+  return (ptr->stream->n > 0)? DBL2NUM(ptr->stream->max): Qnil;
+}
+
+/**
+ * get variance of samples
+ *
+ * @return [Float] variance (nil if no samples)
+ */
+static VALUE
+rb_cheap_stream_variance(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+  int err;
+  double ret;
+
+  ptr = get_context(self);
+
+  if (ptr->stream->n == 0) return Qnil;
+
+  err = cheap_stream_variance(ptr->stream, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stream_variance() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * get standard division of samples
+ *
+ * @return [Float] standard division (nil if no samples)
+ */
+static VALUE
+rb_cheap_stream_std(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+  int err;
+  double ret;
+
+  ptr = get_context(self);
+
+  if (ptr->stream->n == 0) return Qnil;
+
+  err = cheap_stream_std(ptr->stream, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stream_std() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc central moment
+ *
+ * @param [Integer] k   order number (1..4)
+ *
+ * @return [Float] moment value (nil if no samples)
+ */
+static VALUE
+rb_cheap_stream_central_moment(VALUE self, VALUE k)
+{
+  rb_cheap_stream_t* ptr;
+  int err;
+  int order;
+  double ret;
+
+  ptr   = get_context(self);
+  order = NUM2INT(k);
+
+  if (order < 1 || order > 4) {
+    ARGUMENT_ERROR("order number is out of range (%d)", order);
+  }
+
+  if (ptr->stream->n == 0) return Qnil;
+
+  err = cheap_stream_central_moment(ptr->stream, order, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stream_central_moment() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc skewness value
+ *
+ * @return [Float] skewness value (nil if no samples)
+ */
+static VALUE
+rb_cheap_stream_skewness(VALUE self)
+{
+  rb_cheap_stream_t* ptr;
+  int err;
+  double ret;
+
+  ptr = get_context(self);
+
+  if (ptr->stream->n == 0) return Qnil;
+
+  err = cheap_stream_skewness(ptr->stream, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_stream_skewness() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+void
+rb_cheap_stream_setup(VALUE outer)
+{
+  stream_klass = rb_define_class_under(outer, "Stream", rb_cObject);
+
+  rb_define_alloc_func(stream_klass, rb_cheap_stream_alloc);
+
+  rb_define_method(stream_klass, "initialize", rb_cheap_stream_initialize, 0);
+  rb_define_method(stream_klass, "<<", rb_cheap_stream_append, 1);
+  rb_define_method(stream_klass, "push", rb_cheap_stream_push, -1);
+  rb_define_method(stream_klass, "clear", rb_cheap_stream_clear, 0);
+  rb_define_method(stream_klass, "count", rb_cheap_stream_count, 0);
+  rb_define_method(stream_klass, "total", rb_cheap_stream_total, 0);
+  rb_define_method(stream_klass, "mean", rb_cheap_stream_mean, 0);
+  rb_define_method(stream_klass, "min", rb_cheap_stream_min, 0);
+  rb_define_method(stream_klass, "max", rb_cheap_stream_max, 0);
+  rb_define_method(stream_klass, "variance", rb_cheap_stream_variance, 0);
+  rb_define_method(stream_klass, "std", rb_cheap_stream_std, 0);
+  rb_define_method(stream_klass, "central_moment",
+                   rb_cheap_stream_central_moment, 1);
+  rb_define_method(stream_klass, "skewness", rb_cheap_stream_skewness, 0);
+
+  rb_alias(stream_klass, rb_intern("average"), rb_intern("mean"));
+  rb_alias(stream_klass, rb_intern("sigma"), rb_intern("std"));
+}
@@ -0,0 +1,509 @@
+﻿/*
+ * cheap statistics library for ruby (weighted samples)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "ruby.h"
+
+#include "cheap_stats.h"
+#include "cheap_weighted.h"
+#include "rb_cheap_stats.h"
+
+typedef struct {
+  cheap_weighted_t* wt;
+} rb_cheap_weighted_t;
+
+/*
+ * arguments of the library call that runs without the GVL
+ */
+typedef struct {
+  double* values;
+  double* weights;
+  size_t n;
+  cheap_weighted_t** obj;
+
+} weighted_call_t;
+
+static VALUE weighted_klass;
+
+static size_t
+rb_cheap_weighted_size(const void* _ptr)
+{
+  rb_cheap_weighted_t* ptr;
+  size_t ret;
+
+  ptr = (rb_cheap_weighted_t*)_ptr;
+  ret = sizeof(rb_cheap_weighted_t);
+
+  if (ptr->wt != NULL) {
+    ret += sizeof(cheap_weighted_t);
+    ret += sizeof(double) * 3 * ptr->wt->m;
+  }
+
+  return ret;
+}
+
+static void
+rb_cheap_weighted_free(void* _ptr)
+{
+  rb_cheap_weighted_t* ptr;
+
+  ptr = (rb_cheap_weighted_t*)_ptr;
+
+  if (ptr->wt != NULL) {
+    cheap_weighted_destroy(ptr->wt);
+    ptr->wt = NULL;
+  }
+
+  xfree(ptr);
+}
+
+static const rb_data_type_t rb_cheap_weighted_data_type = {
+  "A Cheap satatics library (weighted)",
+  {
+    NULL,
+    rb_cheap_weighted_free,
+    rb_cheap_weighted_size,
+  },
+  NULL,
+  NULL,
+};
+
+static VALUE
+rb_cheap_weighted_alloc(VALUE self)
+{
+  rb_cheap_weighted_t* ptr;
+
+  ptr = ALLOC(rb_cheap_weighted_t);
+  memset(ptr, 0, sizeof(*ptr));
+
+  return TypedData_Wrap_Struct(self, &rb_cheap_weighted_data_type, ptr);
+}
+
+static cheap_weighted_t*
+get_table(VALUE self)
+{
+  rb_cheap_weighted_t* ptr;
+
+  TypedData_Get_Struct(self, rb_cheap_weighted_t,
+                       &rb_cheap_weighted_data_type, ptr);
+
+  if (ptr->wt == NULL) {
+    rb_raise(rb_eRuntimeError, "weighted samples are not initialized");
+  }
+
+  return ptr->wt;
+}
+
+static int
+weighted_invoke(void* _c)
+{
+  weighted_call_t* c;
+
+  c = (weighted_call_t*)_c;
+
+  return cheap_weighted_new(c->values, c->weights, c->n, c->obj);
+}
+
+/**
+ * initialize object
+ *
+ * @overload initialize(values, weights)
+ *   @param [Array<Numeric>, String] values
+ *                              sample values (Array or packed native
+ *                              doubles). the same value may appear more
+ *                              than once.
+ *   @param [Array<Numeric>, String] weights
+ *                              weight (count) of each value (Array or
+ *                              packed native doubles).
+ *
+ * @overload initialize(hash)
+ *   @param [Hash{Numeric => Numeric}] hash   value to weight (count)
+ */
+static VALUE
+rb_cheap_weighted_initialize(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_weighted_t* ptr;
+  cheap_weighted_t* wt;
+  VALUE values;
+  VALUE weights;
+  volatile VALUE tmp1;
+  volatile VALUE tmp2;
+  weighted_call_t c;
+  size_t nv;
+  size_t nw;
+  size_t i;
+  int err;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_weighted_t,
+                       &rb_cheap_weighted_data_type, ptr);
+
+  /*
+   * check argument
+   */
+  rb_scan_args(argc, argv, "11", &values, &weights);
+
+  if (NIL_P(weights)) {
+    Check_Type(values, T_HASH);
+
+    weights = rb_funcall(values, rb_intern("values"), 0);
+    values  = rb_funcall(values, rb_intern("keys"), 0);
+  }
+
+  tmp1 = 0;
+  tmp2 = 0;
+
+  memset(&c, 0, sizeof(c));
+
+  c.values  = rb_cheap_get_values(&values, &nv, &tmp1);
+  c.weights = rb_cheap_get_values(&weights, &nw, &tmp2);
+  c.n       = nv;
+
+  if (nv != nw) {
+    ARGUMENT_ERROR("number of values and weights are not same (%zu, %zu)",
+                   nv, nw);
+  }
+
+  for (i = 0; i < nw; i++) {
+    if (!(c.weights[i] >= 0.0) || isinf(c.weights[i])) {
+      ARGUMENT_ERROR("weight is invalid (index=%zu)", i);
+    }
+  }
+
+  /*
+   * build run length table
+   */
+  wt    = NULL;
+  c.obj = &wt;
+  err   = rb_cheap_call(c.n, weighted_invoke, &c);
+
+  if (err) {
+    RUNTIME_ERROR("cheap_weighted_new() failed [err=%d]", err);
+  }
+
+  if (ptr->wt != NULL) cheap_weighted_destroy(ptr->wt);
+  ptr->wt = wt;
+
+  /*
+   * post process
+   */
+  rb_free_tmp_buffer(&tmp1);
+  rb_free_tmp_buffer(&tmp2);
+
+  RB_GC_GUARD(values);
+  RB_GC_GUARD(weights);
+
+  return Qnil;
+}
+
+/**
+ * get total weight (number of samples for counts)
+ *
+ * @return [Float] total weight
+ */
+static VALUE
+rb_cheap_weighted_weight(VALUE self)
+{
+  return DBL2NUM(get_table(self)->weight);
+}
+
+/**
+ * get number of distinct values
+ *
+ * @return [Integer] number of distinct values
+ */
+static VALUE
+rb_cheap_weighted_distinct(VALUE self)
+{
+  return SIZET2NUM(get_table(self)->m);
+}
+
+/**
+ * get total value of samples
+ *
+ * @return [Float] total value
+ */
+static VALUE
+rb_cheap_weighted_total(VALUE self)
+{
+  return DBL2NUM(get_table(self)->total);
+}
+
+/**
+ * get mean of samples
+ *
+ * @return [Float] mean
+ */
+static VALUE
+rb_cheap_weighted_mean(VALUE self)
+{
+  return DBL2NUM(get_table(self)->mean);
+}
+
+/**
+ * get min value of samples
+ *
+ * @return [Float] min value
+ */
+static VALUE
+rb_cheap_weighted_min(VALUE self)
+{
+  return DBL2NUM(get_table(self)->min);
+}
+
+/**
+ * get max value of samples
+ *
+ * @return [Float] max value
+ */
+static VALUE
+rb_cheap_weighted_max(VALUE self)
+{
+  return DBL2NUM(get_table(self)->max);
+}
+
+/**
+ * get 1/4 quartile value of samples
+ *
+ * @return [Float] 1/4 quartile value
+ */
+static VALUE
+rb_cheap_weighted_q1(VALUE self)
+{
+  return DBL2NUM(get_table(self)->q1);
+}
+
+/**
+ * get 3/4 quartile value of samples
+ *
+ * @return [Float] 3/4 quartile value
+ */
+static VALUE
+rb_cheap_weighted_q3(VALUE self)
+{
+  return DBL2NUM(get_table(self)->q3);
+}
+
+/**
+ * get median of samples
+ *
+ * @return [Float] median
+ */
+static VALUE
+rb_cheap_weighted_median(VALUE self)
+{
+  return DBL2NUM(get_table(self)->median);
+}
+
+/**
+ * get variance of samples
+ *
+ * @return [Float] variance
+ */
+static VALUE
+rb_cheap_weighted_variance(VALUE self)
+{
+  return DBL2NUM(get_table(self)->variance);
+}
+
+/**
+ * get standard division of samples
+ *
+ * @return [Float] standard division
+ */
+static VALUE
+rb_cheap_weighted_std(VALUE self)
+{
+  return DBL2NUM(get_table(self)->std);
+}
+
+/**
+ * calc quantile (interpolated linearly between the closest ranks)
+ *
+ * @param [Numeric] p   probability (0.0 .. 1.0)
+ *
+ * @return [Float] quantile value
+ */
+static VALUE
+rb_cheap_weighted_quantile(VALUE self, VALUE p)
+{
+  int err;
+  double ret;
+  double v;
+
+  v = NUM2DBL(p);
+
+  if (!(v >= 0.0 && v <= 1.0)) {
+    ARGUMENT_ERROR("probability is out of range (%f)", v);
+  }
+
+  err = cheap_weighted_quantile(get_table(self), v, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_weighted_quantile() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc CDF
+ *
+ * @param [Numeric] x   taregt value
+ *
+ * @return [Float] fraction of the samples less than the value
+ */
+static VALUE
+rb_cheap_weighted_cdf(VALUE self, VALUE x)
+{
+  int err;
+  double ret;
+
+  err = cheap_weighted_cdf(get_table(self), NUM2DBL(x), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_weighted_cdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc estimated PDF (by KDE)
+ *
+ * @param [Numeric] v   target value
+ *
+ * @return [Float] PDF value
+ */
+static VALUE
+rb_cheap_weighted_estimated_pdf(VALUE self, VALUE v)
+{
+  int err;
+  double ret;
+
+  err = cheap_weighted_estimated_pdf(get_table(self), NUM2DBL(v), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_weighted_estimated_pdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc central moment
+ *
+ * @param [Numeric] k   order
+ *
+ * @return [Float] central moment value
+ */
+static VALUE
+rb_cheap_weighted_central_moment(VALUE self, VALUE k)
+{
+  int err;
+  double ret;
+
+  err = cheap_weighted_central_moment(get_table(self), NUM2DBL(k), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_weighted_central_moment() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc standardized moment
+ *
+ * @param [Numeric] k   order
+ *
+ * @return [Float] standardized moment value
+ */
+static VALUE
+rb_cheap_weighted_std_moment(VALUE self, VALUE k)
+{
+  int err;
+  double ret;
+
+  err = cheap_weighted_std_moment(get_table(self), NUM2DBL(k), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_weighted_std_moment() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc skewness
+ *
+ * @return [Float] skewness value
+ */
+static VALUE
+rb_cheap_weighted_skewness(VALUE self)
+{
+  return rb_cheap_weighted_std_moment(self, INT2FIX(3));
+}
+
+/**
+ * calc kurtosis
+ *
+ * @return [Float] kurtosis value
+ */
+static VALUE
+rb_cheap_weighted_kurtosis(VALUE self)
+{
+  return rb_cheap_weighted_std_moment(self, INT2FIX(4));
+}
+
+/**
+ * calc excess kurtosis
+ *
+ * @return [Float] excess kurtosis value
+ */
+static VALUE
+rb_cheap_weighted_excess_kurtosis(VALUE self)
+{
+  return DBL2NUM(NUM2DBL(rb_cheap_weighted_kurtosis(self)) - 3.0);
+}
+
+void
+rb_cheap_weighted_setup(VALUE outer)
+{
+  weighted_klass = rb_define_class_under(outer, "Weighted", rb_cObject);
+
+  rb_define_alloc_func(weighted_klass, rb_cheap_weighted_alloc);
+
+  rb_define_method(weighted_klass, "initialize",
+                   rb_cheap_weighted_initialize, -1);
+  rb_define_method(weighted_klass, "weight", rb_cheap_weighted_weight, 0);
+  rb_define_method(weighted_klass, "distinct", rb_cheap_weighted_distinct, 0);
+  rb_define_method(weighted_klass, "total", rb_cheap_weighted_total, 0);
+  rb_define_method(weighted_klass, "mean", rb_cheap_weighted_mean, 0);
+  rb_define_method(weighted_klass, "min", rb_cheap_weighted_min, 0);
+  rb_define_method(weighted_klass, "max", rb_cheap_weighted_max, 0);
+  rb_define_method(weighted_klass, "q1", rb_cheap_weighted_q1, 0);
+  rb_define_method(weighted_klass, "q3", rb_cheap_weighted_q3, 0);
+  rb_define_method(weighted_klass, "median", rb_cheap_weighted_median, 0);
+  rb_define_method(weighted_klass, "variance", rb_cheap_weighted_variance, 0);
+  rb_define_method(weighted_klass, "std", rb_cheap_weighted_std, 0);
+  rb_define_method(weighted_klass, "quantile", rb_cheap_weighted_quantile, 1);
+  rb_define_method(weighted_klass, "cdf", rb_cheap_weighted_cdf, 1);
+  rb_define_method(weighted_klass, "estimated_pdf",
+                   rb_cheap_weighted_estimated_pdf, 1);
+  rb_define_method(weighted_klass, "central_moment",
+                   rb_cheap_weighted_central_moment, 1);
+  rb_define_method(weighted_klass, "std_moment",
+                   rb_cheap_weighted_std_moment, 1);
+  rb_define_method(weighted_klass, "skewness", rb_cheap_weighted_skewness, 0);
+  rb_define_method(weighted_klass, "kurtosis", rb_cheap_weighted_kurtosis, 0);
+  rb_define_method(weighted_klass, "excess_kurtosis",
+                   rb_cheap_weighted_excess_kurtosis, 0);
+
+  rb_alias(weighted_klass, rb_intern("average"), rb_intern("mean"));
+  rb_alias(weighted_klass, rb_intern("sigma"), rb_intern("std"));
+}
@@ -0,0 +1,445 @@
+﻿/*
+ * cheap statistics library for ruby (sliding window)
+ *
+ *  Copyright (C) 2019 Hiroshi Kuwagata <kgt9221@gmail.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ruby.h"
+
+#include "cheap_window.h"
+#include "rb_cheap_stats.h"
+
+typedef struct {
+  cheap_window_t* window;
+} rb_cheap_window_t;
+
+typedef int (*getter_t)(cheap_window_t*, double*);
+
+static VALUE window_klass;
+
+static size_t
+rb_cheap_window_size(const void* _ptr)
+{
+  rb_cheap_window_t* ptr;
+  size_t ret;
+
+  ptr = (rb_cheap_window_t*)_ptr;
+  ret = sizeof(rb_cheap_window_t);
+
+  if (ptr->window != NULL) {
+    ret += sizeof(cheap_window_t);
+    ret += ptr->window->capacity * (sizeof(double) + (sizeof(int) * 3) +
+                                    sizeof(uint32_t));
+  }
+
+  return ret;
+}
+
+static void
+rb_cheap_window_free(void* _ptr)
+{
+  rb_cheap_window_t* ptr;
+
+  ptr = (rb_cheap_window_t*)_ptr;
+
+  if (ptr->window != NULL) {
+    cheap_window_destroy(ptr->window);
+    ptr->window = NULL;
+  }
+
+  xfree(ptr);
+}
+
+static const rb_data_type_t rb_cheap_window_data_type = {
+  "A Cheap satatics library (window)",
+  {
+    NULL,
+    rb_cheap_window_free,
+    rb_cheap_window_size,
+  },
+  NULL,
+  NULL,
+};
+
+static VALUE
+rb_cheap_window_alloc(VALUE self)
+{
+  rb_cheap_window_t* ptr;
+
+  ptr = ALLOC(rb_cheap_window_t);
+  memset(ptr, 0, sizeof(*ptr));
+
+  return TypedData_Wrap_Struct(window_klass, &rb_cheap_window_data_type, ptr);
+}
+
+static rb_cheap_window_t*
+get_context(VALUE self)
+{
+  rb_cheap_window_t* ptr;
+
+  TypedData_Get_Struct(self, rb_cheap_window_t,
+                       &rb_cheap_window_data_type, ptr);
+
+  if (ptr->window == NULL) {
+    rb_raise(rb_eRuntimeError, "window is not initialized");
+  }
+
+  return ptr;
+}
+
+/*
+ * call the query function (nil if the window is empty)
+ */
+static VALUE
+get_value(VALUE self, getter_t fn, const char* name)
+{
+  rb_cheap_window_t* ptr;
+  int err;
+  double ret;
+
+  ptr = get_context(self);
+
+  if (ptr->window->n == 0) return Qnil;
+
+  err = fn(ptr->window, &ret);
+  if (err) {
+    RUNTIME_ERROR("%s() failed [err=%d]", name, err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * initialize object
+ *
+ * @param [Integer] capacity   number of the latest samples to keep
+ */
+static VALUE
+rb_cheap_window_initialize(VALUE self, VALUE capacity)
+{
+  rb_cheap_window_t* ptr;
+  long n;
+  int err;
+
+  /*
+   * strip context data
+   */
+  TypedData_Get_Struct(self, rb_cheap_window_t,
+                       &rb_cheap_window_data_type, ptr);
+
+  /*
+   * check argument
+   */
+  n = NUM2LONG(capacity);
+
+  if (n <= 0 || n > INT32_MAX) {
+    ARGUMENT_ERROR("capacity is out of range (%ld)", n);
+  }
+
+  /*
+   * create window
+   */
+  if (ptr->window == NULL) {
+    err = cheap_window_new(n, &ptr->window);
+    if (err) {
+      RUNTIME_ERROR("cheap_window_new() failed [err=%d]", err);
+    }
+  }
+
+  return self;
+}
+
+/**
+ * append a sample value (the oldest one is evicted when the window is full)
+ *
+ * @param [Numeric] v   sample value
+ *
+ * @return [CheapStats::Window] self
+ */
+static VALUE
+rb_cheap_window_append(VALUE self, VALUE v)
+{
+  rb_cheap_window_t* ptr;
+
+  ptr = get_context(self);
+
+  cheap_window_push(ptr->window, NUM2DBL(v));
+
+  return self;
+}
+
+/**
+ * append sample values
+ *
+ * @param [Array<Numeric>] values   sample values
+ *
+ * @return [CheapStats::Window] self
+ */
+static VALUE
+rb_cheap_window_push(int argc, VALUE* argv, VALUE self)
+{
+  rb_cheap_window_t* ptr;
+  double* a;
+  VALUE tmp;
+  int t;
+  int i;
+
+  /*
+   * strip context data
+   */
+  ptr = get_context(self);
+
+  /*
+   * check argument
+   */
+  for (i = 0; i < argc; i++) {
+    t = TYPE(argv[i]);
+
+    if (!IS_NUMERIC(t)) {
+      TYPE_ERROR("the value that not numeric was included (index=%d)", i);
+    }
+  }
+
+  /*
+   * copy source value, and push at once
+   */
+  if (argc > 0) {
+    a = ALLOCV_N(double, tmp, argc);
+
+    for (i = 0; i < argc; i++) {
+      a[i] = NUM2DBL(argv[i]);
+    }
+
+    cheap_window_push_many(ptr->window, a, argc);
+
+    ALLOCV_END(tmp);
+  }
+
+  return self;
+}
+
+/**
+ * discard all samples
+ *
+ * @return [CheapStats::Window] self
+ */
+static VALUE
+rb_cheap_window_clear(VALUE self)
+{
+  rb_cheap_window_t* ptr;
+
+  ptr = get_context(self);
+
+  cheap_window_clear(ptr->window);
+
+  return self;
+}
+
+/**
+ * get number of samples in the window
+ *
+ * @return [Integer] number of samples
+ */
+static VALUE
+rb_cheap_window_count(VALUE self)
+{
+  rb_cheap_window_t* ptr;
+
+  ptr = get_context(self);
+
+  return SIZET2NUM(ptr->window->n);
+}
+
+/**
+ * get capacity of the window
+ *
+ * @return [Integer] capacity
+ */
+static VALUE
+rb_cheap_window_capacity(VALUE self)
+{
+  rb_cheap_window_t* ptr;
+
+  ptr = get_context(self);
+
+  return SIZET2NUM(ptr->window->capacity);
+}
+
+/**
+ * get min value of samples
+ *
+ * @return [Float] min value (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_min(VALUE self)
+{
+  return get_value(self, cheap_window_min, "cheap_window_min");
+}
+
+/**
+ * get max value of samples
+ *
+ * @return [Float] max value (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_max(VALUE self)
+{
+  return get_value(self, cheap_window_max, "cheap_window_max");
+}
+
+/**
+ * get 1/4 quartile value of samples
+ *
+ * @return [Float] 1/4 quartile value (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_q1(VALUE self)
+{
+  return get_value(self, cheap_window_q1, "cheap_window_q1");
+}
+
+/**
+ * get 3/4 quartile value of samples
+ *
+ * @return [Float] 3/4 quartile value (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_q3(VALUE self)
+{
+  return get_value(self, cheap_window_q3, "cheap_window_q3");
+}
+
+/**
+ * get median of samples
+ *
+ * @return [Float] median (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_median(VALUE self)
+{
+  return get_value(self, cheap_window_median, "cheap_window_median");
+}
+
+/**
+ * get mean of samples
+ *
+ * @return [Float] mean (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_mean(VALUE self)
+{
+  return get_value(self, cheap_window_mean, "cheap_window_mean");
+}
+
+/**
+ * get variance of samples
+ *
+ * @return [Float] variance (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_variance(VALUE self)
+{
+  return get_value(self, cheap_window_variance, "cheap_window_variance");
+}
+
+/**
+ * get standard division of samples
+ *
+ * @return [Float] standard division (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_std(VALUE self)
+{
+  return get_value(self, cheap_window_std, "cheap_window_std");
+}
+
+/**
+ * calc CDF
+ *
+ * @param [Numeric] x   taregt value
+ *
+ * @return [Float] fraction of the samples less than the value
+ *                 (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_cdf(VALUE self, VALUE x)
+{
+  rb_cheap_window_t* ptr;
+  int err;
+  double ret;
+
+  ptr = get_context(self);
+
+  if (ptr->window->n == 0) return Qnil;
+
+  err = cheap_window_cdf(ptr->window, NUM2DBL(x), &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_window_cdf() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+/**
+ * calc quantile (interpolated linearly between the closest ranks)
+ *
+ * @param [Numeric] p   probability (0.0 .. 1.0)
+ *
+ * @return [Float] quantile value (nil if no samples)
+ */
+static VALUE
+rb_cheap_window_quantile(VALUE self, VALUE p)
+{
+  rb_cheap_window_t* ptr;
+  int err;
+  double ret;
+  double v;
+
+  ptr = get_context(self);
+  v   = NUM2DBL(p);
+
+  if (!(v >= 0.0 && v <= 1.0)) {
+    ARGUMENT_ERROR("probability is out of range (%f)", v);
+  }
+
+  if (ptr->window->n == 0) return Qnil;
+
+  err = cheap_window_quantile(ptr->window, v, &ret);
+  if (err) {
+    RUNTIME_ERROR("cheap_window_quantile() failed [err=%d]", err);
+  }
+
+  return DBL2NUM(ret);
+}
+
+void
+rb_cheap_window_setup(VALUE outer)
+{
+  window_klass = rb_define_class_under(outer, "Window", rb_cObject);
+
+  rb_define_alloc_func(window_klass, rb_cheap_window_alloc);
+
+  rb_define_method(window_klass, "initialize", rb_cheap_window_initialize, 1);
+  rb_define_method(window_klass, "<<", rb_cheap_window_append, 1);
+  rb_define_method(window_klass, "push", rb_cheap_window_push, -1);
+  rb_define_method(window_klass, "clear", rb_cheap_window_clear, 0);
+  rb_define_method(window_klass, "count", rb_cheap_window_count, 0);
+  rb_define_method(window_klass, "capacity", rb_cheap_window_capacity, 0);
+  rb_define_method(window_klass, "min", rb_cheap_window_min, 0);
+  rb_define_method(window_klass, "max", rb_cheap_window_max, 0);
+  rb_define_method(window_klass, "q1", rb_cheap_window_q1, 0);
+  rb_define_method(window_klass, "q3", rb_cheap_window_q3, 0);
+  rb_define_method(window_klass, "median", rb_cheap_window_median, 0);
+  rb_define_method(window_klass, "mean", rb_cheap_window_mean, 0);
+  rb_define_method(window_klass, "variance", rb_cheap_window_variance, 0);
+  rb_define_method(window_klass, "std", rb_cheap_window_std, 0);
+  rb_define_method(window_klass, "cdf", rb_cheap_window_cdf, 1);
+  rb_define_method(window_klass, "quantile", rb_cheap_window_quantile, 1);
+
+  rb_alias(window_klass, rb_intern("average"), rb_intern("mean"));
+  rb_alias(window_klass, rb_intern("sigma"), rb_intern("std"));
+}
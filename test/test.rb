@@ -3,6 +3,8 @@
 
 require 'test/unit'
 require 'cheap_stats'
+require 'objspace'
+require 'tempfile'
 
 class TestCheapStats < Test::Unit::TestCase
   SAMPLES = [7.0, 4.0, 1.0, 5.0, 3.0, 10.0, 6.0, 2.0, 8.0, 9.0]
@@ -62,9 +64,754 @@ class TestCheapStats < Test::Unit::TestCase
       CheapStats.new(SAMPLES)
     }
 
+    # fraction of the samples less than the value
     assert_equal(0.0, stats.cdf(1.0))
-    assert_equal(0.4, stats.cdf(5.5))
+    assert_equal(0.5, stats.cdf(5.5))
     assert_equal(0.9, stats.cdf(10.0))
     assert_equal(1.0, stats.cdf(10.1))
+    assert_equal(0.1, stats.cdf(2.0))
+    assert_equal(0.2, stats.cdf(2.5))
+
+    xs = [0.5, 1.0, 2.0, 2.5, 5.5, 7.5, 10.0, 10.1]
+    assert_equal(stats.cdf_many(xs), xs.map {|x| stats.cdf(x)})
+
+    stats = CheapStats.new([1.0] + [2.0] * 6 + [3.0, 4.0, 5.0])
+    assert_equal(0.1, stats.cdf(2.0))
+    assert_equal(stats.cdf_many([2.0, 2.5, 3.0]), [2.0, 2.5, 3.0].map {|x| stats.cdf(x)})
+  end
+
+  test "cdf_many" do
+    stats = CheapStats.new(SAMPLES)
+    xs    = [0.5, 1.0, 2.5, 10.0, 10.1]
+
+    assert_equal([0.0, 0.0, 0.2, 0.9, 1.0], stats.cdf_many(xs))
+    assert_equal([0.9, 0.0, 1.0, 0.2], stats.cdf_many([10.0, 1.0, 10.1, 2.5]))
+    assert_equal([0.0, 0.0, 0.2, 0.9, 1.0],
+                 stats.cdf_many(xs.pack("d*")).unpack("d*"))
+    assert_raise(TypeError) {stats.cdf_many(["a"])}
+
+    # the caller's string is read through a frozen copy (not frozen itself)
+    packed = xs.pack("d*")
+    assert_equal([0.0, 0.0, 0.2, 0.9, 1.0], stats.cdf_many(packed).unpack("d*"))
+    assert_false(packed.frozen?)
+    packed << [11.0].pack("d")
+    assert_equal(1.0, stats.cdf_many(packed).unpack("d*").last)
+  end
+
+  test "quantile" do
+    stats = CheapStats.new(SAMPLES)
+
+    assert_equal(1.0, stats.quantile(0.0))
+    assert_equal(5.5, stats.quantile(0.5))
+    assert_equal(10.0, stats.quantile(1.0))
+    assert_in_delta(9.91, stats.quantile(0.99), 1e-12)
+    assert_raise(ArgumentError) {stats.quantile(1.5)}
+  end
+
+  test "quantiles" do
+    srand(2)
+    values = Array.new(20000) {rand * 100.0} + [7.0] * 500
+    sorted = values.sort
+    ps     = [0.5, 0.9, 0.99, 0.999, 0.0, 1.0]
+
+    expect = ps.map { |p|
+      h = (values.size - 1) * p
+      l = h.floor
+      (l + 1 < values.size)? sorted[l] + (h - l) * (sorted[l + 1] - sorted[l]):
+                             sorted[l]
+    }
+
+    # selection on unsorted data
+    stats = CheapStats.new(values)
+    stats.quantiles(ps).zip(expect) {|a, b| assert_in_delta(b, a, 1e-9)}
+    assert_equal(sorted[values.size / 2], stats.median)
+
+    # lookup on sorted data
+    stats.quantiles(ps).zip(expect) {|a, b| assert_in_delta(b, a, 1e-9)}
+  end
+
+  test "estimated_pdf" do
+    srand(3)
+    values = Array.new(5000) {rand + rand + rand}
+    stats  = CheapStats.new(values)
+
+    # reference: plain sum over all samples
+    sig = [stats.q3 - stats.q1, stats.std].min
+    h   = (0.9 * sig) / (values.size ** 0.2)
+    pdf = ->(x) {
+      values.sum {|v| Math.exp(-(((x - v) / h) ** 2) / 2.0)} /
+        (Math.sqrt(2.0 * Math::PI) * values.size * h)
+    }
+
+    [0.1, 0.8, 1.5, 2.2, 2.9].each { |x|
+      assert_in_delta(pdf.(x), stats.estimated_pdf(x), 1e-9)
+    }
+
+    grid = stats.estimated_pdf_grid(0.0, 3.0, 31)
+    assert_equal(31, grid.size)
+    grid.each_with_index { |y, i|
+      assert_in_delta(pdf.(i * 0.1), y, 1e-3)
+    }
+
+    grid = stats.estimated_pdf_grid(1.5, 1.5, 3)
+    assert_equal(3, grid.size)
+    grid.each { |y| assert_in_delta(stats.estimated_pdf(1.5), y, 1e-12)}
+
+    grid = stats.estimated_pdf_grid(1.5, 1.5.next_float, 3)
+    grid.each { |y| assert_in_delta(stats.estimated_pdf(1.5), y, 1e-12)}
+  end
+
+  test "moments" do
+    srand(4)
+    values = Array.new(1000) {rand ** 2}
+    stats  = CheapStats.new(values)
+    mean   = values.sum / values.size
+    cm     = ->(k) {values.sum {|v| (v - mean) ** k} / values.size}
+    std    = Math.sqrt(cm.(2))
+
+    (2..8).each {|k| assert_in_delta(cm.(k), stats.central_moment(k), 1e-12)}
+    assert_in_delta(cm.(2), stats.central_moment(2.0), 1e-12)
+    assert_in_delta(cm.(3) / std ** 3, stats.skewness, 1e-9)
+    assert_in_delta(cm.(4) / std ** 4, stats.kurtosis, 1e-9)
+    assert_in_delta(cm.(4) / std ** 4 - 3.0, stats.excess_kurtosis, 1e-9)
+    assert_in_delta(stats.kurtosis, stats.std_moment(4), 1e-12)
+    assert_in_delta(std, stats.std, 1e-12)
+  end
+
+  test "raw moments" do
+    srand(5)
+    values = Array.new(1001) {rand * 4.0 - 1.0}
+    stats  = CheapStats.new(values)
+
+    (1..10).each { |k|
+      expect = values.sum {|v| v ** k} / values.size
+      assert_in_delta(expect, stats.moment(k), expect.abs * 1e-12 + 1e-15)
+    }
+
+    expect = values.sum {|v| v.abs ** 0.5} / values.size
+    assert_in_delta(expect, CheapStats.new(values.map(&:abs)).moment(0.5), 1e-12)
+  end
+
+  test "threads" do
+    srand(6)
+    values = Array.new(1_500_000) {rand * 1000.0 - 200.0}
+    single = CheapStats.new(values)
+    multi  = CheapStats.new(values, threads: 4)
+
+    assert_equal(single.total, multi.total)
+    assert_equal(single.variance, multi.variance)
+    assert_equal(single.kurtosis, multi.kurtosis)
+    assert_equal(single.quantiles([0.1, 0.5, 0.9]), multi.quantiles([0.1, 0.5, 0.9]))
+    assert_equal(single.median, multi.median)
+    assert_equal(single.cdf_many([0.0, 100.0]), multi.cdf_many([0.0, 100.0]))
+
+    # more than CHEAP_MAX_THREADS (capped)
+    many = CheapStats.new(values, threads: 300)
+
+    assert_equal(single.total, many.total)
+    assert_equal(single.variance, many.variance)
+    assert_equal(single.kurtosis, many.kurtosis)
+    assert_equal(single.median, many.median)
+
+    assert_raise(ArgumentError) {CheapStats.new(SAMPLES, threads: 0)}
+  end
+
+  test "interrupted computation is retried" do
+    srand(7)
+    values = Array.new(2_000_000) {rand}
+    stats  = CheapStats.new(values)
+
+    th = Thread.new {stats.median}
+    th.report_on_exception = false
+    sleep 0.01
+    th.raise(RuntimeError, "stop")
+    th.join rescue nil
+
+    assert_equal(values.sort[1_000_000], stats.median)
+
+    # interrupted initialization leaves the object uninitialized
+    obj = CheapStats.allocate
+    th  = Thread.new {obj.send(:initialize, values)}
+    th.report_on_exception = false
+    sleep 0.001
+    th.raise(RuntimeError, "stop")
+    th.join rescue nil
+
+    obj.send(:initialize, values) rescue nil
+    assert_equal(values.sort[1_000_000], obj.median)
+  end
+
+  test "packed samples" do
+    srand(8)
+    values = Array.new(3000) {rand * 10.0}
+    packed = values.pack("d*")
+    stats  = CheapStats.from_packed(packed)
+
+    packed.replace("\0" * 8)
+    GC.start
+
+    assert_equal(CheapStats.new(values).total, stats.total)
+    assert_equal(values.sort[1500], stats.median)
+
+    unaligned = ("\0" + values.pack("d*"))[1..-1]
+    assert_equal(values.sort[1500], CheapStats.new(unaligned).median)
+
+    assert_raise(TypeError) {CheapStats.from_packed(values)}
+    assert_raise(ArgumentError) {CheapStats.from_packed("\0" * 81)}
+    assert_raise(TypeError) {CheapStats.new(Object.new)}
+  end
+
+  test "sample file" do
+    srand(9)
+    values = Array.new(3000) {rand.round(3)}
+
+    Tempfile.create("cheap_stats") { |f|
+      f.binmode
+      f.write(values.pack("d*"))
+      f.flush
+
+      stats = CheapStats.from_file(f.path)
+      assert_equal(CheapStats.new(values).total, stats.total)
+      assert_equal(values.sort[1500], stats.median)
+      assert_raise(ArgumentError) {CheapStats.from_file(f.path, dtype: :int8)}
+    }
+
+    Tempfile.create("cheap_stats") { |f|
+      f.binmode
+      f.write(values.pack("f*"))
+      f.flush
+
+      stats = CheapStats.from_file(f.path, dtype: :float32, threads: 2)
+      assert_equal(values.pack("f*").unpack("f*").sort[1500], stats.median)
+    }
+
+    assert_raise(RuntimeError) {CheapStats.from_file("/nonexistent/file")}
+  end
+
+  test "cached reductions do not depend on the call order" do
+    srand(26)
+    values = Array.new(100_000) {rand * 100.0 - 30.0}
+    keys   = %i[variance std skewness kurtosis]
+    get    = ->(s) {keys.map {|k| s.send(k)}}
+
+    # original order (the variance and cm[2] are the same sum)
+    expect = get.(CheapStats.new(values))
+    assert_equal(expect.reverse, keys.reverse.map {|k| CheapStats.new(values).send(k)})
+    assert_equal(expect, get.(CheapStats.new(values, keep_order: true).tap(&:median)))
+    assert_equal(expect, get.(CheapStats.new(values, threads: 4)))
+
+    # sorted order, whatever quantiles were asked before
+    sorted = get.(CheapStats.new(values).tap {|s| s.cdf(0.0)})
+    [
+      CheapStats.new(values).tap {|s| s.quantile(0.3)},
+      CheapStats.new(values, threads: 4).tap {|s| s.median; s.q3},
+      CheapStats.from_packed(values.pack("d*")).tap(&:q1),
+    ].each { |stats|
+      assert_equal(sorted, get.(stats))
+    }
+  end
+
+  test "sorted array is built on demand" do
+    stats = CheapStats.new(SAMPLES, keep_order: true)
+    size0 = ObjectSpace.memsize_of(stats)
+
+    assert_equal(5.5, stats.mean)
+    assert_equal(size0, ObjectSpace.memsize_of(stats))
+
+    assert_equal(6.0, stats.median)
+    assert_operator(ObjectSpace.memsize_of(stats), :>, size0)
+  end
+
+  test "samples are sorted in place by default" do
+    stats = CheapStats.new(SAMPLES)
+    size0 = ObjectSpace.memsize_of(stats)
+
+    assert_equal(6.0, stats.median)
+    assert_equal(8.25, stats.variance)
+    assert_equal(size0, ObjectSpace.memsize_of(stats))
+
+    packed = CheapStats.from_packed(SAMPLES.pack("d*"))
+    assert_equal(6.0, packed.median)
+    assert_operator(ObjectSpace.memsize_of(packed), :>=, size0)
+  end
+
+  test "large samples" do
+    srand(1)
+    values = Array.new(5000) {(rand - 0.5) * 1e6} + [-0.0, 0.0, -1e300]
+    sorted = values.sort
+    n      = values.size
+
+    stats = CheapStats.new(values)
+
+    assert_equal(sorted[0], stats.min)
+    assert_equal(sorted[-1], stats.max)
+    assert_equal(sorted[n / 4], stats.q1)
+    assert_equal(sorted[n / 2], stats.median)
+    assert_equal(sorted[(3 * n) / 4], stats.q3)
+  end
+
+  test "NaN is sorted to the tail" do
+    values = Array.new(2000) {|i| i - 1000.0} + [Float::NAN]
+    stats  = CheapStats.new(values)
+
+    assert_equal(-1000.0, stats.min)
+    assert_true(stats.max.nan?)
+  end
+
+  test "merge" do
+    srand(14)
+    shards = Array.new(5) {Array.new(3000) {rand * 100.0 + _1}}
+    values = shards.flatten
+    sorted = values.sort
+    whole  = CheapStats.new(values)
+
+    parts  = shards.map {|a| CheapStats.new(a)}
+    parts[0].kurtosis
+    parts[1].variance
+
+    merged = parts[0].merge(*parts[1..])
+    assert_in_delta(values.sum, merged.total, 1.0e-6)
+    assert_equal(sorted[0], merged.min)
+    assert_equal(sorted[values.size / 2], merged.median)
+    assert_equal(sorted[(3 * values.size) / 4], merged.q3)
+    assert_in_delta(whole.mean, merged.mean, 1.0e-9)
+    assert_in_delta(whole.variance, merged.variance, 1.0e-8)
+    assert_in_delta(whole.skewness, merged.skewness, 1.0e-9)
+    assert_in_delta(whole.kurtosis, merged.kurtosis, 1.0e-9)
+
+    # the moments do not depend on what was computed on the sources
+    other = shards.map {|a| CheapStats.new(a)}
+    other = other[0].merge(*other[1..])
+    assert_equal(merged.variance, other.variance)
+    assert_equal(merged.skewness, other.skewness)
+    assert_equal(merged.kurtosis, other.kurtosis)
+
+    merged = CheapStats.new(shards[0]).merge(CheapStats.new(shards[1] + [Float::NAN]))
+    assert_true(merged.max.nan?)
+    assert_raise(TypeError) {merged.merge(values)}
+  end
+
+  test "snapshot" do
+    srand(15)
+    values = Array.new(5000) {rand}
+    stats  = CheapStats.new(values, keep_order: true)
+
+    Tempfile.create("snapshot") { |f|
+      stats.save(f.path)
+
+      loaded = CheapStats.load(f.path, verify: true)
+      assert_equal(stats.median, loaded.median)
+      assert_equal(stats.quantile(0.9), loaded.quantile(0.9))
+      assert_equal(stats.kurtosis, loaded.kurtosis)
+      assert_equal(stats.cdf(0.5), loaded.cdf(0.5))
+      assert_equal(stats.dump, loaded.dump)
+
+      loaded = CheapStats.load(f.path, threads: 300)
+      assert_equal(stats.quantile(0.9), loaded.quantile(0.9))
+      assert_equal(stats.cdf_many(values), loaded.cdf_many(values))
+
+      data = File.binread(f.path)
+      data[-1] = (data[-1].ord ^ 1).chr
+      File.binwrite(f.path, data)
+
+      assert_nothing_raised {CheapStats.load(f.path)}
+      assert_raise(RuntimeError) {CheapStats.load(f.path, verify: true)}
+    }
+
+    loaded = Marshal.load(Marshal.dump(stats))
+    assert_equal(stats.variance, loaded.variance)
+    assert_equal(stats.q3, loaded.q3)
+    assert_raise(ArgumentError) {CheapStats.from_dump("broken")}
+  end
+
+  test "profile" do
+    stats = CheapStats.new(Array.new(1000) {rand})
+    stats.median
+    stats.cdf_many([0.25, 0.5])
+
+    prof = stats.profile
+
+    if prof
+      assert_equal(1, prof[:calls][:sort])
+      assert_equal(1, prof[:calls][:search])
+      assert_equal(0, prof[:calls][:variance])
+      assert_equal(8000, prof[:bytes_copied])
+      assert_operator(prof[:compares], :>, 0)
+      assert_operator(prof[:time][:sort], :>=, 0.0)
+      assert_equal(prof, CheapStats.last_profile)
+    else
+      # built without the profiling
+      assert_nil(CheapStats.last_profile)
+    end
+  end
+
+  test "batch z-scores and normal distribution" do
+    srand(23)
+    stats = CheapStats.new(Array.new(10000) {rand * 100.0})
+    xs    = Array.new(1003) {rand * 140.0 - 20.0} + [stats.mean]
+
+    zs  = stats.z_scores(xs).unpack("d*")
+    pdf = stats.normal_pdf_many(xs.pack("d*")).unpack("d*")
+    cdf = stats.normal_cdf_many(xs).unpack("d*")
+
+    assert_equal(xs.size, zs.size)
+
+    xs.each_with_index { |x, i|
+      assert_in_delta(stats.z_score(x), zs[i], 1.0e-12)
+      assert_in_delta(stats.normal_pdf(x), pdf[i], 1.0e-15)
+      assert_in_delta(0.5 * Math.erfc(-zs[i] / Math.sqrt(2.0)), cdf[i], 1.0e-13)
+    }
+
+    assert_in_delta(0.5, cdf[-1], 1.0e-15)
+    assert_equal("", stats.z_scores([]))
+    assert_true(stats.normal_cdf_many([Float::NAN]).unpack1("d").nan?)
+
+    # more threads than CHEAP_MAX_THREADS (every range must be computed)
+    xs   = Array.new(1_000_000) {rand * 100.0 + 1000.0}
+    many = CheapStats.new(Array.new(10000) {rand * 100.0}, threads: 300)
+    zs   = many.z_scores(xs.pack("d*")).unpack("d*")
+    err  = xs.each_with_index.map {|x, i| (many.z_score(x) - zs[i]).abs}.max
+
+    assert_operator(err, :<=, 1.0e-12)
+  end
+
+  test "outlier tests" do
+    # example of Rosner (1983), 3 outliers by the generalized ESD test
+    data = [
+      -0.25, 0.68, 0.94, 1.15, 1.20, 1.26, 1.26, 1.34, 1.38, 1.43, 1.49,
+      1.49, 1.55, 1.56, 1.58, 1.65, 1.69, 1.70, 1.76, 1.77, 1.81, 1.91,
+      1.94, 1.96, 1.99, 2.06, 2.09, 2.10, 2.14, 2.15, 2.23, 2.24, 2.26,
+      2.35, 2.37, 2.40, 2.47, 2.54, 2.62, 2.64, 2.90, 2.92, 2.92, 2.93,
+      3.21, 3.26, 3.30, 3.59, 3.68, 4.30, 4.64, 5.34, 5.42, 6.01
+    ]
+    stats = CheapStats.new(data)
+
+    assert_equal([6.01, 5.42, 5.34], stats.esd_outliers(10))
+    assert_equal([6.01, 5.42, 5.34], stats.esd_outliers(10, alpha: 0.05))
+    assert_equal([6.01], stats.esd_outliers(1, alpha: 0.2))
+    assert_equal([], stats.grubbs_outliers)   # masked by the others
+
+    srand(24)
+    data  = Array.new(10000) {rand}
+    data += [1.0e9, -1.0e6, 25.0]
+    stats = CheapStats.new(data.shuffle)
+
+    assert_equal([1.0e9, -1.0e6, 25.0], stats.grubbs_outliers)
+    assert_equal([1.0e9, -1.0e6], stats.grubbs_outliers(max: 2))
+    assert_equal([1.0e9, -1.0e6, 25.0], stats.grubbs_outliers(max: 1 << 40))
+    assert_equal([1.0e9, -1.0e6, 25.0], stats.esd_outliers(1 << 40))
+    assert_equal(1.0e9, stats.max)
+    assert_raise(ArgumentError) {stats.grubbs_outliers(alpha: 1.5)}
+  end
+
+  test "weighted samples" do
+    srand(25)
+    values  = Array.new(500) {rand(100) * 0.5}
+    counts  = Array.new(500) {rand(10)}
+    samples = values.zip(counts).flat_map {|v, c| [v] * c}
+
+    stats = CheapStats.new(samples)
+    wt    = CheapStats::Weighted.new(values.pack("d*"), counts)
+
+    assert_equal(samples.size.to_f, wt.weight)
+    assert_equal(samples.uniq.size, wt.distinct)
+
+    %i[min max q1 q3 median].each { |m|
+      assert_equal(stats.send(m), wt.send(m), m)
+    }
+
+    %i[total mean variance std skewness kurtosis].each { |m|
+      assert_in_delta(stats.send(m), wt.send(m), 1.0e-9, m)
+    }
+
+    [0.0, 0.05, 0.333, 0.9, 1.0].each { |p|
+      assert_equal(stats.quantile(p), wt.quantile(p))
+    }
+
+    xs = [-1.0, 0.0, 12.5, 30.2, 49.5, 60.0]
+    assert_equal(xs.map {|x| stats.cdf(x)}, xs.map {|x| wt.cdf(x)})
+    assert_in_delta(stats.estimated_pdf(25.0), wt.estimated_pdf(25.0), 1.0e-12)
+
+    # runs of the same value (cdf is the weight less than the value)
+    values  = [1.0, 2.0, 3.0, 4.0, 5.0, 6.0]
+    counts  = [1, 6, 1, 1, 1, 2]
+    stats   = CheapStats.new(values.zip(counts).flat_map {|v, c| [v] * c})
+    wt      = CheapStats::Weighted.new(values, counts)
+
+    [0.5, 1.0, 2.0, 2.5, 3.0, 6.0, 6.5].each { |x|
+      assert_equal(stats.cdf(x), wt.cdf(x))
+    }
+
+    wt = CheapStats::Weighted.new({3.0 => 2, 1.0 => 1, 2.0 => 0})
+    assert_equal(7.0, wt.total)
+    assert_equal(2, wt.distinct)
+    assert_raise(ArgumentError) {CheapStats::Weighted.new([1.0], [-1])}
+    assert_raise(ArgumentError) {CheapStats::Weighted.new([1.0], [1, 2])}
+  end
+
+  test "grouped statistics" do
+    srand(16)
+    keys   = Array.new(20000) {%w(a b c d e f g)[rand(7)]}
+    values = Array.new(20000) {rand * 100.0}
+    groups = keys.zip(values).group_by(&:first)
+
+    result = CheapStats.group(keys, values, threads: 2)
+    assert_equal(groups.keys, result.keys)
+
+    groups.each { |key, pairs|
+      stats   = CheapStats.new(pairs.map(&:last))
+      summary = result[key]
+
+      assert_equal(pairs.size, summary.count)
+      assert_in_delta(stats.total, summary.total, 1.0e-8)
+      assert_equal(stats.min, summary.min)
+      assert_equal(stats.q1, summary.q1)
+      assert_equal(stats.median, summary.median)
+      assert_equal(stats.max, summary.max)
+      assert_in_delta(stats.variance, summary.variance, 1.0e-8)
+      assert_equal(stats.quantile(0.9), summary.quantile(0.9))
+
+      [pairs[0][1], 50.0, stats.max, 101.0].each { |x|
+        assert_equal(stats.cdf(x), summary.cdf(x))
+      }
+    }
+
+    packed = CheapStats.group([3, 1, 3, 3].pack("q*"), [1.0, 2.0, 3.0, 4.0].pack("d*"))
+    assert_equal([3, 1], packed.keys)
+    assert_equal(3.0, packed[3].median)
+    assert_equal(1, packed[1].count)
+
+    dup   = SAMPLES + [2.0, 2.0]
+    stats = CheapStats.new(dup)
+    group = CheapStats.group([1] * dup.size, dup)[1]
+    [2.0, 2.5, 5.5].each {|x| assert_equal(stats.cdf(x), group.cdf(x))}
+
+    assert_raise(ArgumentError) {CheapStats.group([1, 2], [1.0])}
+    assert_equal({}, CheapStats.group([], []))
+  end
+
+  test "grouped statistics with many threads" do
+    srand(20)
+    keys   = Array.new(200000) {rand(1000)}.pack("q*")
+    values = Array.new(200000) {rand}.pack("d*")
+    single = CheapStats.group(keys, values)
+    many   = CheapStats.group(keys, values, threads: 300)
+
+    assert_equal(1000, many.size)
+
+    single.each { |key, summary|
+      assert_equal(summary.count, many[key].count)
+      assert_equal(summary.mean, many[key].mean)
+      assert_equal(summary.median, many[key].median)
+    }
+  end
+end
+
+class TestCheapStatsStream < Test::Unit::TestCase
+  SAMPLES = [7.0, 4.0, 1.0, 5.0, 3.0, 10.0, 6.0, 2.0, 8.0, 9.0]
+
+  test "append" do
+    stream = CheapStats::Stream.new
+    SAMPLES.each {|v| stream << v}
+
+    assert_equal(10, stream.count)
+    assert_equal(55.0, stream.total)
+    assert_in_delta(5.5, stream.mean, 1e-12)
+    assert_equal(1.0, stream.min)
+    assert_equal(10.0, stream.max)
+    assert_in_delta(2.87228132327, stream.std, 10e-6)
+    assert_in_delta(0.0, stream.skewness, 1e-12)
+  end
+
+  test "push" do
+    values = Array.new(3000) {|i| ((i * 7919) % 1000) / 10.0 + i * 0.01}
+    stats  = CheapStats.new(values)
+
+    s1 = CheapStats::Stream.new
+    values.each {|v| s1 << v}
+
+    s2 = CheapStats::Stream.new
+    s2.push(*values)
+
+    [s1, s2].each { |stream|
+      assert_equal(values.size, stream.count)
+      assert_in_delta(stats.mean, stream.mean, 1e-9)
+      assert_in_delta(stats.variance, stream.variance, 1e-6)
+      assert_in_delta(stats.central_moment(3), stream.central_moment(3), 1e-3)
+      assert_in_delta(stats.central_moment(4), stream.central_moment(4), 1e-1)
+    }
+  end
+
+  test "empty" do
+    stream = CheapStats::Stream.new
+
+    assert_equal(0, stream.count)
+    assert_nil(stream.mean)
+    assert_nil(stream.std)
+  end
+end
+
+class TestCheapStatsWindow < Test::Unit::TestCase
+  test "rolling statistics" do
+    srand(10)
+    values = Array.new(2000) {(rand * 100.0).round(1)}
+    window = CheapStats::Window.new(101)
+
+    values.each_with_index { |v, i|
+      window << v
+      next if i < 50 || i % 97 != 0
+
+      latest = values[[0, i - 100].max..i]
+      stats  = CheapStats.new(latest)
+
+      assert_equal(latest.size, window.count)
+      assert_equal(stats.min, window.min)
+      assert_equal(stats.max, window.max)
+      assert_equal(stats.q1, window.q1)
+      assert_equal(stats.median, window.median)
+      assert_equal(stats.q3, window.q3)
+      assert_equal(stats.quantile(0.99), window.quantile(0.99))
+      [latest.min, latest.sample, 50.0, latest.max, 100.5].each { |x|
+        assert_equal(stats.cdf(x), window.cdf(x))
+      }
+      assert_in_delta(stats.mean, window.mean, 1e-9)
+      assert_in_delta(stats.variance, window.variance, 1e-6)
+    }
+  end
+
+  test "empty" do
+    window = CheapStats::Window.new(10)
+
+    assert_equal(0, window.count)
+    assert_nil(window.median)
+
+    window.push(1.0, 2.0, 3.0)
+    window.clear
+    assert_nil(window.mean)
+
+    assert_raise(ArgumentError) {CheapStats::Window.new(0)}
+  end
+
+  test "cdf" do
+    samples = [7.0, 4.0, 1.0, 5.0, 3.0, 10.0, 6.0, 2.0, 8.0, 9.0]
+    stats   = CheapStats.new(samples)
+    window  = CheapStats::Window.new(10).push(*samples)
+
+    [1.0, 2.0, 2.5, 5.5, 7.5, 10.0, 10.1].each { |x|
+      assert_equal(stats.cdf(x), window.cdf(x))
+    }
+  end
+end
+
+class TestCheapStatsSketch < Test::Unit::TestCase
+  test "approximated quantiles" do
+    srand(11)
+    values = Array.new(200_000) {Math.exp(rand * 10.0)}
+    sorted = values.sort
+    rank   = ->(v) {sorted.bsearch_index {|x| x >= v}.fdiv(sorted.size)}
+
+    sketch = CheapStats::Sketch.new(k: 200)
+    values.each_slice(1000) {|a| sketch.push(*a)}
+
+    assert_equal(values.size, sketch.count)
+    assert_equal(sorted[0], sketch.min)
+    assert_equal(sorted[-1], sketch.max)
+    assert_in_delta(0.25, rank.(sketch.q1), 0.01)
+    assert_in_delta(0.5, rank.(sketch.median), 0.01)
+    assert_in_delta(0.99, rank.(sketch.quantile(0.99)), 0.01)
+    assert_operator(sketch.dump.bytesize, :<, 8192)
+
+    stats = CheapStats.new(values)
+    [sorted[0], 10.0, 100.0, sorted[150_000], sorted[-1]].each { |x|
+      assert_in_delta(stats.cdf(x), sketch.cdf(x), 0.01)
+    }
+  end
+
+  test "cdf" do
+    # exact while all of the samples are kept
+    samples = [7.0, 4.0, 1.0, 5.0, 3.0, 10.0, 6.0, 2.0, 8.0, 9.0] + [2.0] * 5
+    stats   = CheapStats.new(samples)
+    sketch  = CheapStats::Sketch.new.push(*samples)
+
+    [1.0, 2.0, 2.5, 5.5, 7.5, 10.0, 10.1].each { |x|
+      assert_equal(stats.cdf(x), sketch.cdf(x))
+    }
+  end
+
+  test "merge and serialize" do
+    srand(12)
+    values = Array.new(50_000) {rand}
+    parts  = values.each_slice(10_000).map { |a|
+      CheapStats::Sketch.new.push(*a)
+    }
+
+    merged = parts.inject {|a, b| a.merge(b)}
+    assert_equal(values.size, merged.count)
+    assert_in_delta(0.5, merged.median, 0.01)
+
+    loaded = Marshal.load(Marshal.dump(merged))
+    assert_equal(merged.count, loaded.count)
+    assert_equal(merged.quantile(0.9), loaded.quantile(0.9))
+    assert_equal(merged.dump, CheapStats::Sketch.load(merged.dump).dump)
+
+    doubled = CheapStats::Sketch.load(merged.dump)
+    assert_same(doubled, doubled.merge(doubled))
+    assert_equal(values.size * 2, doubled.count)
+    assert_in_delta(merged.median, doubled.median, 0.01)
+
+    assert_raise(ArgumentError) {merged.merge(CheapStats::Sketch.new(k: 100))}
+    assert_raise(ArgumentError) {CheapStats::Sketch.load("broken")}
+    assert_nil(CheapStats::Sketch.new.median)
+  end
+end
+
+class TestCheapStatsHistogram < Test::Unit::TestCase
+  test "percentiles of latencies" do
+    srand(13)
+    values = Array.new(100_000) {Math.exp(rand * 12.0 - 4.0)}
+    sorted = values.sort
+
+    hist = CheapStats::Histogram.new(lowest: 1.0e-3, highest: 1.0e+6, digits: 3)
+    values.each_slice(1000) {|a| hist.push(*a)}
+
+    assert_equal(values.size, hist.count)
+    assert_in_delta(values.sum, hist.total, 1.0e-6 * values.sum)
+    assert_in_delta(values.sum / values.size, hist.mean, 1.0e-6)
+    assert_equal(sorted[0], hist.min)
+    assert_equal(sorted[-1], hist.max)
+
+    [1.0, 25.0, 50.0, 99.0, 99.9].each { |pct|
+      exp = sorted[((sorted.size - 1) * pct / 100.0).to_i]
+      assert_in_delta(exp, hist.percentile(pct), exp * 1.0e-3)
+    }
+
+    assert_equal(sorted[-1], hist.percentile(100))
+    assert_in_delta(sorted.bsearch_index {|x| x >= 10.0}.fdiv(sorted.size),
+                    hist.cdf(10.0), 0.001)
+    assert_raise(ArgumentError) {hist << -1.0}
+  end
+
+  test "merge and serialize" do
+    a = CheapStats::Histogram.new.push(*(1..1000))
+    b = CheapStats::Histogram.new.push(*(1001..2000))
+
+    a.merge(b)
+    assert_equal(2000, a.count)
+    assert_in_delta(1000.0, a.percentile(50), 1.0)
+
+    loaded = Marshal.load(Marshal.dump(a))
+    assert_equal(a.count, loaded.count)
+    assert_equal(a.percentile(90), loaded.percentile(90))
+    assert_equal(a.dump, CheapStats::Histogram.load(a.dump).dump)
+    assert_operator(a.dump.bytesize, :<, 8192)
+
+    doubled = CheapStats::Histogram.load(a.dump)
+    assert_same(doubled, doubled.merge(doubled))
+    assert_equal(4000, doubled.count)
+    assert_equal(a.percentile(90), doubled.percentile(90))
+
+    assert_raise(ArgumentError) {a.merge(CheapStats::Histogram.new(digits: 2))}
+    assert_raise(ArgumentError) {CheapStats::Histogram.load("broken")}
+    assert_nil(CheapStats::Histogram.new.percentile(50))
   end
 end